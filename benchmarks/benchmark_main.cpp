@@ -1,5 +1,34 @@
 #include <benchmark/benchmark.h>
 
+#include "SDL3/SDL_pixels.h"
+#include "SDL3/SDL_rect.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+import light;
+import fov;
+import pool;
+import drawList;
+import particles;
+import level;
+import tile;
+import tileTypes;
+import animation;
+import snapshot;
+import script;
+import image;
+import renderBackend;
+import memory;
+import dungeon;
+import tileOrder;
+
 static void BM_Example(benchmark::State& state) {
     for (auto _ : state) {
         // Benchmark code here
@@ -11,4 +40,441 @@ static void BM_Example(benchmark::State& state) {
 }
 BENCHMARK(BM_Example);
 
+// lights walking across a 256x256 map where one cell in five is a wall, the
+// light map is updated after every step
+static void BM_LightMapMovingLights(benchmark::State& state) {
+    constexpr int mapSize = 256;
+    constexpr int wallRatio = 5;
+    std::mt19937 random{42};
+    std::uniform_int_distribution<int> cell{0, mapSize - 1};
+
+    LightMap lightMap{mapSize, mapSize};
+    for (int i = 0; i < mapSize * mapSize / wallRatio; ++i) {
+        lightMap.setOpaque(cell(random), cell(random), true);
+    }
+
+    std::vector<Light> lights;
+    std::vector<LightId> ids;
+    for (int i = 0; i < state.range(0); ++i) {
+        lights.push_back({.x = cell(random), .y = cell(random), .intensity = maxLightLevel});
+        ids.push_back(lightMap.addLight(lights.back()));
+    }
+    lightMap.update();
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < lights.size(); ++i) {
+            lights[i].x = (lights[i].x + 1) % mapSize;
+            lightMap.moveLight(ids[i], lights[i].x, lights[i].y);
+        }
+        lightMap.update();
+        benchmark::DoNotOptimize(lightMap.level(0, 0));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LightMapMovingLights)->Arg(100);
+
+// field of view of the given radius on a 256x256 map where one cell in ten
+// is a wall
+static void BM_FieldOfView(benchmark::State& state) {
+    constexpr int mapSize = 256;
+    constexpr int wallRatio = 10;
+    std::mt19937 random{42};
+    std::uniform_int_distribution<int> cell{0, mapSize - 1};
+
+    FieldOfView fieldOfView{mapSize, mapSize};
+    for (int i = 0; i < mapSize * mapSize / wallRatio; ++i) {
+        fieldOfView.setOpaque(cell(random), cell(random), true);
+    }
+
+    const auto radius = static_cast<int>(state.range(0));
+    int originX = mapSize / 2;
+    for (auto _ : state) {
+        fieldOfView.compute(originX, mapSize / 2, radius);
+        originX = originX == mapSize / 2 ? mapSize / 2 + 1 : mapSize / 2;
+        benchmark::DoNotOptimize(fieldOfView.isVisible(0, 0));
+    }
+}
+BENCHMARK(BM_FieldOfView)->Arg(30);
+
+// a full pool of particles updated as a batch, the expired ones are
+// despawned and replaced every iteration
+static void BM_PoolParticles(benchmark::State& state) {
+    struct Particle {
+        float x;
+        float y;
+        float speedX;
+        float speedY;
+        int lifetime;
+    };
+    constexpr int maxLifetime = 60;
+
+    const auto count = static_cast<std::uint32_t>(state.range(0));
+    Pool<Particle> particles{count};
+    int spawned = 0;
+    const auto refill = [&] {
+        while (particles.size() < particles.capacity()) {
+            particles.spawn(0.F, 0.F, 1.F, 0.5F, 1 + (spawned++ % maxLifetime));
+        }
+    };
+    refill();
+
+    for (auto _ : state) {
+        for (auto& particle : particles.objects()) {
+            particle.x += particle.speedX;
+            particle.y += particle.speedY;
+            --particle.lifetime;
+        }
+        particles.despawnIf([](const Particle& particle) { return particle.lifetime <= 0; });
+        refill();
+        benchmark::DoNotOptimize(particles.objects().data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PoolParticles)->Arg(10000);
+
+static void BM_Particles(benchmark::State& state) {
+    // 100k particles updated, added to the frame draw list and filled by the
+    // software backend every frame
+    const auto count = static_cast<std::size_t>(state.range(0));
+    constexpr float frameTime = 1000.F / 60;
+    constexpr std::size_t burst = 64;
+    constexpr SDL_Point scene{640, 360};
+    ParticleSystem particles{count};
+    DrawList drawList;
+    SoftwareBackend backend{scene};
+    const auto refill = [&] {
+        for (int effect = 0; particles.size() < particles.capacity(); ++effect) {
+            particles.emit(static_cast<ParticleEffect>(effect % 3), SDL_FPoint{320, 180}, burst);
+        }
+    };
+    refill();
+
+    for (auto _ : state) {
+        particles.update(frameTime);
+        drawList.clear();
+        particles.render(drawList);
+        backend.clear({0, 0, scene.x, scene.y});
+        backend.submit(drawList, {0, 0, scene.x, scene.y});
+        backend.finish();
+        refill();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Particles)->Arg(100000);
+
+namespace {
+
+/// the standard level of the benchmarks, a generated dungeon of side * side cells
+auto makeLevel(int side) -> LevelSnapshot {
+    return generateDungeon({.cells = {side, side}, .seed = 3});
+}
+
+auto writeText(const LevelSnapshot& level) -> std::string {
+    std::ostringstream stream;
+    for (const auto& tile : level.floor) {
+        stream << tile << '\n';
+    }
+    stream << "=====\n";
+    for (const auto& tile : level.walls) {
+        stream << tile << '\n';
+    }
+    return stream.str();
+}
+
+auto writeCompact(const LevelSnapshot& level) -> std::string {
+    const auto bytes = *encodeLevel(level);
+    return {bytes.begin(), bytes.end()};
+}
+
+} // namespace
+
+static void BM_LevelSave(benchmark::State& state, std::string (*write)(const LevelSnapshot&)) {
+    const auto level = makeLevel(static_cast<int>(state.range(0)));
+    std::size_t bytes = 0;
+    for (auto _ : state) {
+        const auto encoded = write(level);
+        bytes = encoded.size();
+        benchmark::DoNotOptimize(encoded.data());
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * bytes));
+    state.counters["bytes_per_tile"] = static_cast<double>(bytes) / static_cast<double>(level.size());
+}
+BENCHMARK_CAPTURE(BM_LevelSave, text, writeText)->Arg(256);
+BENCHMARK_CAPTURE(BM_LevelSave, compact, writeCompact)->Arg(256);
+
+static void BM_LevelLoad(benchmark::State& state, std::string (*write)(const LevelSnapshot&)) {
+    const auto level = makeLevel(static_cast<int>(state.range(0)));
+    const auto encoded = write(level);
+    std::vector<std::unique_ptr<TileConcrete>> map;
+    std::vector<std::unique_ptr<TileConcrete>> mapWall;
+    for (auto _ : state) {
+        std::istringstream stream{encoded};
+        readLevel(stream, map, mapWall);
+        benchmark::DoNotOptimize(map.data());
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * encoded.size()));
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * level.size()));
+}
+BENCHMARK_CAPTURE(BM_LevelLoad, text, writeText)->Arg(256);
+BENCHMARK_CAPTURE(BM_LevelLoad, compact, writeCompact)->Arg(256);
+
+// the memory a loaded level costs per tile, the benchmark fails when it goes
+// over the budget so a regression shows in the benchmark run
+static void BM_LevelMemory(benchmark::State& state) {
+    constexpr double tileBudget = 32;
+    constexpr double loadBudget = 48;
+    const auto level = makeLevel(static_cast<int>(state.range(0)));
+    const auto encoded = writeCompact(level);
+    std::vector<std::unique_ptr<TileConcrete>> map;
+    std::vector<std::unique_ptr<TileConcrete>> mapWall;
+    double tileBytes = 0;
+    double loadBytes = 0;
+    for (auto _ : state) {
+        map.clear();
+        mapWall.clear();
+        const auto tiles = memoryUsage(MemoryTag::Tiles).live;
+        const auto io = memoryUsage(MemoryTag::LevelIo).live;
+        resetMemoryPeaks();
+        std::istringstream stream{encoded};
+        readLevel(stream, map, mapWall);
+        tileBytes = static_cast<double>(memoryUsage(MemoryTag::Tiles).live - tiles);
+        loadBytes = static_cast<double>(memoryUsage(MemoryTag::LevelIo).peak - io);
+    }
+    const auto count = static_cast<double>(level.size());
+    state.counters["tile_bytes_per_tile"] = tileBytes / count;
+    state.counters["load_bytes_per_tile"] = loadBytes / count;
+    if (tileBytes / count > tileBudget || loadBytes / count > loadBudget) {
+        state.SkipWithError("the level memory is over budget");
+    }
+}
+BENCHMARK(BM_LevelMemory)->Arg(256);
+
+static void BM_GenerateDungeon(benchmark::State& state) {
+    const auto side = static_cast<int>(state.range(0));
+    std::size_t tiles = 0;
+    for (auto _ : state) {
+        const auto level = generateDungeon({.cells = {side, side}, .seed = 3});
+        tiles = level.size();
+        benchmark::DoNotOptimize(level.floor.data());
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) * side * side);
+    state.counters["tiles"] = static_cast<double>(tiles);
+}
+BENCHMARK(BM_GenerateDungeon)->Arg(1024)->Arg(4096)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+namespace {
+
+/// the floor of a dungeon, in the order its tiles were clicked or in z-order
+auto makeLayer(int side, bool ordered) -> TileLayer {
+    const auto level = makeLevel(side);
+    TileLayer layer;
+    if (ordered) {
+        TileLayer walls;
+        buildLevel(level, layer, walls);
+        return layer;
+    }
+    // each tile allocated as it is placed, in no order
+    std::vector<const TileRecord*> clicks;
+    for (const auto& record : level.floor) {
+        clicks.push_back(&record);
+    }
+    std::ranges::shuffle(clicks, std::minstd_rand{11});
+    for (const auto* record : clicks) {
+        layer.push_back(RendererBuilder{record->typeId}.build(record->pos, record->level));
+    }
+    return layer;
+}
+
+} // namespace
+
+// the tiles under a camera moving across the dungeon, filtered from the whole
+// layer in clicked order and walked over the key ranges in z-order
+static void BM_TileRegion(benchmark::State& state, bool ordered) {
+    constexpr float gridSize = 16;
+    constexpr SDL_FPoint camera{640 + 32, 360 + 32};
+    const auto side = static_cast<int>(state.range(0));
+    const auto layer = makeLayer(side, ordered);
+    const auto world = static_cast<float>(side) * gridSize;
+    std::size_t visited = 0;
+    float x = 0;
+    for (auto _ : state) {
+        const SDL_FRect area{x, x * 0.5F, camera.x, camera.y};
+        x = x + camera.x < world ? x + gridSize * 7 : 0;
+        float sum = 0;
+        const auto visit = [&sum, &visited](const TileConcrete& tile) {
+            sum += tile.getPos().x;
+            ++visited;
+        };
+        if (ordered) {
+            forEachTileIn(layer, area, visit);
+        } else {
+            for (const auto& tile : layer) {
+                const auto pos = tile->getPos();
+                if (pos.x >= area.x && pos.y >= area.y && pos.x < area.x + area.w && pos.y < area.y + area.h) {
+                    visit(*tile);
+                }
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(visited));
+}
+BENCHMARK_CAPTURE(BM_TileRegion, clicked, false)->Arg(1024);
+BENCHMARK_CAPTURE(BM_TileRegion, ordered, true)->Arg(1024);
+
+namespace {
+
+/// entities spread over the map, the ones of odd index walking right
+auto makeEntities(int count) -> std::vector<EntityState> {
+    const auto orc = *findTileType("orc_warrior");
+    std::vector<EntityState> entities;
+    for (int index = 0; index < count; ++index) {
+        entities.push_back({.typeId = orc, .x = quantize(static_cast<float>(index % 64) * 64), .y = quantize(static_cast<float>(index / 64) * 64), .clip = index % 2 == 0 ? Clip::Idle : Clip::Run, .flipped = false});
+    }
+    return entities;
+}
+
+/// move the walking entities by a 30 fps tick
+auto step(std::vector<EntityState>& entities) -> void {
+    constexpr float tickDistance = 0.04F * 33;
+    for (std::size_t index = 1; index < entities.size(); index += 2) {
+        entities[index].x += quantize(tickDistance);
+    }
+}
+
+} // namespace
+
+// a tick of entities half of which move, delta compressed against the
+// previous tick
+static void BM_SnapshotEncode(benchmark::State& state) {
+    Snapshot baseline{.tick = 1, .entities = makeEntities(static_cast<int>(state.range(0))), .resetTiles = false, .edits = {}};
+    Snapshot current{.tick = 2, .entities = baseline.entities, .resetTiles = false, .edits = {}};
+    step(current.entities);
+    std::size_t bytes = 0;
+    for (auto _ : state) {
+        const auto encoded = encodeSnapshot(current, &baseline);
+        bytes = encoded->size();
+        benchmark::DoNotOptimize(encoded->data());
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * bytes));
+    state.counters["bytes_per_entity"] = static_cast<double>(bytes) / static_cast<double>(current.entities.size());
+}
+BENCHMARK(BM_SnapshotEncode)->Arg(256)->Arg(4096);
+
+static void BM_SnapshotDecode(benchmark::State& state) {
+    Snapshot baseline{.tick = 1, .entities = makeEntities(static_cast<int>(state.range(0))), .resetTiles = false, .edits = {}};
+    Snapshot current{.tick = 2, .entities = baseline.entities, .resetTiles = false, .edits = {}};
+    step(current.entities);
+    const auto encoded = *encodeSnapshot(current, &baseline);
+    for (auto _ : state) {
+        const auto decoded = decodeSnapshot(encoded, &baseline);
+        benchmark::DoNotOptimize(decoded->entities.data());
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * encoded.size()));
+    state.counters["bytes_per_entity"] = static_cast<double>(encoded.size()) / static_cast<double>(current.entities.size());
+}
+BENCHMARK(BM_SnapshotDecode)->Arg(256)->Arg(4096);
+
+namespace {
+
+auto dormant(ScriptScheduler& scheduler, TriggerId trigger) -> ScriptTask {
+    for (;;) {
+        co_await scheduler.trigger(trigger);
+    }
+}
+
+auto ticking(ScriptScheduler& scheduler) -> ScriptTask {
+    for (;;) {
+        co_await scheduler.nextTick();
+    }
+}
+
+} // namespace
+
+// a level with many scripts waiting for a trigger or a long timer, and a few
+// scripts running every tick
+static void BM_ScriptsDormant(benchmark::State& state) {
+    constexpr int active = 16;
+    const auto scripts = static_cast<std::uint32_t>(state.range(0));
+    ScriptScheduler scheduler{scripts + active};
+    const auto trigger = scheduler.addTrigger();
+    for (std::uint32_t script = 0; script < scripts; ++script) {
+        scheduler.spawn(dormant(scheduler, trigger));
+    }
+    for (int script = 0; script < active; ++script) {
+        scheduler.spawn(ticking(scheduler));
+    }
+    scheduler.update(0);
+
+    for (auto _ : state) {
+        scheduler.update(33);
+        benchmark::DoNotOptimize(scheduler.resumed());
+    }
+    state.counters["resumed"] = static_cast<double>(scheduler.resumed());
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * (scripts + active)));
+}
+BENCHMARK(BM_ScriptsDormant)->Arg(1000)->Arg(100000);
+
+namespace {
+
+/// a draw list covering the scene with floor tiles, a wall over every
+/// fourth one, as the game draws a level
+auto makeSceneDrawList(const SDL_Point& scene) -> DrawList {
+    constexpr float tile = 16;
+    DrawList drawList;
+    for (int row = 0; row * 16 < scene.y; ++row) {
+        for (int column = 0; column * 16 < scene.x; ++column) {
+            const SDL_FRect dest{static_cast<float>(column) * tile, static_cast<float>(row) * tile, tile, tile};
+            drawList.sprite({static_cast<float>(column % 8) * tile, 0, tile, tile}, dest);
+            if ((row + column) % 4 == 0) {
+                drawList.sprite({static_cast<float>(column % 8) * tile, tile, tile, tile * 2}, {dest.x, dest.y - tile, tile, tile * 2}, column % 2 == 0);
+            }
+        }
+    }
+    return drawList;
+}
+
+/// an atlas of opaque tiles and of walls with transparent texels
+auto makeAtlas() -> Image {
+    constexpr int side = 128;
+    Image atlas{.width = side, .height = side, .pixels = std::vector<SDL_Color>(static_cast<std::size_t>(side * side))};
+    std::minstd_rand random{5};
+    std::uniform_int_distribution<int> channel{0, 255};
+    for (auto& pixel : atlas.pixels) {
+        pixel = {static_cast<Uint8>(channel(random)), static_cast<Uint8>(channel(random)), static_cast<Uint8>(channel(random)), static_cast<Uint8>(channel(random) < 64 ? 0 : 255)};
+    }
+    return atlas;
+}
+
+auto makeBackend(BackendKind kind, const SDL_Point& scene) -> std::unique_ptr<RenderBackend> {
+    if (kind == BackendKind::Software) {
+        return std::make_unique<SoftwareBackend>(scene);
+    }
+    return std::make_unique<NullBackend>();
+}
+
+} // namespace
+
+// redraw the whole scene of a level with a backend, the null backend gives
+// the cost of walking the draw list alone
+static void BM_RenderScene(benchmark::State& state, BackendKind kind) {
+    constexpr SDL_Point scene{640, 360};
+    const auto drawList = makeSceneDrawList(scene);
+    const auto backend = makeBackend(kind, scene);
+    backend->setAtlas(makeAtlas());
+    for (auto _ : state) {
+        backend->clear({0, 0, scene.x, scene.y});
+        backend->submit(drawList, {0, 0, scene.x, scene.y});
+        backend->finish();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * drawList.commands().size()));
+    state.counters["pixels"] = benchmark::Counter(static_cast<double>(state.iterations() * scene.x * scene.y), benchmark::Counter::kIsRate);
+}
+BENCHMARK_CAPTURE(BM_RenderScene, software, BackendKind::Software);
+BENCHMARK_CAPTURE(BM_RenderScene, null, BackendKind::Null);
+
 BENCHMARK_MAIN();
\ No newline at end of file
@@ -0,0 +1,97 @@
+# Generate the tileTypes module from the tileset index.
+#
+# usage:
+#   cmake -DTILE_INDEX=<tile_list_v1.7.cpy> -DTILE_LIST=<tile_list_v1.7>
+#         -DTEMPLATE=<tile_types.cpp.in> -DOUTPUT=<tile_types.cpp>
+#         -P generate_tile_types.cmake
+#
+# TILE_INDEX lists the entities used by the game in the form
+# 'class name x y w h'. TILE_LIST lists every frame of the atlas in the form
+# 'name x y w h'. Animation frame counts are found by walking the frames laid
+# out to the right of an entity source rectangle in TILE_LIST.
+
+foreach(var TILE_INDEX TILE_LIST TEMPLATE OUTPUT)
+  if(NOT DEFINED ${var})
+    message(FATAL_ERROR "${var} is not set")
+  endif()
+endforeach()
+
+set(rect_regex "([0-9]+) ([0-9]+) ([0-9]+) ([0-9]+)")
+set(anim_regex "(_idle|_run|_hit)?_anim_f[0-9]+$")
+
+file(STRINGS "${TILE_LIST}" frames)
+foreach(frame IN LISTS frames)
+  if(frame MATCHES "^([a-z0-9_]+) ${rect_regex}$")
+    set("frame_${CMAKE_MATCH_2}_${CMAKE_MATCH_3}_${CMAKE_MATCH_4}_${CMAKE_MATCH_5}"
+        "${CMAKE_MATCH_1}")
+  endif()
+endforeach()
+
+set(tile_class_terrain Terrain)
+set(tile_class_terrainA AnimatedTerrain)
+set(tile_class_character Character)
+set(tile_class_enemy Enemy)
+set(tile_class_enemyw Enemy)
+set(tile_class_item Item)
+set(tile_class_ui Ui)
+set(tile_class_weapon Weapon)
+
+set(entries "")
+file(STRINGS "${TILE_INDEX}" tiles)
+foreach(tile IN LISTS tiles)
+  if(NOT tile MATCHES "^([a-zA-Z]+) ([a-z0-9_]+) ${rect_regex}$")
+    continue()
+  endif()
+  set(class "${CMAKE_MATCH_1}")
+  set(name "${CMAKE_MATCH_2}")
+  set(x "${CMAKE_MATCH_3}")
+  set(y "${CMAKE_MATCH_4}")
+  set(w "${CMAKE_MATCH_5}")
+  set(h "${CMAKE_MATCH_6}")
+
+  if(NOT DEFINED tile_class_${class})
+    message(FATAL_ERROR "unknown tile class '${class}' for '${name}'")
+  endif()
+  set(tile_class "${tile_class_${class}}")
+
+  set(idle 1)
+  set(run 0)
+  set(hit 0)
+  if(tile_class MATCHES "^(AnimatedTerrain|Character|Enemy)$")
+    set(idle 0)
+    set(base "")
+    set(frame_x ${x})
+    while(DEFINED "frame_${frame_x}_${y}_${w}_${h}")
+      set(frame_name "${frame_${frame_x}_${y}_${w}_${h}}")
+      if(NOT frame_name MATCHES "${anim_regex}")
+        break()
+      endif()
+      string(REGEX REPLACE "${anim_regex}" "" frame_base "${frame_name}")
+      if(base STREQUAL "")
+        set(base "${frame_base}")
+      elseif(NOT base STREQUAL frame_base)
+        break()
+      endif()
+
+      if(frame_name MATCHES "_run_anim_")
+        math(EXPR run "${run} + 1")
+      elseif(frame_name MATCHES "_hit_anim_")
+        math(EXPR hit "${hit} + 1")
+      else()
+        math(EXPR idle "${idle} + 1")
+      endif()
+      math(EXPR frame_x "${frame_x} + ${w}")
+    endwhile()
+
+    if(idle EQUAL 0)
+      message(FATAL_ERROR "no animation frame found for '${name}'")
+    endif()
+  endif()
+
+  string(APPEND entries
+         "    TileType{\"${name}\", TileClass::${tile_class}, "
+         "{${x}, ${y}, ${w}, ${h}}, ${idle}, ${run}, ${hit}},\n")
+endforeach()
+
+set(TILE_TYPE_ENTRIES "${entries}")
+configure_file("${TEMPLATE}" "${OUTPUT}" @ONLY)
@@ -0,0 +1,158 @@
+module;
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+export module ai;
+
+/// handle of an agent in an AiScheduler
+export using AgentId = std::uint32_t;
+
+/// what the AiScheduler did during a tick
+export struct AiStats {
+  /// the time spent in the agent updates
+  std::chrono::microseconds cost;
+  /// the number of agents updated
+  size_t updated;
+  /// the number of agents due but left for the next ticks
+  size_t skipped;
+};
+
+/// spread the updates of agents across ticks
+///
+/// each agent is updated every interval ticks, or offCameraFactor times less
+/// often when it is out of the camera view. Agents on camera are updated
+/// first, and a tick stops updating agents once its budget is spent; the next
+/// tick resumes where it stopped so every agent gets its turn. The budget is a
+/// time, or a number of updates when the ticks must be reproducible
+export class AiScheduler {
+public:
+  /// constructor
+  ///
+  /// \param[in] Budget the time the updates of a tick may take
+  explicit AiScheduler(std::chrono::microseconds budget) : budget_{budget} {}
+
+  /// add an agent
+  ///
+  /// \param[in] Interval the number of ticks between two updates, at least 1
+  /// \return the handle of the agent
+  auto add(std::uint32_t interval) -> AgentId;
+
+  /// spend the budget of a tick in updates instead of time, so a tick updates
+  /// the same agents on every run
+  ///
+  /// \param[in] MaxUpdates the number of agents a tick may update
+  auto setMaxUpdates(size_t maxUpdates) noexcept -> void {
+    maxUpdates_ = maxUpdates;
+  }
+
+  /// set whether an agent is in the camera view
+  auto setOnCamera(AgentId id, bool onCamera) noexcept -> void {
+    onCamera_[id] = onCamera;
+  }
+
+  /// update the agents due this tick while the budget allows it
+  ///
+  /// \param[in] Update called as update(AgentId, ElapsedTicks) for each
+  ///   updated agent, ElapsedTicks being the ticks since its last update
+  template <class Update> auto tick(Update &&update) -> void;
+
+  /// what the last tick did
+  [[nodiscard]] auto stats() const noexcept -> const AiStats & {
+    return stats_;
+  }
+
+  [[nodiscard]] auto size() const noexcept -> size_t {
+    return intervals_.size();
+  }
+
+  /// agents out of the camera view are updated this many times less often
+  static constexpr std::uint32_t offCameraFactor{4};
+
+private:
+  /// whether an agent has waited its interval
+  [[nodiscard]] auto isDue(AgentId id) const noexcept -> bool {
+    const auto interval =
+        onCamera_[id] ? intervals_[id] : intervals_[id] * offCameraFactor;
+    return tick_ - lastUpdates_[id] >= interval;
+  }
+
+  /// update the due agents of one camera state, round-robin from its cursor
+  template <class Update>
+  auto pass(bool onCamera, std::chrono::steady_clock::time_point start,
+            Update &update) -> void;
+
+  std::chrono::microseconds budget_;
+  /// the budget in updates, replacing budget_ when set
+  std::optional<size_t> maxUpdates_;
+  std::uint64_t tick_{};
+
+  std::vector<std::uint32_t> intervals_;
+  std::vector<std::uint64_t> lastUpdates_;
+  std::vector<bool> onCamera_;
+
+  /// the agent each pass starts from, indexed by onCamera
+  std::array<AgentId, 2> cursors_{};
+  AiStats stats_{};
+};
+
+auto AiScheduler::add(std::uint32_t interval) -> AgentId {
+  const auto id = static_cast<AgentId>(intervals_.size());
+  intervals_.push_back(interval == 0 ? 1 : interval);
+  // spread the agents added together over their interval
+  lastUpdates_.push_back(tick_ - (id % intervals_.back()));
+  onCamera_.push_back(true);
+  return id;
+}
+
+template <class Update> auto AiScheduler::tick(Update &&update) -> void {
+  ++tick_;
+  stats_ = {};
+  const auto start = std::chrono::steady_clock::now();
+  pass(true, start, update);
+  pass(false, start, update);
+  stats_.cost = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+}
+
+template <class Update>
+auto AiScheduler::pass(bool onCamera,
+                       std::chrono::steady_clock::time_point start,
+                       Update &update) -> void {
+  const auto count = static_cast<AgentId>(intervals_.size());
+  if (count == 0) {
+    return;
+  }
+
+  auto &cursor = cursors_[onCamera ? 1 : 0];
+  cursor %= count;
+  for (AgentId step = 0; step < count; ++step) {
+    const auto id = (cursor + step) % count;
+    if (onCamera_[id] != onCamera || !isDue(id)) {
+      continue;
+    }
+
+    const bool spent =
+        maxUpdates_ ? stats_.updated >= *maxUpdates_
+                    : std::chrono::steady_clock::now() - start >= budget_;
+    if (spent) {
+      // count what is left and resume from here next tick
+      for (AgentId rest = step; rest < count; ++rest) {
+        const auto restId = (cursor + rest) % count;
+        if (onCamera_[restId] == onCamera && isDue(restId)) {
+          ++stats_.skipped;
+        }
+      }
+      cursor = id;
+      return;
+    }
+
+    update(id, tick_ - lastUpdates_[id]);
+    lastUpdates_[id] = tick_;
+    ++stats_.updated;
+  }
+}
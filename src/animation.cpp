@@ -0,0 +1,299 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+export module animation;
+
+import tileTypes;
+
+/// the animations an entity can play
+export enum class Clip : std::uint8_t { Idle, Run, Hit };
+
+/// how a clip of a tile type is played
+export struct ClipInfo {
+  /// index of the first frame, from the tile type source rect
+  int firstFrame;
+  /// number of frames of the clip, 0 if the type does not have the clip
+  int frameCount;
+  /// duration of one frame in ms
+  std::uint64_t frameDuration;
+  /// whether the clip loops or goes back to the looping clip when over
+  bool loop;
+  /// a clip only interrupts a clip of lower or equal priority
+  int priority;
+};
+
+inline constexpr size_t clipCount{3};
+inline constexpr std::uint64_t locomotionFrameDuration{66};
+inline constexpr std::uint64_t hitFrameDuration{2 * locomotionFrameDuration};
+
+/// the clips of a tile type, laid out as idle, run then hit frames
+constexpr auto makeClips(const TileType &type)
+    -> std::array<ClipInfo, clipCount> {
+  return {{
+      {.firstFrame = 0,
+       .frameCount = type.idleFrames,
+       .frameDuration = locomotionFrameDuration,
+       .loop = true,
+       .priority = 0},
+      {.firstFrame = type.runFrameIndex(),
+       .frameCount = type.runFrames,
+       .frameDuration = locomotionFrameDuration,
+       .loop = true,
+       .priority = 0},
+      {.firstFrame = type.hitFrameIndex(),
+       .frameCount = type.hitFrames,
+       .frameDuration = hitFrameDuration,
+       .loop = false,
+       .priority = 1},
+  }};
+}
+
+/// the clips of every tile type
+export inline constexpr auto clipTable = [] {
+  std::array<std::array<ClipInfo, clipCount>, tileTypes.size()> table{};
+  for (size_t typeId = 0; typeId < tileTypes.size(); ++typeId) {
+    table[typeId] = makeClips(tileTypes[typeId]);
+  }
+  return table;
+}();
+
+/// get how a clip of a tile type is played
+export constexpr auto clipInfo(TileTypeId typeId, Clip clip) noexcept
+    -> const ClipInfo & {
+  return clipTable[typeId][std::to_underlying(clip)];
+}
+
+/// handle of an animated entity in an AnimationSystem
+export using AnimationId = std::uint32_t;
+
+/// what happened to an animation during an update
+export enum class AnimationEventType : std::uint8_t {
+  FrameChanged,
+  ClipFinished,
+};
+
+/// event emitted by an AnimationSystem
+export struct AnimationEvent {
+  AnimationId id;
+  Clip clip;
+  AnimationEventType type;
+  /// the frame reached, or the last one of a finished clip, counted from the
+  /// first frame of the clip
+  int frame;
+};
+
+/// plays the clips of every animated entity
+///
+/// the state of the entities is stored by field, so an update is a single
+/// pass over contiguous arrays whatever the number of entities
+export class AnimationSystem {
+public:
+  /// add an animated entity playing its idle clip
+  ///
+  /// \param[in] TypeId the type the clips are taken from
+  /// \return the handle of the entity
+  auto add(TileTypeId typeId) -> AnimationId;
+
+  /// add an animated entity in the state of another
+  ///
+  /// \param[in] Id the entity copied
+  /// \return the handle of the new entity
+  auto copy(AnimationId id) -> AnimationId;
+
+  /// remove an animated entity, its handle is reused by the next add
+  auto remove(AnimationId id) -> void;
+
+  /// change the type of an entity, it plays its idle clip again
+  auto setType(AnimationId id, TileTypeId typeId) -> void;
+
+  /// request a clip for an entity
+  ///
+  /// looping clips become the clip played once a non looping clip is over,
+  /// clips the type does not have are ignored
+  auto play(AnimationId id, Clip clip) noexcept -> void;
+
+  /// advance every animation
+  ///
+  /// \param[in] DeltaTime the time since the last update in ms
+  auto update(std::uint64_t deltaTime) -> void;
+
+  /// whether an update can change the state of an entity, otherwise every
+  /// entity shows a single frame and updates can be skipped
+  [[nodiscard]] auto isAnimating() const noexcept -> bool;
+
+  /// get the frame to draw, counted from the type source rect
+  [[nodiscard]] auto frame(AnimationId id) const noexcept -> int {
+    return clipInfo(types_[id], clips_[id]).firstFrame + frames_[id];
+  }
+
+  /// get the clip being played
+  [[nodiscard]] auto clip(AnimationId id) const noexcept -> Clip {
+    return clips_[id];
+  }
+
+  /// get the events of the last update and of the clips played since
+  [[nodiscard]] auto events() const noexcept
+      -> std::span<const AnimationEvent> {
+    return events_;
+  }
+
+  /// the number of animated entities
+  [[nodiscard]] auto size() const noexcept -> size_t {
+    return types_.size() - freeIds_.size();
+  }
+
+private:
+  /// start a clip from its first frame
+  auto start(AnimationId id, Clip clip) -> void;
+
+  std::vector<TileTypeId> types_;
+  std::vector<Clip> clips_;
+  /// looping clip to go back to when a non looping clip is over
+  std::vector<Clip> baseClips_;
+  /// frame index in the clip
+  std::vector<int> frames_;
+  /// time spent on the current frame in ms
+  std::vector<std::uint64_t> elapsed_;
+
+  /// whether the entity of a handle was removed, it is left out of updates
+  std::vector<bool> removed_;
+  /// the handles removed, reused by add
+  std::vector<AnimationId> freeIds_;
+
+  std::vector<AnimationEvent> events_;
+  /// number of events already seen by an update
+  size_t publishedEvents_{};
+};
+
+auto AnimationSystem::add(TileTypeId typeId) -> AnimationId {
+  if (!freeIds_.empty()) {
+    const auto id = freeIds_.back();
+    freeIds_.pop_back();
+    removed_[id] = false;
+    setType(id, typeId);
+    return id;
+  }
+  const auto id = static_cast<AnimationId>(types_.size());
+  types_.push_back(typeId);
+  clips_.push_back(Clip::Idle);
+  baseClips_.push_back(Clip::Idle);
+  frames_.push_back(0);
+  elapsed_.push_back(0);
+  removed_.push_back(false);
+  return id;
+}
+
+auto AnimationSystem::copy(AnimationId id) -> AnimationId {
+  const auto copied = add(types_[id]);
+  clips_[copied] = clips_[id];
+  baseClips_[copied] = baseClips_[id];
+  frames_[copied] = frames_[id];
+  elapsed_[copied] = elapsed_[id];
+  return copied;
+}
+
+auto AnimationSystem::remove(AnimationId id) -> void {
+  // a removed entity is not updated until it is reused, and its events are
+  // dropped
+  removed_[id] = true;
+  const auto isRemoved = [id](const AnimationEvent &event) {
+    return event.id == id;
+  };
+  publishedEvents_ -= static_cast<size_t>(std::count_if(
+      events_.begin(),
+      events_.begin() + static_cast<std::ptrdiff_t>(publishedEvents_),
+      isRemoved));
+  std::erase_if(events_, isRemoved);
+  freeIds_.push_back(id);
+}
+
+auto AnimationSystem::setType(AnimationId id, TileTypeId typeId) -> void {
+  types_[id] = typeId;
+  clips_[id] = Clip::Idle;
+  baseClips_[id] = Clip::Idle;
+  frames_[id] = 0;
+  elapsed_[id] = 0;
+}
+
+auto AnimationSystem::play(AnimationId id, Clip clip) noexcept -> void {
+  const auto &info = clipInfo(types_[id], clip);
+  if (info.frameCount == 0) {
+    return;
+  }
+  if (info.loop) {
+    baseClips_[id] = clip;
+  }
+
+  const auto &current = clipInfo(types_[id], clips_[id]);
+  if ((clip == clips_[id] && info.loop) || info.priority < current.priority) {
+    return;
+  }
+  start(id, clip);
+}
+
+auto AnimationSystem::start(AnimationId id, Clip clip) -> void {
+  clips_[id] = clip;
+  frames_[id] = 0;
+  elapsed_[id] = 0;
+  events_.push_back({id, clip, AnimationEventType::FrameChanged, 0});
+}
+
+auto AnimationSystem::update(std::uint64_t deltaTime) -> void {
+  events_.erase(events_.begin(),
+                events_.begin() +
+                    static_cast<std::ptrdiff_t>(publishedEvents_));
+
+  for (AnimationId id = 0; id < types_.size(); ++id) {
+    if (removed_[id]) {
+      continue;
+    }
+    const auto &info = clipInfo(types_[id], clips_[id]);
+
+    elapsed_[id] += deltaTime;
+    if (elapsed_[id] < info.frameDuration) {
+      continue;
+    }
+    const auto steps = static_cast<int>(elapsed_[id] / info.frameDuration);
+    elapsed_[id] %= info.frameDuration;
+
+    auto frame = frames_[id] + steps;
+    if (frame >= info.frameCount) {
+      if (!info.loop) {
+        events_.push_back({id, clips_[id], AnimationEventType::ClipFinished,
+                           info.frameCount - 1});
+        start(id, baseClips_[id]);
+        continue;
+      }
+      frame %= info.frameCount;
+    }
+    if (frame != frames_[id]) {
+      frames_[id] = frame;
+      events_.push_back(
+          {id, clips_[id], AnimationEventType::FrameChanged, frame});
+    }
+  }
+
+  publishedEvents_ = events_.size();
+}
+
+auto AnimationSystem::isAnimating() const noexcept -> bool {
+  // the clips played since the last update still have their events to
+  // publish
+  if (events_.size() > publishedEvents_) {
+    return true;
+  }
+  for (AnimationId id = 0; id < types_.size(); ++id) {
+    const auto &info = clipInfo(types_[id], clips_[id]);
+    if (!removed_[id] && (info.frameCount > 1 || !info.loop)) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,143 @@
+module;
+
+#include "SDL3/SDL_pixels.h"
+#include "SDL3/SDL_rect.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+export module damage;
+
+import drawList;
+
+/// whether two draw commands draw the same pixels
+constexpr auto isSameCommand(const DrawCommand &lhs,
+                             const DrawCommand &rhs) noexcept -> bool {
+  const auto sameRect = [](const SDL_FRect &left, const SDL_FRect &right) {
+    return left.x == right.x && left.y == right.y && left.w == right.w &&
+           left.h == right.h;
+  };
+  return lhs.kind == rhs.kind && sameRect(lhs.source, rhs.source) &&
+         sameRect(lhs.dest, rhs.dest) && lhs.color.r == rhs.color.r &&
+         lhs.color.g == rhs.color.g && lhs.color.b == rhs.color.b &&
+         lhs.color.a == rhs.color.a;
+}
+
+/// whether two rects share a pixel
+constexpr auto overlaps(const SDL_Rect &lhs, const SDL_Rect &rhs) noexcept
+    -> bool {
+  return lhs.x < rhs.x + rhs.w && rhs.x < lhs.x + lhs.w &&
+         lhs.y < rhs.y + rhs.h && rhs.y < lhs.y + lhs.h;
+}
+
+/// the smallest rect holding two rects
+constexpr auto bounding(const SDL_Rect &lhs, const SDL_Rect &rhs) noexcept
+    -> SDL_Rect {
+  const auto left = std::min(lhs.x, rhs.x);
+  const auto top = std::min(lhs.y, rhs.y);
+  return {left, top, std::max(lhs.x + lhs.w, rhs.x + rhs.w) - left,
+          std::max(lhs.y + lhs.h, rhs.y + rhs.h) - top};
+}
+
+/// the areas of the screen to redraw
+///
+/// damage is found by comparing the draw list of a frame with the one of the
+/// previous frame, so whatever changes the commands, a movement, an animation
+/// frame or an edit, damages the area it covered and the area it covers now.
+/// Overlapping areas are merged, and past maxRects areas the damage becomes
+/// their bounding box
+export class DamageTracker {
+public:
+  /// constructor, the whole screen starts damaged
+  ///
+  /// \param[in] Bounds the area of the screen
+  explicit DamageTracker(const SDL_Rect &bounds) : bounds_{bounds} {
+    addFull();
+  }
+
+  /// damage an area, clipped to the screen
+  auto add(const SDL_FRect &rect) -> void;
+
+  /// damage the whole screen
+  auto addFull() -> void { rects_.assign(1, bounds_); }
+
+  /// damage the areas drawn differently by two draw lists
+  ///
+  /// \param[in] Previous the draw list on the screen
+  /// \param[in] Current the draw list to draw next
+  auto diff(const DrawList &previous, const DrawList &current) -> void;
+
+  /// forget the damage, once it was redrawn
+  auto clear() noexcept -> void { rects_.clear(); }
+
+  [[nodiscard]] auto rects() const noexcept -> std::span<const SDL_Rect> {
+    return rects_;
+  }
+  [[nodiscard]] auto empty() const noexcept -> bool { return rects_.empty(); }
+
+  /// past this many areas the damage is merged in one
+  static constexpr size_t maxRects{16};
+
+private:
+  SDL_Rect bounds_;
+  std::vector<SDL_Rect> rects_;
+};
+
+auto DamageTracker::add(const SDL_FRect &rect) -> void {
+  // the pixels partially covered are damaged too, clipped to the screen
+  const auto left = std::max(static_cast<int>(std::floor(rect.x)), bounds_.x);
+  const auto top = std::max(static_cast<int>(std::floor(rect.y)), bounds_.y);
+  const auto right = std::min(static_cast<int>(std::ceil(rect.x + rect.w)),
+                              bounds_.x + bounds_.w);
+  const auto bottom = std::min(static_cast<int>(std::ceil(rect.y + rect.h)),
+                               bounds_.y + bounds_.h);
+  if (left >= right || top >= bottom) {
+    return;
+  }
+  SDL_Rect area{left, top, right - left, bottom - top};
+
+  // merging can make the area overlap areas it did not before, so merge
+  // until it overlaps none of them
+  for (auto merged = true; merged;) {
+    merged = false;
+    for (auto iter = rects_.begin(); iter != rects_.end(); ++iter) {
+      if (overlaps(*iter, area)) {
+        area = bounding(*iter, area);
+        rects_.erase(iter);
+        merged = true;
+        break;
+      }
+    }
+  }
+  rects_.push_back(area);
+
+  if (rects_.size() > maxRects) {
+    auto whole = rects_.front();
+    for (const auto &other : rects_) {
+      whole = bounding(whole, other);
+    }
+    rects_.assign(1, whole);
+  }
+}
+
+auto DamageTracker::diff(const DrawList &previous, const DrawList &current)
+    -> void {
+  const auto before = previous.commands();
+  const auto after = current.commands();
+  const auto common = std::min(before.size(), after.size());
+  for (size_t index = 0; index < common; ++index) {
+    if (!isSameCommand(before[index], after[index])) {
+      add(before[index].dest);
+      add(after[index].dest);
+    }
+  }
+  for (const auto &command : before.subspan(common)) {
+    add(command.dest);
+  }
+  for (const auto &command : after.subspan(common)) {
+    add(command.dest);
+  }
+}
@@ -0,0 +1,91 @@
+module;
+
+#include "SDL3/SDL_pixels.h"
+#include "SDL3/SDL_rect.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+export module drawList;
+
+/// what a DrawCommand draws
+export enum class DrawKind : std::uint8_t {
+  Sprite,
+  FlippedSprite,
+  Rect,
+  Quad
+};
+
+/// a quad to draw on the screen
+export struct DrawCommand {
+  /// the area in the texture atlas, unused for rects
+  SDL_FRect source;
+  /// the area in the scene, in world units
+  SDL_FRect dest;
+  /// the color for rects and quads, the color modulation for sprites
+  SDL_Color color;
+  DrawKind kind;
+};
+
+/// the draw commands of one frame
+///
+/// built by the simulation and read by the submission stage, the commands do
+/// not reference any renderer object
+export class DrawList {
+public:
+  /// set the color modulation of the next sprites
+  ///
+  /// \param[in] Modulation multiplied with the sprite colors, white by default
+  auto setModulation(const SDL_Color &modulation) noexcept -> void {
+    modulation_ = modulation;
+  }
+
+  /// add a sprite from the texture atlas
+  ///
+  /// \param[in] Source the area of the sprite in the texture
+  /// \param[in] Dest the area in the scene
+  /// \param[in] Flipped whether the sprite is flipped horizontally
+  auto sprite(const SDL_FRect &source, const SDL_FRect &dest,
+              bool flipped = false) -> void {
+    commands_.push_back(
+        {.source = source,
+         .dest = dest,
+         .color = modulation_,
+         .kind = flipped ? DrawKind::FlippedSprite : DrawKind::Sprite});
+  }
+
+  /// add a rect outline
+  auto rect(const SDL_FRect &dest, const SDL_Color &color) -> void {
+    commands_.push_back(
+        {.source = {}, .dest = dest, .color = color, .kind = DrawKind::Rect});
+  }
+
+  /// add a filled quad, blended with its alpha
+  auto quad(const SDL_FRect &dest, const SDL_Color &color) -> void {
+    commands_.push_back(
+        {.source = {}, .dest = dest, .color = color, .kind = DrawKind::Quad});
+  }
+
+  /// remove every command, keeping the memory for the next frame
+  auto clear() noexcept -> void {
+    commands_.clear();
+    modulation_ = white;
+  }
+
+  [[nodiscard]] auto commands() const noexcept
+      -> std::span<const DrawCommand> {
+    return commands_;
+  }
+
+  [[nodiscard]] auto size() const noexcept -> size_t {
+    return commands_.size();
+  }
+
+private:
+  static constexpr SDL_Color white{255, 255, 255, 255};
+
+  std::vector<DrawCommand> commands_;
+  SDL_Color modulation_{white};
+};
@@ -0,0 +1,444 @@
+module;
+
+#include "SDL3/SDL_rect.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <thread>
+#include <vector>
+
+export module dungeon;
+
+import tile;
+import tileTypes;
+import level;
+
+/// the parameters of a generated dungeon
+export struct DungeonOptions {
+  /// the size of the dungeon in cells
+  SDL_Point cells{};
+  /// the same seed and size always give the same dungeon, whatever the
+  /// number of threads
+  std::uint64_t seed{};
+  /// the side of a cell in world units
+  float cellSize{16};
+  /// the side of the regions generated in parallel, in cells
+  int regionSize{64};
+  /// the threads generating the regions, 0 for one per core
+  unsigned threads{};
+};
+
+/// a small random generator whose sequence is the same on every platform
+class SplitMix {
+public:
+  explicit SplitMix(std::uint64_t seed) noexcept : state_{seed} {}
+
+  auto next() noexcept -> std::uint64_t {
+    constexpr std::uint64_t increment{0x9E3779B97F4A7C15ULL};
+    constexpr std::uint64_t firstMultiplier{0xBF58476D1CE4E5B9ULL};
+    constexpr std::uint64_t secondMultiplier{0x94D049BB133111EBULL};
+    state_ += increment;
+    auto value = state_;
+    value = (value ^ (value >> 30U)) * firstMultiplier;
+    value = (value ^ (value >> 27U)) * secondMultiplier;
+    return value ^ (value >> 31U);
+  }
+
+  /// a number from first to last included
+  auto between(int first, int last) noexcept -> int {
+    if (last <= first) {
+      return first;
+    }
+    return first + static_cast<int>(
+                       next() % static_cast<std::uint64_t>(last - first + 1));
+  }
+
+private:
+  std::uint64_t state_;
+};
+
+/// a number drawn from the seed and a few coordinates, so a region or a cell
+/// gets the same value whichever thread asks for it
+auto hashOf(std::uint64_t seed, std::int64_t first, std::int64_t second,
+            std::int64_t third = 0) noexcept -> std::uint64_t {
+  SplitMix mix{seed};
+  auto value = mix.next();
+  for (const auto part : {first, second, third}) {
+    value = SplitMix{value ^ static_cast<std::uint64_t>(part)}.next();
+  }
+  return value;
+}
+
+/// run a job for every index on a few threads
+///
+/// \param[in] Count the number of indexes
+/// \param[in] Threads the number of threads, 0 for one per core
+/// \param[in] Job the job, called once for each index
+auto parallelFor(size_t count, unsigned threads,
+                 const std::function<void(size_t)> &job) -> void {
+  if (threads == 0) {
+    threads = std::max(std::thread::hardware_concurrency(), 1U);
+  }
+  if (count == 0) {
+    return;
+  }
+  std::atomic<size_t> next{0};
+  const auto work = [&next, count, &job] {
+    for (auto index = next.fetch_add(1); index < count;
+         index = next.fetch_add(1)) {
+      job(index);
+    }
+  };
+
+  std::vector<std::jthread> workers;
+  // the calling thread is one of the workers
+  const auto extra = std::min<size_t>(threads, count) - 1;
+  for (size_t worker = 0; worker < extra; ++worker) {
+    workers.emplace_back(work);
+  }
+  work();
+}
+
+/// the layout of a dungeon, whether each cell is floor or rock
+export class DungeonMap {
+public:
+  /// constructor, every cell is rock
+  explicit DungeonMap(const SDL_Point &cells)
+      : cells_{cells},
+        floor_(static_cast<size_t>(cells.x) * static_cast<size_t>(cells.y)) {}
+
+  [[nodiscard]] auto cells() const noexcept -> SDL_Point { return cells_; }
+
+  /// whether a cell is floor, the cells out of the map are rock
+  [[nodiscard]] auto isFloor(int x, int y) const noexcept -> bool {
+    return x >= 0 && y >= 0 && x < cells_.x && y < cells_.y &&
+           floor_[index(x, y)] != 0;
+  }
+
+  /// dig a rect of floor, clipped to the map
+  auto carve(const SDL_Rect &rect) noexcept -> void;
+
+  /// the number of floor cells
+  [[nodiscard]] auto floorCount() const noexcept -> size_t {
+    return static_cast<size_t>(std::ranges::count(floor_, 1));
+  }
+
+private:
+  [[nodiscard]] auto index(int x, int y) const noexcept -> size_t {
+    return (static_cast<size_t>(y) * static_cast<size_t>(cells_.x)) +
+           static_cast<size_t>(x);
+  }
+
+  SDL_Point cells_;
+  /// one byte per cell, so the regions are carved in parallel
+  std::vector<std::uint8_t> floor_;
+};
+
+auto DungeonMap::carve(const SDL_Rect &rect) noexcept -> void {
+  const auto left = std::max(rect.x, 0);
+  const auto top = std::max(rect.y, 0);
+  const auto right = std::min(rect.x + rect.w, cells_.x);
+  const auto bottom = std::min(rect.y + rect.h, cells_.y);
+  for (auto row = top; row < bottom; ++row) {
+    for (auto column = left; column < right; ++column) {
+      floor_[index(column, row)] = 1;
+    }
+  }
+}
+
+/// the smallest leaf of the partition of a region
+inline constexpr int minLeaf{10};
+/// the smallest room
+inline constexpr SDL_Point minRoom{4, 3};
+/// the rock kept above a room for its wall and the top of the wall
+inline constexpr int wallRows{2};
+
+/// dig a corridor from a cell to another, first along the row then along the
+/// column
+auto carveCorridor(DungeonMap &map, const SDL_Point &from, const SDL_Point &to)
+    -> void {
+  map.carve({std::min(from.x, to.x), from.y, std::abs(to.x - from.x) + 1, 1});
+  map.carve({to.x, std::min(from.y, to.y), 1, std::abs(to.y - from.y) + 1});
+}
+
+/// dig the rooms of a leaf of the partition, or split it further
+///
+/// the rooms of the two halves of a split are joined by a corridor, so every
+/// room of the area is reachable
+///
+/// \return a cell in a room of the area
+auto carveArea(DungeonMap &map, const SDL_Rect &area, SplitMix &random)
+    -> SDL_Point {
+  const bool splitColumns = area.w >= 2 * minLeaf && area.w >= area.h;
+  const bool splitRows = area.h >= 2 * minLeaf && !splitColumns;
+  if (splitColumns || splitRows) {
+    auto first = area;
+    auto second = area;
+    if (splitColumns) {
+      first.w = random.between(minLeaf, area.w - minLeaf);
+      second.x += first.w;
+      second.w -= first.w;
+    } else {
+      first.h = random.between(minLeaf, area.h - minLeaf);
+      second.y += first.h;
+      second.h -= first.h;
+    }
+    const auto from = carveArea(map, first, random);
+    const auto to = carveArea(map, second, random);
+    carveCorridor(map, from, to);
+    return random.between(0, 1) == 0 ? from : to;
+  }
+
+  // a cell of rock on the sides and under the room, two above for its wall
+  const auto width =
+      random.between(minRoom.x, std::max(area.w - 2, minRoom.x));
+  const auto height =
+      random.between(minRoom.y, std::max(area.h - wallRows - 1, minRoom.y));
+  const SDL_Rect room{random.between(area.x + 1, area.x + area.w - 1 - width),
+                      random.between(area.y + wallRows,
+                                     area.y + area.h - 1 - height),
+                      width, height};
+  map.carve(room);
+  return {room.x + (room.w / 2), room.y + (room.h / 2)};
+}
+
+/// the regions of a dungeon along an axis, all at least regionSize wide
+struct RegionSplit {
+  int count;
+  int cells;
+
+  [[nodiscard]] auto start(int region) const noexcept -> int {
+    return static_cast<int>(static_cast<std::int64_t>(region) * cells / count);
+  }
+  [[nodiscard]] auto size(int region) const noexcept -> int {
+    return start(region + 1) - start(region);
+  }
+};
+
+/// dig the rooms and the corridors of a dungeon
+///
+/// the map is cut in regions dug in parallel, each partitioned in rooms.
+/// A region only digs its own cells: it joins its rooms to a door on each
+/// border it shares with another region, at a place both regions draw
+/// from the seed of the border
+///
+/// \param[in] Options the size and the seed of the dungeon
+/// \return the layout of the dungeon
+export auto carveDungeon(const DungeonOptions &options) -> DungeonMap {
+  DungeonMap map{options.cells};
+  const RegionSplit columns{
+      std::max(options.cells.x / std::max(options.regionSize, minLeaf), 1),
+      options.cells.x};
+  const RegionSplit rows{
+      std::max(options.cells.y / std::max(options.regionSize, minLeaf), 1),
+      options.cells.y};
+
+  // the door of a border between two regions, along the border and away from
+  // its ends so the rooms keep their walls
+  const auto door = [&options](const RegionSplit &split, int region,
+                               std::int64_t border, bool vertical) {
+    const auto size = split.size(region);
+    const auto margin = std::min(wallRows + 1, (size - 1) / 2);
+    const auto span =
+        static_cast<std::uint64_t>(std::max(size - (2 * margin), 1));
+    const auto offset =
+        hashOf(options.seed, border, region, vertical ? 1 : 0) % span;
+    return split.start(region) + margin + static_cast<int>(offset);
+  };
+
+  const auto regions =
+      static_cast<size_t>(columns.count) * static_cast<size_t>(rows.count);
+  parallelFor(regions, options.threads, [&](size_t index) {
+    const auto column =
+        static_cast<int>(index % static_cast<size_t>(columns.count));
+    const auto row =
+        static_cast<int>(index / static_cast<size_t>(columns.count));
+    const SDL_Rect region{columns.start(column), rows.start(row),
+                          columns.size(column), rows.size(row)};
+    if (region.w < minLeaf || region.h < minLeaf) {
+      return;
+    }
+
+    SplitMix random{hashOf(options.seed, column, row)};
+    const auto hub = carveArea(map, region, random);
+
+    // a door is drawn from its border, so the regions on both sides of a
+    // border dig to the same place
+    if (column + 1 < columns.count) {
+      const SDL_Point exit{region.x + region.w - 1,
+                           door(rows, row, column + 1, true)};
+      carveCorridor(map, hub, {hub.x, exit.y});
+      carveCorridor(map, {hub.x, exit.y}, exit);
+    }
+    if (column > 0) {
+      const SDL_Point exit{region.x, door(rows, row, column, true)};
+      carveCorridor(map, hub, {hub.x, exit.y});
+      carveCorridor(map, {hub.x, exit.y}, exit);
+    }
+    if (row + 1 < rows.count) {
+      const SDL_Point exit{door(columns, column, row + 1, false),
+                           region.y + region.h - 1};
+      carveCorridor(map, {exit.x, hub.y}, exit);
+      carveCorridor(map, hub, {exit.x, hub.y});
+    }
+    if (row > 0) {
+      const SDL_Point exit{door(columns, column, row, false), region.y};
+      carveCorridor(map, {exit.x, hub.y}, exit);
+      carveCorridor(map, hub, {exit.x, hub.y});
+    }
+  });
+  return map;
+}
+
+/// the tiles the dungeon is dressed with
+namespace dungeonTiles {
+inline constexpr auto floor = *findTileType("floor_1");
+/// the cracked floors, drawn on a few cells
+inline constexpr std::array crackedFloors{
+    *findTileType("floor_2"), *findTileType("floor_3"),
+    *findTileType("floor_4"), *findTileType("floor_5"),
+    *findTileType("floor_6"), *findTileType("floor_7"),
+    *findTileType("floor_8")};
+inline constexpr auto wall = *findTileType("wall_mid");
+/// the decorated walls, drawn on a few cells
+inline constexpr std::array decoratedWalls{
+    *findTileType("wall_hole_1"), *findTileType("wall_hole_2"),
+    *findTileType("wall_banner_red"), *findTileType("wall_banner_blue"),
+    *findTileType("wall_banner_green"), *findTileType("wall_banner_yellow")};
+inline constexpr auto wallTop = *findTileType("wall_top_mid");
+inline constexpr auto sideLeft = *findTileType("wall_outer_mid_left");
+inline constexpr auto sideRight = *findTileType("wall_outer_mid_right");
+inline constexpr auto cornerTopLeft = *findTileType("wall_outer_top_left");
+inline constexpr auto cornerTopRight = *findTileType("wall_outer_top_right");
+inline constexpr auto cornerFrontLeft =
+    *findTileType("wall_outer_front_left");
+inline constexpr auto cornerFrontRight =
+    *findTileType("wall_outer_front_right");
+} // namespace dungeonTiles
+
+/// the rows of cells dressed by each job
+inline constexpr int dressedRows{64};
+
+/// dress the rock around the floor with walls
+///
+/// the walls follow the tileset: the rock above a floor shows the face of
+/// the wall with its top in the cell above, the rock under a floor and on
+/// its sides only shows the edges of the wall, and the corners close the
+/// edges where they meet
+///
+/// \param[in] Map the layout of the dungeon
+/// \param[in] Options the options the layout was carved with
+/// \return the tiles of the dungeon, row by row
+export auto dressDungeon(const DungeonMap &map, const DungeonOptions &options)
+    -> LevelSnapshot {
+  const auto cells = map.cells();
+  const auto isRock = [&map, &cells](int x, int y) {
+    return x >= 0 && y >= 0 && x < cells.x && y < cells.y &&
+           !map.isFloor(x, y);
+  };
+  // the rock with a floor under it, above it, and the rock over a face
+  const auto isFace = [&](int x, int y) {
+    return isRock(x, y) && map.isFloor(x, y + 1);
+  };
+  const auto isBottom = [&](int x, int y) {
+    return isRock(x, y) && map.isFloor(x, y - 1);
+  };
+  const auto isTop = [&](int x, int y) {
+    return isRock(x, y) && isFace(x, y + 1);
+  };
+
+  const auto bands =
+      static_cast<size_t>((cells.y + dressedRows - 1) / dressedRows);
+  std::vector<LevelSnapshot> dressed(bands);
+  parallelFor(bands, options.threads, [&](size_t band) {
+    auto &tiles = dressed[band];
+    const auto first = static_cast<int>(band) * dressedRows;
+    const auto last = std::min(first + dressedRows, cells.y);
+    for (auto y = first; y < last; ++y) {
+      for (auto x = 0; x < cells.x; ++x) {
+        // a tile position is the bottom left corner of its cell
+        const SDL_FPoint pos{static_cast<float>(x) * options.cellSize,
+                             static_cast<float>(y + 1) * options.cellSize};
+        const auto variant = hashOf(options.seed, x, y, 2);
+        constexpr std::uint64_t rareVariant{16};
+        const auto pick = [variant](const auto &variants) {
+          return variants[(variant / rareVariant) % variants.size()];
+        };
+        const auto wall = [&tiles, &pos](TileTypeId typeId, bool level) {
+          tiles.walls.push_back({.typeId = typeId, .pos = pos, .level = level});
+        };
+
+        if (map.isFloor(x, y)) {
+          tiles.floor.push_back(
+              {.typeId = variant % rareVariant == 0
+                             ? pick(dungeonTiles::crackedFloors)
+                             : dungeonTiles::floor,
+               .pos = pos,
+               .level = false});
+          continue;
+        }
+        if (!isRock(x, y)) {
+          continue;
+        }
+
+        const auto face = isFace(x, y);
+        const auto top = isTop(x, y);
+        if (face) {
+          wall(variant % rareVariant == 0 ? pick(dungeonTiles::decoratedWalls)
+                                          : dungeonTiles::wall,
+               false);
+        }
+        if (top || isBottom(x, y)) {
+          wall(dungeonTiles::wallTop, true);
+        }
+
+        // the edges of the floors on the right and on the left
+        if (map.isFloor(x + 1, y) || (isFace(x + 1, y) && !face)) {
+          wall(dungeonTiles::sideLeft, true);
+        } else if (isTop(x + 1, y) && !top && !face) {
+          wall(dungeonTiles::cornerTopLeft, true);
+        } else if (isBottom(x + 1, y) && !isBottom(x, y)) {
+          wall(dungeonTiles::cornerFrontLeft, false);
+        }
+        if (map.isFloor(x - 1, y) || (isFace(x - 1, y) && !face)) {
+          wall(dungeonTiles::sideRight, true);
+        } else if (isTop(x - 1, y) && !top && !face) {
+          wall(dungeonTiles::cornerTopRight, true);
+        } else if (isBottom(x - 1, y) && !isBottom(x, y)) {
+          wall(dungeonTiles::cornerFrontRight, false);
+        }
+      }
+    }
+  });
+
+  LevelSnapshot level;
+  size_t floorCount{};
+  size_t wallCount{};
+  for (const auto &band : dressed) {
+    floorCount += band.floor.size();
+    wallCount += band.walls.size();
+  }
+  level.floor.reserve(floorCount);
+  level.walls.reserve(wallCount);
+  for (auto &band : dressed) {
+    level.floor.insert(level.floor.end(), band.floor.begin(),
+                       band.floor.end());
+    level.walls.insert(level.walls.end(), band.walls.begin(),
+                       band.walls.end());
+    band = {};
+  }
+  return level;
+}
+
+/// generate a dungeon of rooms and corridors
+///
+/// \param[in] Options the size and the seed of the dungeon
+/// \return the tiles of the dungeon, row by row
+export auto generateDungeon(const DungeonOptions &options) -> LevelSnapshot {
+  return dressDungeon(carveDungeon(options), options);
+}
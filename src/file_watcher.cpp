@@ -0,0 +1,155 @@
+module;
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+export module fileWatcher;
+
+/// call a function on a dedicated thread each time a watched file is written
+///
+/// the directories of the files are watched with inotify, so the files
+/// replaced by a rename, as most editors save, are seen too. The changes read
+/// together are reported once per file. Where inotify is not available
+/// nothing is watched
+export class FileWatcher {
+public:
+  /// constructor
+  ///
+  /// \param[in] Paths the files to watch
+  /// \param[in] OnChange called on the watcher thread with the index in Paths
+  ///   of a file written
+  FileWatcher(std::vector<std::filesystem::path> paths,
+              std::function<void(size_t)> onChange);
+
+  FileWatcher(const FileWatcher &) = delete;
+  FileWatcher(FileWatcher &&) = delete;
+  auto operator=(const FileWatcher &) -> FileWatcher & = delete;
+  auto operator=(FileWatcher &&) -> FileWatcher & = delete;
+
+  ~FileWatcher();
+
+  /// whether the files are watched
+  [[nodiscard]] auto isWatching() const noexcept -> bool {
+    return descriptor_ >= 0;
+  }
+
+private:
+  /// a watched directory
+  struct Directory {
+    int watch;
+    std::filesystem::path path;
+  };
+
+  /// the watcher thread main loop
+  auto run(const std::stop_token &stopToken) -> void;
+
+  /// the time a wait for events lasts before checking for a stop request
+  static constexpr int pollTimeout{100};
+
+  std::vector<std::filesystem::path> paths_;
+  std::function<void(size_t)> onChange_;
+  int descriptor_{-1};
+  std::vector<Directory> directories_;
+
+  /// declared last so it is joined before the other members are destroyed
+  std::jthread thread_;
+};
+
+FileWatcher::FileWatcher(std::vector<std::filesystem::path> paths,
+                         std::function<void(size_t)> onChange)
+    : paths_{std::move(paths)}, onChange_{std::move(onChange)} {
+#if defined(__linux__)
+  descriptor_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (descriptor_ < 0) {
+    return;
+  }
+
+  for (auto &path : paths_) {
+    path = std::filesystem::absolute(path).lexically_normal();
+    const auto directory = path.parent_path();
+    if (std::ranges::any_of(directories_, [&directory](const auto &watched) {
+          return watched.path == directory;
+        })) {
+      continue;
+    }
+    const auto watch = inotify_add_watch(descriptor_, directory.c_str(),
+                                         IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watch >= 0) {
+      directories_.push_back({.watch = watch, .path = directory});
+    }
+  }
+
+  thread_ = std::jthread{
+      [this](const std::stop_token &stopToken) { run(stopToken); }};
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+  thread_ = {};
+#if defined(__linux__)
+  if (descriptor_ >= 0) {
+    close(descriptor_);
+  }
+#endif
+}
+
+auto FileWatcher::run(const std::stop_token &stopToken) -> void {
+#if defined(__linux__)
+  // large enough for several events, aligned as inotify_event
+  alignas(inotify_event) std::array<char, 4096> buffer{};
+  std::vector<bool> changed(paths_.size());
+
+  while (!stopToken.stop_requested()) {
+    pollfd request{.fd = descriptor_, .events = POLLIN, .revents = 0};
+    if (poll(&request, 1, pollTimeout) <= 0) {
+      continue;
+    }
+
+    // drain every pending event before reporting the changed files
+    changed.assign(paths_.size(), false);
+    for (auto size = read(descriptor_, buffer.data(), buffer.size()); size > 0;
+         size = read(descriptor_, buffer.data(), buffer.size())) {
+      for (ssize_t offset = 0; offset < size;) {
+        inotify_event event{};
+        std::memcpy(&event, buffer.data() + offset, sizeof(event));
+        const std::string name{event.len > 0
+                                   ? buffer.data() + offset + sizeof(event)
+                                   : ""};
+        offset += static_cast<ssize_t>(sizeof(event) + event.len);
+
+        const auto directory =
+            std::ranges::find(directories_, event.wd, &Directory::watch);
+        if (directory == directories_.end()) {
+          continue;
+        }
+        for (size_t index = 0; index < paths_.size(); ++index) {
+          if (paths_[index] == directory->path / name) {
+            changed[index] = true;
+          }
+        }
+      }
+    }
+
+    for (size_t index = 0; index < paths_.size(); ++index) {
+      if (changed[index]) {
+        onChange_(index);
+      }
+    }
+  }
+#endif
+}
@@ -0,0 +1,334 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <vector>
+
+export module fov;
+
+/// a grid of bits, each row packed in 64 bit words
+export class BitGrid {
+public:
+  BitGrid() = default;
+  /// constructor, every bit is cleared
+  ///
+  /// \param[in] Width the number of columns
+  /// \param[in] Height the number of rows
+  BitGrid(int width, int height)
+      : width_{width}, height_{height},
+        wordsPerRow_{(static_cast<size_t>(width) + wordBits - 1) / wordBits},
+        words_(wordsPerRow_ * static_cast<size_t>(height)) {}
+
+  [[nodiscard]] auto contains(int x, int y) const noexcept -> bool {
+    return x >= 0 && y >= 0 && x < width_ && y < height_;
+  }
+
+  /// get a bit, false outside of the grid
+  [[nodiscard]] auto test(int x, int y) const noexcept -> bool {
+    if (!contains(x, y)) {
+      return false;
+    }
+    return ((words_[wordIndex(x, y)] >> bitIndex(x)) & 1U) != 0;
+  }
+
+  /// set or clear a bit, ignored outside of the grid
+  auto set(int x, int y, bool value = true) noexcept -> void {
+    if (!contains(x, y)) {
+      return;
+    }
+    const auto mask = std::uint64_t{1} << bitIndex(x);
+    auto &word = words_[wordIndex(x, y)];
+    word = value ? word | mask : word & ~mask;
+  }
+
+  /// clear every bit of the rows from first to last, bounds included
+  auto clearRows(int first, int last) noexcept -> void {
+    first = std::max(first, 0);
+    last = std::min(last, height_ - 1);
+    if (first > last) {
+      return;
+    }
+    std::fill(words_.begin() + static_cast<std::ptrdiff_t>(rowStart(first)),
+              words_.begin() + static_cast<std::ptrdiff_t>(rowStart(last + 1)),
+              std::uint64_t{0});
+  }
+
+  /// set the bits set in other for the rows from first to last
+  auto mergeRows(const BitGrid &other, int first, int last) noexcept -> void {
+    first = std::max(first, 0);
+    last = std::min(last, height_ - 1);
+    for (auto index = rowStart(first);
+         first <= last && index < rowStart(last + 1); ++index) {
+      words_[index] |= other.words_[index];
+    }
+  }
+
+  /// the number of bits set
+  [[nodiscard]] auto count() const noexcept -> size_t {
+    size_t total{};
+    for (const auto word : words_) {
+      total += static_cast<size_t>(std::popcount(word));
+    }
+    return total;
+  }
+
+  [[nodiscard]] auto width() const noexcept -> int { return width_; }
+  [[nodiscard]] auto height() const noexcept -> int { return height_; }
+
+private:
+  static constexpr size_t wordBits{64};
+
+  [[nodiscard]] auto rowStart(int y) const noexcept -> size_t {
+    return static_cast<size_t>(y) * wordsPerRow_;
+  }
+  [[nodiscard]] auto wordIndex(int x, int y) const noexcept -> size_t {
+    return rowStart(y) + (static_cast<size_t>(x) / wordBits);
+  }
+  [[nodiscard]] static auto bitIndex(int x) noexcept -> unsigned {
+    return static_cast<unsigned>(static_cast<size_t>(x) % wordBits);
+  }
+
+  int width_{};
+  int height_{};
+  size_t wordsPerRow_{};
+  std::vector<std::uint64_t> words_;
+};
+
+/// a slope of the shadowcasting, as an exact fraction with den > 0
+struct Slope {
+  int num;
+  int den;
+};
+
+/// floor of a division for a positive divisor
+constexpr auto floorDiv(int num, int den) noexcept -> int {
+  return num >= 0 ? num / den : -((-num + den - 1) / den);
+}
+
+/// one of the four quadrants scanned from the origin
+enum class Quadrant : std::uint8_t { North, East, South, West };
+
+/// the cells visible from a point of a grid
+///
+/// computed by symmetric shadowcasting: a cell is visible from another exactly
+/// when the other is visible from it, so whether an enemy sees the player is
+/// whether the player sees the enemy cell. The opaque, visible and explored
+/// cells are kept in packed bit rows
+export class FieldOfView {
+public:
+  /// constructor
+  ///
+  /// \param[in] Width the number of columns
+  /// \param[in] Height the number of rows
+  FieldOfView(int width, int height)
+      : opaque_{width, height}, visible_{width, height},
+        explored_{width, height} {}
+
+  /// set whether a cell blocks the sight
+  auto setOpaque(int x, int y, bool opaque) noexcept -> void {
+    opaque_.set(x, y, opaque);
+  }
+
+  /// compute the visible cells, and add them to the explored cells
+  ///
+  /// \param[in] X the column of the origin
+  /// \param[in] Y the row of the origin
+  /// \param[in] Radius the maximum distance of a visible cell
+  auto compute(int x, int y, int radius) -> void;
+
+  /// whether a cell blocks the sight, cells out of the grid do not
+  [[nodiscard]] auto isOpaque(int x, int y) const noexcept -> bool {
+    return opaque_.test(x, y);
+  }
+
+  /// whether a cell was visible at the last compute
+  [[nodiscard]] auto isVisible(int x, int y) const noexcept -> bool {
+    return visible_.test(x, y);
+  }
+
+  /// whether a cell was ever visible
+  [[nodiscard]] auto isExplored(int x, int y) const noexcept -> bool {
+    return explored_.test(x, y);
+  }
+
+  /// whether nothing opaque is strictly between two cells
+  ///
+  /// for the queries between two cells which are not the origin of the last
+  /// compute, like two enemies
+  [[nodiscard]] auto hasLineOfSight(int fromX, int fromY, int toX,
+                                    int toY) const noexcept -> bool;
+
+  /// forget the explored cells
+  auto resetExplored() noexcept -> void {
+    explored_.clearRows(0, explored_.height() - 1);
+  }
+
+  [[nodiscard]] auto visible() const noexcept -> const BitGrid & {
+    return visible_;
+  }
+
+private:
+  /// a row of cells of a quadrant, depth away from the origin
+  struct Row {
+    int depth;
+    Slope start;
+    Slope end;
+  };
+
+  /// the column and row of a cell of a quadrant
+  template <Quadrant Direction>
+  [[nodiscard]] auto transform(int depth, int column) const noexcept
+      -> std::array<int, 2>;
+
+  /// whether a cell of a quadrant blocks the sight, out of the grid does
+  template <Quadrant Direction>
+  [[nodiscard]] auto isWall(int depth, int column) const noexcept -> bool;
+
+  /// mark a cell of a quadrant visible if it is in the radius
+  template <Quadrant Direction>
+  auto reveal(int depth, int column) noexcept -> void;
+
+  /// scan a quadrant row by row
+  template <Quadrant Direction> auto scan() -> void;
+
+  BitGrid opaque_;
+  BitGrid visible_;
+  BitGrid explored_;
+
+  int originX_{};
+  int originY_{};
+  int radius_{};
+  /// rows waiting to be scanned, kept to reuse its memory
+  std::vector<Row> rows_;
+};
+
+template <Quadrant Direction>
+auto FieldOfView::transform(int depth, int column) const noexcept
+    -> std::array<int, 2> {
+  if constexpr (Direction == Quadrant::North) {
+    return {originX_ + column, originY_ - depth};
+  } else if constexpr (Direction == Quadrant::South) {
+    return {originX_ + column, originY_ + depth};
+  } else if constexpr (Direction == Quadrant::East) {
+    return {originX_ + depth, originY_ + column};
+  } else {
+    return {originX_ - depth, originY_ + column};
+  }
+}
+
+template <Quadrant Direction>
+auto FieldOfView::isWall(int depth, int column) const noexcept -> bool {
+  const auto [x, y] = transform<Direction>(depth, column);
+  return !opaque_.contains(x, y) || opaque_.test(x, y);
+}
+
+template <Quadrant Direction>
+auto FieldOfView::reveal(int depth, int column) noexcept -> void {
+  if ((depth * depth) + (column * column) > radius_ * radius_) {
+    return;
+  }
+  const auto [x, y] = transform<Direction>(depth, column);
+  visible_.set(x, y);
+}
+
+auto FieldOfView::compute(int x, int y, int radius) -> void {
+  // only the rows of the previous and of the new disk can hold visible cells
+  visible_.clearRows(originY_ - radius_, originY_ + radius_);
+  originX_ = x;
+  originY_ = y;
+  radius_ = radius;
+
+  visible_.set(x, y);
+  scan<Quadrant::North>();
+  scan<Quadrant::East>();
+  scan<Quadrant::South>();
+  scan<Quadrant::West>();
+  explored_.mergeRows(visible_, y - radius, y + radius);
+}
+
+template <Quadrant Direction> auto FieldOfView::scan() -> void {
+  rows_.clear();
+  rows_.push_back({.depth = 1, .start = {-1, 1}, .end = {1, 1}});
+
+  while (!rows_.empty()) {
+    auto row = rows_.back();
+    rows_.pop_back();
+    if (row.depth > radius_) {
+      continue;
+    }
+
+    // the columns from round_ties_up(depth * start) to
+    // round_ties_down(depth * end), out of the radius a cell only shadows
+    // cells further away so the row is cut to the disk
+    const auto halfWidth = static_cast<int>(
+        std::sqrt((radius_ * radius_) - (row.depth * row.depth)));
+    const auto minColumn =
+        std::max(floorDiv((2 * row.depth * row.start.num) + row.start.den,
+                          2 * row.start.den),
+                 -halfWidth);
+    const auto maxColumn =
+        std::min(-floorDiv((-2 * row.depth * row.end.num) + row.end.den,
+                           2 * row.end.den),
+                 halfWidth);
+
+    std::optional<bool> previousWall;
+    for (auto column = minColumn; column <= maxColumn; ++column) {
+      const auto wall = isWall<Direction>(row.depth, column);
+      // a floor cell is only visible if its center is inside the row slopes,
+      // which makes the field of view symmetric
+      const auto symmetric =
+          column * row.start.den >= row.depth * row.start.num &&
+          column * row.end.den <= row.depth * row.end.num;
+      if (wall || symmetric) {
+        reveal<Direction>(row.depth, column);
+      }
+
+      const Slope slope{(2 * column) - 1, 2 * row.depth};
+      if (previousWall == true && !wall) {
+        row.start = slope;
+      }
+      if (previousWall == false && wall) {
+        rows_.push_back(
+            {.depth = row.depth + 1, .start = row.start, .end = slope});
+      }
+      previousWall = wall;
+    }
+    if (previousWall == false) {
+      rows_.push_back(
+          {.depth = row.depth + 1, .start = row.start, .end = row.end});
+    }
+  }
+}
+
+auto FieldOfView::hasLineOfSight(int fromX, int fromY, int toX,
+                                 int toY) const noexcept -> bool {
+  const auto deltaX = std::abs(toX - fromX);
+  const auto deltaY = -std::abs(toY - fromY);
+  const auto stepX = fromX < toX ? 1 : -1;
+  const auto stepY = fromY < toY ? 1 : -1;
+  auto error = deltaX + deltaY;
+
+  auto x = fromX;
+  auto y = fromY;
+  while (x != toX || y != toY) {
+    const auto doubled = 2 * error;
+    if (doubled >= deltaY) {
+      error += deltaY;
+      x += stepX;
+    }
+    if (doubled <= deltaX) {
+      error += deltaX;
+      y += stepY;
+    }
+    if ((x != toX || y != toY) && opaque_.test(x, y)) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -13,26 +13,60 @@ module;
 #include "SDL3/SDL_timer.h"
 #include "SDL3/SDL_video.h"
 #include <SDL3/SDL.h>
+#include <SDL3/SDL_hints.h>
 #include <SDL3/SDL_render.h>
 
 #include <SDL3_image/SDL_image.h>
 
 #include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <cmath>
+#include <filesystem>
 #include <format>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
 #include <span>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 export module game;
 
 import sprite;
 import tile;
+import tileOrder;
+import tileTypes;
+import animation;
 import sdlHelpers;
 import gui;
+import input;
+import drawList;
+import worker;
+import light;
+import fov;
+import ai;
+import pool;
+import particles;
+import damage;
+import fileWatcher;
+import snapshot;
+import snapshotLink;
+import script;
+import occlusion;
+import scene;
+import viewport;
+import image;
+import renderBackend;
+import memory;
 
 struct Rad {
   float value;
@@ -93,6 +127,11 @@ public:
   /// set a new speed
   auto updateSpeed(float newSpeed) noexcept -> void { vec_.radius = newSpeed; }
 
+  /// whether an update moves the character
+  [[nodiscard]] auto isMoving() const noexcept -> bool {
+    return vec_.radius != 0;
+  }
+
   /// update the position of the character
   /// \param[in] deltaTime the time since the last update
   auto update(Uint64 deltaTime) noexcept -> void {
@@ -121,6 +160,9 @@ public:
   /// get the position of the character
   [[nodiscard]] auto getPos() const noexcept -> Point { return pos_; }
 
+  /// get the direction of the character
+  [[nodiscard]] auto getAngle() const noexcept -> Rad { return vec_.angle; }
+
   static constexpr float speed{0.06};
 
 private:
@@ -132,9 +174,148 @@ private:
   CharacterSprite *renderable_;
 };
 
+/// command line options of the game
+export struct GameOptions {
+  /// parse the command line
+  ///
+  /// the command line is in the form:\n
+  /// '[--record File] [--replay File] [--headless] [--serve Port]
+  /// [--observe Port] [--renderer sdl|software|null]'
+  static auto fromArgs(std::span<char *> args) -> GameOptions;
+
+  /// set the SDL hints for the options, to call before creating the Game
+  auto applyHints() const noexcept -> void;
+
+  /// record the input of every tick to this file
+  std::optional<std::filesystem::path> recordPath;
+  /// play the input recorded in this file instead of the live input
+  std::optional<std::filesystem::path> replayPath;
+  /// render offscreen, and replay as fast as possible
+  bool headless{};
+  /// publish the snapshots of the simulation on this loopback port
+  std::optional<std::uint16_t> servePort;
+  /// show the snapshots published on this loopback port instead of
+  /// simulating
+  std::optional<std::uint16_t> observePort;
+  /// the backend drawing the scene
+  BackendKind backend{BackendKind::Sdl};
+};
+
+/// parse a port number
+///
+/// \return the port, nullopt if the argument is not a port number
+auto parsePort(std::string_view arg) -> std::optional<std::uint16_t> {
+  std::uint16_t port{};
+  const auto [end, error] =
+      std::from_chars(arg.data(), arg.data() + arg.size(), port);
+  if (error != std::errc{} || end != arg.data() + arg.size()) {
+    return std::nullopt;
+  }
+  return port;
+}
+
+auto GameOptions::fromArgs(std::span<char *> args) -> GameOptions {
+  GameOptions options;
+  for (size_t index = 1; index < args.size(); ++index) {
+    const std::string_view arg{args[index]};
+    if (arg == "--headless") {
+      options.headless = true;
+    } else if (arg == "--record" && index + 1 < args.size()) {
+      options.recordPath = args[++index];
+    } else if (arg == "--replay" && index + 1 < args.size()) {
+      options.replayPath = args[++index];
+    } else if (arg == "--serve" && index + 1 < args.size()) {
+      options.servePort = parsePort(args[++index]);
+    } else if (arg == "--observe" && index + 1 < args.size()) {
+      options.observePort = parsePort(args[++index]);
+    } else if (arg == "--renderer" && index + 1 < args.size()) {
+      const std::string_view name{args[++index]};
+      if (const auto backend = findBackendKind(name)) {
+        options.backend = *backend;
+      } else {
+        std::cerr << std::format("ignoring unknown renderer '{}'\n", name);
+      }
+    } else {
+      std::cerr << std::format("ignoring unknown argument '{}'\n", arg);
+    }
+  }
+  return options;
+}
+
+auto GameOptions::applyHints() const noexcept -> void {
+  if (headless) {
+    SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen");
+  }
+}
+
+/// whether a tile of this type splashes water
+constexpr auto isFountainBasin(const TileType &type) -> bool {
+  return type.name.starts_with("wall_fountain_basin");
+}
+
+/// the number of ticks between two decisions of an enemy of this type
+constexpr auto aiInterval(const TileType &type) -> std::uint32_t {
+  constexpr std::uint32_t bossInterval{2};
+  constexpr std::uint32_t defaultInterval{4};
+  constexpr std::uint32_t slowInterval{8};
+  if (type.name.starts_with("big_")) {
+    return bossInterval;
+  }
+  if (type.name.starts_with("tiny_") || type.name.contains("slug")) {
+    return slowInterval;
+  }
+  return defaultInterval;
+}
+
+/// an enemy spawned in the world
+struct Enemy {
+  CharacterSprite sprite;
+  Point pos;
+  /// the movement chosen by the last decision, the radius is per ms
+  PolarVec heading;
+};
+
+/// what a transient entity does
+enum class TransientKind : std::uint8_t { Projectile, Coin };
+
+/// a short lived entity, kept in a Pool
+struct Transient {
+  TransientKind kind;
+  TileTypeId typeId;
+  Point pos;
+  /// the movement of the entity, the radius is per ms
+  PolarVec heading;
+  /// the time before the entity despawns in ms
+  Uint64 lifetime;
+  /// the time since the entity spawned in ms
+  Uint64 age;
+};
+
+inline constexpr TileTypeId projectileTypeId{
+    *findTileType("weapon_throwing_axe")};
+/// the coin frames are consecutive types
+inline constexpr TileTypeId coinTypeId{*findTileType("coin_anim_f0")};
+inline constexpr Uint64 coinFrames{4};
+
+/// the frames of the scripted tiles are consecutive types
+inline constexpr TileTypeId spikesTypeId{*findTileType("floor_spikes_anim_f0")};
+inline constexpr TileTypeId spikesFrames{4};
+inline constexpr TileTypeId leverLeftTypeId{*findTileType("lever_left")};
+inline constexpr TileTypeId leverRightTypeId{*findTileType("lever_right")};
+inline constexpr TileTypeId doorClosedTypeId{
+    *findTileType("doors_leaf_closed")};
+inline constexpr TileTypeId doorOpenTypeId{*findTileType("doors_leaf_open")};
+inline constexpr TileTypeId chestFullTypeId{
+    *findTileType("chest_full_open_anim_f0")};
+inline constexpr TileTypeId chestEmptyTypeId{
+    *findTileType("chest_empty_open_anim_f0")};
+inline constexpr TileTypeId chestMimicTypeId{
+    *findTileType("chest_mimic_open_anim_f0")};
+inline constexpr TileTypeId chestFrames{3};
+
 export class Game final {
 public:
-  Game();
+  explicit Game(const GameOptions &options = {});
   ~Game();
 
   Game(const Game &) = delete;
@@ -143,7 +324,9 @@ public:
   auto operator=(Game &&) -> Game & = delete;
 
   /// process Sdl events
-  auto processEvent() noexcept -> void;
+  ///
+  /// \return whether an event was processed
+  auto processEvent() -> bool;
   /// process event in editor mode
   auto processEventEditor(const SDL_Event &event) noexcept -> bool;
   /// process event for the character
@@ -151,10 +334,116 @@ public:
 
   auto loadEntities() noexcept -> void;
 
-  auto render() noexcept -> void;
+  /// add the world of the frame to a draw list
+  auto render(DrawList &drawList) -> void;
+
+  /// simulate a tick and build its draw list, run on the simulation thread
+  auto simulate() -> void;
+  /// whether a tick changes the world without any input
+  [[nodiscard]] auto isAnimating() const noexcept -> bool;
+
+  /// throw a projectile in the direction the player faces
+  auto throwProjectile() noexcept -> void;
+  /// move the transient entities and despawn the finished ones
+  auto updateTransients() -> void;
+  /// add the transient entities to a draw list
+  auto renderTransients(DrawList &drawList) const -> void;
+  /// emit the periodic particles and move every particle
+  auto updateParticles() -> void;
+
+  /// add an enemy of the selected type to the world
+  auto spawnEnemy(const SDL_FPoint &pos) -> void;
+  /// run the decision logic of an enemy, scheduled by ai_
+  auto think(AgentId id) -> void;
+  /// move the enemies along their heading
+  auto updateEnemies() -> void;
+
+  /// update the light map and the field of view for a tile placed by the
+  /// editor
+  ///
+  /// \param[in] Pos the position of the tile
+  /// \param[in] Wall whether the tile is in the wall layer
+  /// \param[in] TypeId the type of the tile, nullopt when it was removed
+  auto updateGrids(const SDL_FPoint &pos, bool wall,
+                   std::optional<TileTypeId> typeId) -> void;
+  /// recompute the light map and the field of view from the whole level
+  auto rebuildGrids() -> void;
+  /// get the color modulation of a position
+  ///
+  /// \return the color, or nullopt if the fog of war hides the position
+  [[nodiscard]] auto tileColor(const SDL_FPoint &pos) const noexcept
+      -> std::optional<SDL_Color>;
+
+  /// place or remove a tile, and publish the edit
+  ///
+  /// \param[in] Pos the position of the tile
+  /// \param[in] Wall whether the tile is in the wall layer
+  /// \param[in] Level whether the tile is on the ground or in the air
+  /// \param[in] TypeId the type of the tile, nullopt to remove it
+  auto setTile(const SDL_FPoint &pos, bool wall, bool level,
+               std::optional<TileTypeId> typeId) -> void;
+  /// the state of the characters, the player first then the enemies
+  [[nodiscard]] auto captureEntities() const -> std::vector<EntityState>;
+  /// every placed tile, as edits
+  [[nodiscard]] auto captureTiles() const -> std::vector<TileEdit>;
+  /// show the last snapshot received from the server
+  auto receiveSnapshot() -> void;
+
+  /// start the script of a placed tile, if its type has one
+  ///
+  /// \param[in] Tile the tile, the script is cancelled before it is removed
+  /// \param[in] Wall whether the tile is in the wall layer
+  auto attachScript(TileConcrete &tile, bool wall) -> void;
+  /// cancel the script of the tile at a position
+  auto detachScript(const SDL_FPoint &pos, bool wall) -> void;
+  /// restart the scripts of every tile, when a level is loaded
+  auto rebuildScripts() -> void;
+  /// change the type of a tile from a script, update the minimap and the
+  /// grids and publish the edit
+  auto setTileType(TileConcrete &tile, bool wall, TileTypeId typeId) -> void;
+  /// raise the spikes now and then, hurting the player standing on them
+  auto spikesScript(TileConcrete &tile, bool wall) -> ScriptTask;
+  /// flip the lever and open or close the doors when the player steps on it
+  auto leverScript(TileConcrete &tile, bool wall, TriggerId stepped)
+      -> ScriptTask;
+  /// open or close the door each time a lever is pulled
+  auto doorScript(TileConcrete &tile, bool wall) -> ScriptTask;
+  /// open the chest when the player steps on it, once
+  auto chestScript(TileConcrete &tile, bool wall, TriggerId stepped)
+      -> ScriptTask;
+
+  /// load a changed asset, called on the watcher thread
+  ///
+  /// \param[in] Index the index of the asset in the watched paths
+  auto reloadAsset(size_t index) -> void;
+  /// use the assets reloaded since the last frame, called between two
+  /// simulations
+  auto swapAssets() -> void;
+
+  /// create the back buffer and the backend drawing into it, the back
+  /// buffer starts black
+  auto createBackend(BackendKind kind) -> void;
 
   auto frame() -> void;
-  auto checkKeys() noexcept -> void;
+  /// redraw the damaged areas of the back buffer and present the frame,
+  /// nothing is presented when neither the world nor the gui changed
+  auto present() -> void;
+  auto checkKeys() -> void;
+
+  /// get the next event, from the replay or from SDL
+  auto pollEvent(SDL_Event &event) -> bool;
+  /// get the mouse position, from the replay or from SDL
+  auto mousePosition() -> SDL_FPoint;
+  /// get the world position under a window position
+  [[nodiscard]] auto toScene(const SDL_FPoint &pos) const noexcept
+      -> SDL_FPoint;
+  /// get the keyboard state, from the replay or from SDL
+  auto keyboardState() -> std::span<const bool>;
+  /// print the frame times measured during the replay
+  auto reportReplay() const -> void;
+  /// print the memory of every subsystem, and its allocation rate since the
+  /// game started
+  auto reportMemory() -> void;
 
   [[nodiscard]] auto done() const noexcept -> bool { return done_; }
 
@@ -162,10 +451,51 @@ private:
   static constexpr float gridSize{16};
   static constexpr Uint64 minFrameDuration{1000 / 30};
   static constexpr Uint32 minimizedDelay{10};
+  /// the longest wait for an event when nothing changes, so the reloaded
+  /// assets and the gui timers are still picked up
+  static constexpr Sint32 maxIdleWait{250};
   static constexpr SDL_Point windowSize{1280, 720};
+  /// the world area drawn, at the resolution of the art
+  static constexpr SDL_Point sceneSize{640, 360};
   static constexpr Point playerStartingPoint{.x = 100, .y = 100};
+  static constexpr SDL_Point gridCells{256, 256};
+  static constexpr int fovRadius{16};
+  static constexpr std::chrono::microseconds aiBudget{500};
+  /// the budget of the ai in updates, when recording or replaying
+  static constexpr size_t aiMaxUpdates{64};
+  static constexpr float enemySpeed{0.04};
+  static constexpr std::uint32_t maxTransients{16384};
+  static constexpr float projectileSpeed{0.2};
+  static constexpr Uint64 projectileLifetime{1000};
+  static constexpr Uint64 coinLifetime{30000};
+  static constexpr Uint64 coinFrameDuration{100};
+  static constexpr size_t maxParticles{16384};
+  /// the time between two emissions of splashes in ms
+  static constexpr Uint64 effectInterval{100};
+  static constexpr size_t sparkCount{12};
+  static constexpr size_t splashCount{4};
+  static constexpr size_t dustCount{2};
+  static constexpr std::uint32_t maxScripts{65536};
+  static constexpr Uint64 spikesDownDuration{2000};
+  static constexpr Uint64 spikesUpDuration{1000};
+  static constexpr Uint64 tileFrameDuration{100};
+  static constexpr size_t chestCoins{3};
+  /// the world area on the screen
+  static constexpr SDL_FRect cameraView{0, 0, sceneSize.x, sceneSize.y};
+  static constexpr SDL_Color exploredColor{80, 80, 110, 255};
+  static constexpr const char *atlasPath{
+      "rsrc/0x72_DungeonTilesetII_v1.7/0x72_DungeonTilesetII_v1.7.png"};
+  static constexpr const char *tileIndexPath{
+      "rsrc/0x72_DungeonTilesetII_v1.7/tile_list_v1.7.cpy"};
+
+  /// get the grid cell of a position
+  static auto gridCell(const SDL_FPoint &pos) noexcept -> SDL_Point {
+    return {static_cast<int>(std::floor(pos.x / gridSize)),
+            static_cast<int>(std::floor(pos.y / gridSize))};
+  }
 
-  SdlWindow window_{"My Game", windowSize, SDL_WINDOW_HIDDEN};
+  SdlWindow window_{"My Game", windowSize,
+                    SDL_WINDOW_HIDDEN | SDL_WINDOW_RESIZABLE};
   SdlRenderer renderer_{window_.createRenderer()};
   Gui gameGui_{window_, renderer_};
 
@@ -173,67 +503,296 @@ private:
 
   size_t frameCount_{};
   SdlTexturePtr texture_{nullptr, SDL_DestroyTexture};
+  /// the scene drawn by the previous frames, only its damage is redrawn
+  SdlTexturePtr backBuffer_{nullptr, SDL_DestroyTexture};
+  DamageTracker damage_{{0, 0, sceneSize.x, sceneSize.y}};
+  /// where the back buffer is scaled to in the window
+  Viewport viewport_{sceneSize};
+  /// draws the damage of the scene into the back buffer
+  std::unique_ptr<RenderBackend> backend_;
   Uint32 last_{};
+  /// set when the last frame changed nothing, the next one waits for an event
+  bool idle_{};
 
   Character player_{playerStartingPoint, nullptr};
 
-  std::vector<CharacterSprite> characters_;
-  std::vector<CharacterSprite> enemies_;
+  /// declared before the sprites so it outlives them
+  AnimationSystem animations_;
+  CharacterSprites characters_;
+  CharacterSprites enemies_;
   std::vector<RendererBuilder> tiles_;
   std::vector<std::unique_ptr<TileConcrete>> map_;
   std::vector<std::unique_ptr<TileConcrete>> mapWall_;
 
-  std::vector<Renderable *> toRender_;
+  /// the types whose sprites are fully opaque in the atlas
+  OpacityTable opaqueTypes_;
+  /// the pixels of the atlas, kept to find the opaque types when the source
+  /// rects are reloaded
+  Image atlasImage_;
+  /// orders, culls and lights the sprites of the world
+  SceneBuilder scene_{gridCells, gridSize};
+
+  /// a light emitted by a placed tile
+  struct TileLight {
+    SDL_FPoint pos;
+    bool wall;
+    LightId id;
+  };
+
+  LightMap lightMap_{gridCells.x, gridCells.y};
+  LightId playerLight_{};
+  std::vector<TileLight> tileLights_;
+  FieldOfView fov_{gridCells.x, gridCells.y};
+
+  TrackedVector<Enemy, MemoryTag::Sprites> spawnedEnemies_;
+  /// the agents of ai_ are the indexes in spawnedEnemies_
+  AiScheduler ai_{aiBudget};
+
+  Pool<Transient> transients_{maxTransients};
+  /// where coins spawn at the end of the tick, kept to reuse its memory
+  std::vector<Point> coinDrops_;
+
+  ParticleSystem particles_{maxParticles};
+  /// the positions of the placed fountain basins
+  std::vector<SDL_FPoint> fountains_;
+  /// the time since the last emission of dust and splashes in ms
+  Uint64 effectTimer_{};
 
   SDL_FPoint tileCursorPos_{};
   bool showTileSelector_{};
+
+  std::optional<InputRecorder> recorder_;
+  std::optional<InputReplay> replay_;
+  bool headless_{};
+  /// duration of each replayed frame in performance counter ticks
+  std::vector<Uint64> frameTimes_;
+  /// measures the allocation rate of the whole run, for reportMemory
+  MemoryMeter memoryMeter_{0};
+
+  /// a script started for a placed tile
+  struct LevelScript {
+    SDL_FPoint pos;
+    bool wall;
+    ScriptId id;
+    /// the trigger of the volume of the tile, if it has one
+    std::optional<TriggerId> stepped;
+  };
+
+  ScriptScheduler scripts_{maxScripts};
+  TriggerVolumes volumes_;
+  std::vector<LevelScript> levelScripts_;
+  /// fired when a lever is pulled
+  TriggerId leverPulled_{scripts_.addTrigger()};
+  /// the cell of the player at the last tick, the volumes fire on a change
+  SDL_Point playerCell_{-1, -1};
+
+  /// set when the simulation is published to observers
+  std::optional<SnapshotServer> server_;
+  /// set when the world is received from a server instead of simulated
+  std::optional<SnapshotClient> observer_;
+
+  /// the draw list being submitted and the one being built
+  std::array<DrawList, 2> drawLists_;
+  /// index in drawLists_ of the draw list being submitted
+  size_t frontDrawList_{};
+  /// the time simulated by the next simulate call
+  Uint64 simulationDelta_{};
+
+  /// the assets loaded by the watcher thread, waiting for the next frame
+  struct ReloadedAssets {
+    SdlSurfacePtr atlas{nullptr, SDL_DestroySurface};
+    Image atlasImage;
+    std::optional<SourceRects> sourceRects;
+  };
+  std::mutex reloadMutex_;
+  ReloadedAssets reloaded_;
+  /// watches atlasPath and tileIndexPath, in this order, unset in a replay
+  /// or a headless run
+  std::optional<FileWatcher> assetWatcher_;
+
+  /// declared last so it is joined before the state it simulates is destroyed
+  WorkerThread simulation_{[this] { simulate(); }};
 };
 
-Game::Game() {
+Game::Game(const GameOptions &options) : headless_{options.headless} {
   if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMEPAD)) {
     throw InitError{std::format("SDL_Init(): {}", SDL_GetError())};
   }
 
+  if (options.replayPath) {
+    replay_.emplace(*options.replayPath);
+  } else if (options.recordPath) {
+    recorder_.emplace(*options.recordPath);
+  }
+  // a replay only reproduces the recording when the agents updated by a tick
+  // do not depend on the time they took
+  if (replay_ || recorder_) {
+    ai_.setMaxUpdates(aiMaxUpdates);
+  }
+
+  if (options.observePort) {
+    observer_.emplace(*options.observePort);
+    if (!observer_->isConnected()) {
+      std::cerr << std::format("cannot observe port {}\n",
+                               *options.observePort);
+    }
+  } else if (options.servePort) {
+    server_.emplace(*options.servePort);
+    if (!server_->isListening()) {
+      std::cerr << std::format("cannot serve on port {}\n",
+                               *options.servePort);
+    }
+  }
+
+  memoryMeter_.sample(SDL_GetTicks());
+
   window_.setPosition(SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
-  window_.showWindow();
+  if (!headless_) {
+    window_.showWindow();
+  }
+
+  const auto atlas = loadSurface(atlasPath);
+  texture_ = renderer_.createTextureFromSurface(atlas);
+  atlasImage_ = surfaceImage(atlas);
+  opaqueTypes_ = findOpaqueTypes(atlasImage_, sourceRects());
+  createBackend(options.backend);
+  viewport_.resize(renderer_.outputSize());
+  gameGui_.setAtlas(texture_);
 
-  texture_ = renderer_.createTextureFromPath(
-      "rsrc/0x72_DungeonTilesetII_v1.7/0x72_DungeonTilesetII_v1.7.png");
+  rebuildGrids();
 
   loadEntities();
+
+  // a replay or a headless run keeps the assets it started with
+  if (!replay_ && !headless_) {
+    assetWatcher_.emplace(
+        std::vector<std::filesystem::path>{atlasPath, tileIndexPath},
+        [this](size_t index) { reloadAsset(index); });
+  }
 }
 
-Game::~Game() { SDL_Quit(); }
+Game::~Game() {
+  if (headless_) {
+    reportMemory();
+  }
+  SDL_Quit();
+}
+
+auto Game::createBackend(BackendKind kind) -> void {
+  constexpr SDL_Color clearColor{0, 0, 0, 255};
+  switch (kind) {
+  case BackendKind::Sdl:
+    backBuffer_ = renderer_.createTargetTexture(sceneSize);
+    backend_ = std::make_unique<SdlBackend>(renderer_, texture_, backBuffer_);
+    break;
+  case BackendKind::Software:
+    backBuffer_ = renderer_.createStreamingTexture(sceneSize);
+    backend_ = std::make_unique<SdlSoftwareBackend>(backBuffer_);
+    break;
+  case BackendKind::Null:
+    backBuffer_ = renderer_.createTargetTexture(sceneSize);
+    backend_ = std::make_unique<NullBackend>();
+    break;
+  }
+  backend_->setAtlas(atlasImage_);
+
+  if (kind == BackendKind::Software) {
+    backend_->clear({0, 0, sceneSize.x, sceneSize.y});
+    backend_->finish();
+  } else {
+    renderer_.setRenderTarget(backBuffer_);
+    renderer_.setRenderDrawColor(clearColor);
+    renderer_.renderClear();
+    renderer_.resetRenderTarget();
+  }
+}
 
 auto Game::loadEntities() noexcept -> void {
-  std::ifstream textureIndex;
-  textureIndex.open("rsrc/0x72_DungeonTilesetII_v1.7/tile_list_v1.7.cpy");
-  while (!textureIndex.eof()) {
-    std::string tileType;
-    std::string tileName;
-    SDL_FRect sourceRect;
-    textureIndex >> tileType >> tileName >> sourceRect.x >> sourceRect.y >>
-        sourceRect.w >> sourceRect.h;
-
-    if (tileType == "terrain") {
-      tiles_.emplace_back(tileName, false, sourceRect);
-    } else if (tileType == "terrainA") {
-      tiles_.emplace_back(tileName, true, sourceRect);
-    } else if (tileType == "character") {
-      characters_.emplace_back(tileName, sourceRect, true, true);
-    } else if (tileType == "enemy") {
-      enemies_.emplace_back(tileName, sourceRect, true, false);
-    } else if (tileType == "enemyw") {
-      enemies_.emplace_back(tileName, sourceRect, false, false);
-    } else {
-      textureIndex.ignore();
+  for (TileTypeId typeId = 0; typeId < tileTypes.size(); ++typeId) {
+    switch (tileType(typeId).tileClass) {
+    case TileClass::Terrain:
+    case TileClass::AnimatedTerrain:
+      tiles_.emplace_back(typeId);
+      break;
+    case TileClass::Character:
+      characters_.emplace_back(typeId, animations_);
+      break;
+    case TileClass::Enemy:
+      enemies_.emplace_back(typeId, animations_);
+      break;
+    default:
+      break;
     }
   }
 }
 
-auto Game::processEvent() noexcept -> void {
+auto Game::pollEvent(SDL_Event &event) -> bool {
+  if (replay_) {
+    return replay_->pollEvent(event, window_.getWindowID());
+  }
+  if (!SDL_PollEvent(&event)) {
+    return false;
+  }
+  if (recorder_) {
+    recorder_->recordEvent(event);
+  }
+  return true;
+}
+
+auto Game::mousePosition() -> SDL_FPoint {
+  if (replay_) {
+    return replay_->mousePos();
+  }
+  SDL_FPoint mousePos;
+  SDL_GetMouseState(&mousePos.x, &mousePos.y);
+  if (recorder_) {
+    recorder_->recordMouse(mousePos);
+  }
+  return mousePos;
+}
+
+auto Game::toScene(const SDL_FPoint &pos) const noexcept -> SDL_FPoint {
+  return viewport_.toScene(renderer_.coordinatesFromWindow(pos));
+}
+
+auto Game::keyboardState() -> std::span<const bool> {
+  if (replay_) {
+    return replay_->keys();
+  }
+  int ksize{0};
+  const bool *kptr = SDL_GetKeyboardState(&ksize);
+  const std::span<const bool> keys{kptr, static_cast<size_t>(ksize)};
+  if (recorder_) {
+    recorder_->recordKeys(keys);
+  }
+  return keys;
+}
+
+auto Game::processEvent() -> bool {
+  if (replay_) {
+    // the live input is dropped, only a quit request is honored
+    SDL_Event liveEvent;
+    while (SDL_PollEvent(&liveEvent)) {
+      if (liveEvent.type == SDL_EVENT_QUIT) {
+        done_ = true;
+      }
+    }
+  }
+
+  bool processed{};
   SDL_Event event;
-  while (SDL_PollEvent(&event)) {
+  while (pollEvent(event)) {
+    processed = true;
+    // the window content or the back buffer may have been lost
+    if (event.type == SDL_EVENT_WINDOW_EXPOSED ||
+        event.type == SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED ||
+        event.type == SDL_EVENT_RENDER_TARGETS_RESET ||
+        event.type == SDL_EVENT_RENDER_DEVICE_RESET) {
+      damage_.addFull();
+    }
+    if (event.type == SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED) {
+      viewport_.resize(renderer_.outputSize());
+    }
 
     if (Gui::processEvent(event)) {
       showTileSelector_ = false;
@@ -241,12 +800,8 @@ auto Game::processEvent() noexcept -> void {
     }
     showTileSelector_ = true;
 
-    SDL_FPoint mousePos;
-
-    SDL_GetMouseState(&mousePos.x, &mousePos.y);
-
-    tileCursorPos_ = {.x = mousePos.x - std::fmod(mousePos.x, gridSize * 2),
-                      .y = mousePos.y - std::fmod(mousePos.y, gridSize * 2)};
+    const auto cursorCell = snapToGrid(toScene(mousePosition()), gridSize);
+    tileCursorPos_ = {.x = cursorCell.x, .y = cursorCell.y - gridSize};
 
     if (event.type == SDL_EVENT_QUIT) {
       done_ = true;
@@ -256,92 +811,260 @@ auto Game::processEvent() noexcept -> void {
       done_ = true;
     }
 
+    // an observer only shows the world it receives
+    if (observer_) {
+      continue;
+    }
+
     if (gameGui_.isEditorMode() && processEventEditor(event)) {
-      return;
+      return true;
     }
 
     processEventCharacter(event);
   }
+  return processed;
+}
+
+auto Game::present() -> void {
+  const bool worldDamaged = !damage_.empty();
+  if (!worldDamaged && !gameGui_.isDamaged()) {
+    return;
+  }
+
+  if (worldDamaged) {
+    for (const auto &rect : damage_.rects()) {
+      backend_->clear(rect);
+      backend_->submit(drawLists_[frontDrawList_], rect);
+    }
+    backend_->finish();
+    damage_.clear();
+  }
+
+  // the scene is scaled once to the window, and the gui is drawn over it
+  // without damaging the back buffer
+  constexpr SDL_Color barColor{0, 0, 0, 255};
+  constexpr SDL_FRect scene{0, 0, sceneSize.x, sceneSize.y};
+  renderer_.setRenderDrawColor(barColor);
+  renderer_.renderClear();
+  renderer_.renderTexture(backBuffer_, scene, viewport_.rect());
+  renderer_.imguiRenderDrawData();
+  renderer_.renderPresent();
+}
+
+auto Game::reloadAsset(size_t index) -> void {
+  // decoding is the slow part, so it is done here and only the upload to the
+  // renderer waits for the main thread
+  if (index == 0) {
+    try {
+      auto atlas = loadSurface(atlasPath);
+      auto image = surfaceImage(atlas);
+      const std::scoped_lock lock{reloadMutex_};
+      reloaded_.atlas = std::move(atlas);
+      reloaded_.atlasImage = std::move(image);
+    } catch (const TextureLoadingError &error) {
+      std::cerr << std::format("atlas reload failed: {}\n", error.what());
+    }
+  } else {
+    std::ifstream istream{tileIndexPath};
+    auto rects = readSourceRects(istream);
+    const std::scoped_lock lock{reloadMutex_};
+    reloaded_.sourceRects = rects;
+  }
+}
+
+auto Game::swapAssets() -> void {
+  ReloadedAssets reloaded;
+  {
+    const std::scoped_lock lock{reloadMutex_};
+    reloaded = std::exchange(reloaded_, {});
+  }
+  if (!reloaded.atlas && !reloaded.sourceRects) {
+    return;
+  }
+
+  if (reloaded.atlas) {
+    try {
+      texture_ = renderer_.createTextureFromSurface(reloaded.atlas);
+      gameGui_.setAtlas(texture_);
+      atlasImage_ = std::move(reloaded.atlasImage);
+      backend_->setAtlas(atlasImage_);
+    } catch (const TextureLoadingError &error) {
+      std::cerr << std::format("atlas reload failed: {}\n", error.what());
+    }
+  }
+  // the placed tiles only hold their type id, so they all follow the new
+  // rects at once
+  if (reloaded.sourceRects) {
+    setSourceRects(*reloaded.sourceRects);
+  }
+  opaqueTypes_ = findOpaqueTypes(atlasImage_, sourceRects());
+  damage_.addFull();
 }
 
 auto Game::frame() -> void {
   auto now = SDL_GetTicks();
   auto fps = now - last_;
-  if (fps >= minFrameDuration) {
-    last_ = now;
-    ++frameCount_;
-  } else {
+  const bool throttled = !(replay_ && headless_);
+  if (throttled && idle_) {
+    SDL_WaitEventTimeout(nullptr, maxIdleWait);
+    // the time spent waiting is not simulated
+    now = SDL_GetTicks();
+    fps = minFrameDuration;
+  } else if (throttled && fps < minFrameDuration) {
+    // sleeping until the next tick instead of polling for it
+    SDL_Delay(static_cast<Uint32>(minFrameDuration - fps));
     return;
   }
+  last_ = now;
+  ++frameCount_;
+
+  if (replay_) {
+    if (!replay_->nextTick()) {
+      reportReplay();
+      done_ = true;
+      return;
+    }
+    fps = replay_->deltaTime();
+  }
+  const auto frameStart = SDL_GetPerformanceCounter();
 
   gameGui_.frameRenderingDuration(fps);
 
-  if (SDL_WINDOW_MINIMIZED & window_.getWindowFlags()) {
+  if (!replay_ && SDL_WINDOW_MINIMIZED & window_.getWindowFlags()) {
     SDL_Delay(minimizedDelay);
     return;
   }
 
-  processEvent();
+  if (recorder_) {
+    recorder_->beginTick(fps);
+  }
 
-  checkKeys();
+  const bool processed = processEvent();
 
-  player_.update(fps);
+  if (!observer_) {
+    checkKeys();
+  }
 
-  constexpr SDL_Color clearColor{0, 0, 0, 255};
-  renderer_.setRenderDrawColor(clearColor);
-  renderer_.renderClear();
+  if (recorder_) {
+    recorder_->endTick();
+  }
 
-  render();
+  swapAssets();
+  if (observer_) {
+    receiveSnapshot();
+  }
 
-  if (gameGui_.isEditorMode() && showTileSelector_) {
-    const SDL_FRect cursorRect{tileCursorPos_.x, tileCursorPos_.y, gridSize * 2,
-                               gridSize * 2};
+  // the draw list about to be presented is left alone by the simulation
+  if (gameGui_.isOverdrawView()) {
+    gameGui_.overdraw().update(drawLists_[frontDrawList_], sceneSize);
+  }
+  gameGui_.render(characters_, enemies_, tiles_, map_, mapWall_);
+  const bool levelLoaded = gameGui_.takeLevelLoaded();
+  if (levelLoaded) {
+    rebuildGrids();
+    rebuildScripts();
+    if (server_) {
+      server_->resetTiles(captureTiles());
+    }
+  }
 
-    constexpr SDL_Color cursorColor{150, 150, 150, 255};
-    renderer_.setRenderDrawColor(cursorColor);
-    renderer_.renderRect(cursorRect);
+  // without input, damage or anything animating the tick would build the
+  // same draw list, the recorded and networked runs simulate every tick
+  const bool simulated = processed || levelLoaded || !damage_.empty() ||
+                         isAnimating() || replay_ || recorder_ || server_ ||
+                         observer_;
+
+  // the next tick is simulated while the previous one is submitted, the game
+  // state is only touched by the simulation thread until wait returns
+  if (simulated) {
+    simulationDelta_ = fps;
+    simulation_.start();
   }
 
-  gameGui_.render(renderer_, characters_, enemies_, tiles_, map_, mapWall_);
-  renderer_.renderPresent();
+  present();
+
+  if (simulated) {
+    simulation_.wait();
+    if (server_) {
+      server_->publish(captureEntities());
+    }
+    // the damage of the next frame is what its draw list changes
+    damage_.diff(drawLists_[frontDrawList_], drawLists_[1 - frontDrawList_]);
+    frontDrawList_ = 1 - frontDrawList_;
+  }
+  idle_ = !simulated && !gameGui_.isDamaged();
+
+  if (replay_) {
+    frameTimes_.push_back(SDL_GetPerformanceCounter() - frameStart);
+  }
+}
+
+auto Game::reportReplay() const -> void {
+  if (frameTimes_.empty()) {
+    return;
+  }
+
+  auto sorted = frameTimes_;
+  std::ranges::sort(sorted);
+  const auto toMs = [](Uint64 ticks) {
+    constexpr double msPerSecond{1000};
+    return static_cast<double>(ticks) * msPerSecond /
+           static_cast<double>(SDL_GetPerformanceFrequency());
+  };
+  const auto total = std::accumulate(sorted.begin(), sorted.end(), Uint64{0});
+  const auto percentile = [&sorted](size_t percent) {
+    constexpr size_t hundred{100};
+    return sorted[(sorted.size() - 1) * percent / hundred];
+  };
+
+  constexpr size_t median{50};
+  constexpr size_t tail{99};
+  std::cout << std::format(
+      "replay: {} ticks on {}, mean {:.3f} ms, p50 {:.3f} ms, "
+      "p99 {:.3f} ms, max {:.3f} ms\n",
+      sorted.size(), backend_->name(),
+      toMs(total) / static_cast<double>(sorted.size()),
+      toMs(percentile(median)), toMs(percentile(tail)), toMs(sorted.back()));
+}
+
+auto Game::reportMemory() -> void {
+  memoryMeter_.sample(SDL_GetTicks());
+  for (size_t index = 0; index < memoryTagCount; ++index) {
+    const auto tag = static_cast<MemoryTag>(index);
+    const auto usage = memoryUsage(tag);
+    std::cout << std::format(
+        "memory {}: live {}, peak {}, {} allocations, {}/s\n",
+        memoryTagName(tag), formatBytes(static_cast<double>(usage.live)),
+        formatBytes(static_cast<double>(usage.peak)), usage.allocations,
+        formatBytes(memoryMeter_.rate(tag)));
+  }
 }
 
 auto Game::processEventEditor(const SDL_Event &event) noexcept -> bool {
+  // the clicks on the bars around the scene do not edit it
+  if (event.type == SDL_EVENT_MOUSE_BUTTON_DOWN &&
+      !viewport_.contains(renderer_.coordinatesFromWindow(
+          {event.button.x, event.button.y}))) {
+    return false;
+  }
   if (event.type == SDL_EVENT_MOUSE_BUTTON_DOWN &&
       event.button.button == SDL_BUTTON_LEFT) {
-    SDL_FPoint point;
-    point.x = (event.button.x - std::fmod(event.button.x, gridSize * 2)) / 2;
-    point.y = (event.button.y - std::fmod(event.button.y, gridSize * 2) +
-               gridSize * 2) /
-              2;
-
-    auto tile = tiles_[gameGui_.getTileIndex()];
-    if (gameGui_.isWall()) {
-      std::erase_if(mapWall_,
-                    [point](auto &tile) { return tile->isSamePos(point); });
-      mapWall_.push_back(tile.build(point, gameGui_.isLevel()));
-    } else {
-      std::erase_if(map_,
-                    [point](auto &tile) { return tile->isSamePos(point); });
-      map_.push_back(tile.build(point, gameGui_.isLevel()));
-    }
+    const auto point =
+        snapToGrid(toScene({event.button.x, event.button.y}), gridSize);
+    setTile(point, gameGui_.isWall(), gameGui_.isLevel(),
+            tiles_[gameGui_.getTileIndex()].typeId());
+    return true;
+  }
+  if (event.type == SDL_EVENT_MOUSE_BUTTON_DOWN &&
+      event.button.button == SDL_BUTTON_MIDDLE) {
+    spawnEnemy(toScene({event.button.x, event.button.y}));
     return true;
   }
   if (event.type == SDL_EVENT_MOUSE_BUTTON_DOWN &&
       event.button.button == SDL_BUTTON_RIGHT) {
-    SDL_FPoint point;
-    point.x = (event.button.x - std::fmod(event.button.x, gridSize * 2)) / 2;
-    point.y = (event.button.y - std::fmod(event.button.y, gridSize * 2) +
-               gridSize * 2) /
-              2;
-
-    if (gameGui_.isWall()) {
-      std::erase_if(mapWall_,
-                    [point](auto &tile) { return tile->isSamePos(point); });
-    } else {
-      std::erase_if(map_,
-                    [point](auto &tile) { return tile->isSamePos(point); });
-    }
+    const auto point =
+        snapToGrid(toScene({event.button.x, event.button.y}), gridSize);
+    setTile(point, gameGui_.isWall(), gameGui_.isLevel(), std::nullopt);
     return true;
   }
   return false;
@@ -351,17 +1074,19 @@ auto Game::processEventCharacter(const SDL_Event &event) noexcept -> bool {
 
   if (event.type == SDL_EVENT_KEY_DOWN && event.key.key == SDLK_A) {
     player_.getRenderable()->setHit();
+    const auto pos = player_.getPos();
+    particles_.emit(ParticleEffect::Spark,
+                    {pos.x + (gridSize / 2), pos.y - gridSize}, sparkCount);
+    throwProjectile();
     return true;
   }
   return false;
 }
 
-auto Game::checkKeys() noexcept -> void {
+auto Game::checkKeys() -> void {
   SDL_PumpEvents();
 
-  int ksize{0};
-  const bool *kptr = SDL_GetKeyboardState(&ksize);
-  const std::span<const bool> keys{kptr, static_cast<size_t>(ksize)};
+  const auto keys = keyboardState();
 
   constexpr Rad dirUpLeft{Rad::fromDeg(135)};
   constexpr Rad dirUpRight{Rad::fromDeg(45)};
@@ -411,25 +1136,574 @@ auto Game::checkKeys() noexcept -> void {
   }
 }
 
-auto Game::render() noexcept -> void {
-  for (const auto &tile : map_) {
-    tile->render(renderer_, texture_, frameCount_);
+auto Game::isAnimating() const noexcept -> bool {
+  // the animated tiles change frame every other tick
+  return player_.isMoving() || scene_.hasAnimatedTile() ||
+         animations_.isAnimating() || !spawnedEnemies_.empty() ||
+         scripts_.size() > 0 || transients_.size() > 0 ||
+         particles_.size() > 0 || !fountains_.empty();
+}
+
+auto Game::simulate() -> void {
+  player_.update(simulationDelta_);
+  animations_.update(simulationDelta_);
+
+  const auto playerCell = gridCell(player_.getPos().asSdlPoint());
+  lightMap_.moveLight(playerLight_, playerCell.x, playerCell.y);
+  lightMap_.update();
+  if (gameGui_.isFogOfWar()) {
+    fov_.compute(playerCell.x, playerCell.y, fovRadius);
+  }
+
+  // the enemies and the scripted tiles of an observer are moved by the
+  // snapshots
+  if (!observer_) {
+    if (playerCell.x != playerCell_.x || playerCell.y != playerCell_.y) {
+      volumes_.enter(playerCell, scripts_);
+      playerCell_ = playerCell;
+    }
+    scripts_.update(simulationDelta_);
+
+    for (AgentId id = 0; id < spawnedEnemies_.size(); ++id) {
+      const auto pos = spawnedEnemies_[id].pos.asSdlPoint();
+      ai_.setOnCamera(id, SDL_PointInRectFloat(&pos, &cameraView));
+    }
+    ai_.tick(
+        [this](AgentId id, std::uint64_t /*elapsedTicks*/) { think(id); });
+    gameGui_.aiStats(ai_.stats());
+    updateEnemies();
   }
+  updateTransients();
+  updateParticles();
+
+  auto &drawList = drawLists_[1 - frontDrawList_];
+  drawList.clear();
+  render(drawList);
+
+  if (gameGui_.isEditorMode() && showTileSelector_) {
+    const SDL_FRect cursorRect{tileCursorPos_.x, tileCursorPos_.y, gridSize,
+                               gridSize};
 
-  toRender_.clear();
-  for (const auto &item : mapWall_) {
-    toRender_.push_back(item.get());
+    constexpr SDL_Color cursorColor{150, 150, 150, 255};
+    drawList.rect(cursorRect, cursorColor);
   }
+}
+
+auto Game::render(DrawList &drawList) -> void {
+  const auto colorOf = [this](const SDL_FPoint &pos) { return tileColor(pos); };
+  scene_.clear();
+  scene_.addFloor(map_, cameraView, opaqueTypes_, colorOf);
+  scene_.addWalls(mapWall_, cameraView, opaqueTypes_, colorOf);
 
   player_.setRenderable(&characters_[gameGui_.getCharacterIndex()]);
   player_.updateRenderable();
-  toRender_.push_back(player_.getRenderable());
+  scene_.addCharacter(*player_.getRenderable(), colorOf);
 
-  std::ranges::sort(toRender_, [](auto &lhs, auto &rhs) {
-    return lhs->getPos().y < rhs->getPos().y;
-  });
+  for (auto &enemy : spawnedEnemies_) {
+    enemy.sprite.setPos(enemy.pos.asSdlPoint());
+    scene_.addCharacter(enemy.sprite, colorOf);
+  }
+
+  gameGui_.occlusionStats(
+      scene_.build(drawList, gameGui_.isOcclusionCulling(), frameCount_));
+
+  renderTransients(drawList);
+  particles_.render(drawList);
+}
+
+auto Game::updateParticles() -> void {
+  // the dust rises from the middle of the feet each time a run clip starts
+  // over
+  const auto animationOf = [](const Enemy &enemy) {
+    return enemy.sprite.animation();
+  };
+  for (const auto &event : animations_.events()) {
+    if (event.type != AnimationEventType::FrameChanged ||
+        event.clip != Clip::Run || event.frame != 0) {
+      continue;
+    }
+    std::optional<Point> pos;
+    if (const auto *sprite = player_.getRenderable();
+        sprite != nullptr && sprite->animation() == event.id) {
+      pos = player_.getPos();
+    } else if (const auto enemy =
+                   std::ranges::find(spawnedEnemies_, event.id, animationOf);
+               enemy != spawnedEnemies_.end()) {
+      pos = enemy->pos;
+    }
+    if (pos) {
+      particles_.emit(ParticleEffect::Dust,
+                      {pos->x + (gridSize / 2), pos->y}, dustCount);
+    }
+  }
+
+  effectTimer_ += simulationDelta_;
+  if (effectTimer_ >= effectInterval) {
+    effectTimer_ %= effectInterval;
+
+    for (const auto &fountain : fountains_) {
+      const SDL_FPoint center{fountain.x + (gridSize / 2),
+                              fountain.y + (gridSize / 2)};
+      particles_.emit(ParticleEffect::Splash, center, splashCount);
+    }
+  }
+  particles_.update(static_cast<float>(simulationDelta_));
+}
+
+auto Game::throwProjectile() noexcept -> void {
+  transients_.spawn(TransientKind::Projectile, projectileTypeId,
+                    player_.getPos(),
+                    PolarVec{.radius = projectileSpeed,
+                             .angle = player_.getAngle()},
+                    projectileLifetime, Uint64{0});
+}
+
+auto Game::updateTransients() -> void {
+  const auto player = player_.getPos();
+  const auto isClose = [](const Point &lhs, const Point &rhs) {
+    return std::hypot(lhs.x - rhs.x, lhs.y - rhs.y) < gridSize;
+  };
 
-  for (const auto &tile : toRender_) {
-    tile->render(renderer_, texture_, frameCount_);
+  for (auto &transient : transients_.objects()) {
+    transient.age += simulationDelta_;
+    transient.lifetime -= std::min(transient.lifetime, simulationDelta_);
+    transient.pos += PolarVec{.radius = static_cast<float>(simulationDelta_) *
+                                        transient.heading.radius,
+                              .angle = transient.heading.angle};
+
+    switch (transient.kind) {
+    case TransientKind::Projectile: {
+      const auto cell = gridCell(transient.pos.asSdlPoint());
+      if (fov_.isOpaque(cell.x, cell.y)) {
+        transient.lifetime = 0;
+      }
+      for (const auto &enemy : spawnedEnemies_) {
+        if (transient.lifetime != 0 && isClose(transient.pos, enemy.pos)) {
+          transient.lifetime = 0;
+          coinDrops_.push_back(enemy.pos);
+          particles_.emit(ParticleEffect::Spark, transient.pos.asSdlPoint(),
+                          sparkCount);
+        }
+      }
+      break;
+    }
+    case TransientKind::Coin:
+      if (isClose(transient.pos, player)) {
+        transient.lifetime = 0;
+      }
+      break;
+    }
+  }
+  transients_.despawnIf(
+      [](const Transient &transient) { return transient.lifetime == 0; });
+
+  for (const auto &pos : coinDrops_) {
+    transients_.spawn(TransientKind::Coin, coinTypeId, pos, PolarVec{},
+                      coinLifetime, Uint64{0});
+  }
+  coinDrops_.clear();
+}
+
+auto Game::renderTransients(DrawList &drawList) const -> void {
+  for (const auto &transient : transients_.objects()) {
+    auto typeId = transient.typeId;
+    if (transient.kind == TransientKind::Coin) {
+      typeId += static_cast<TileTypeId>(
+          (transient.age / coinFrameDuration) % coinFrames);
+    }
+    const auto &source = sourceRect(typeId);
+    drawList.sprite(source,
+                    {transient.pos.x, transient.pos.y, source.w, source.h});
+  }
+}
+
+auto Game::spawnEnemy(const SDL_FPoint &pos) -> void {
+  const auto typeId = enemies_[gameGui_.getEnemyIndex()].typeId();
+  spawnedEnemies_.push_back({.sprite = CharacterSprite{typeId, animations_},
+                             .pos = {.x = pos.x, .y = pos.y},
+                             .heading = {}});
+  ai_.add(aiInterval(tileType(typeId)));
+}
+
+auto Game::think(AgentId id) -> void {
+  auto &enemy = spawnedEnemies_[id];
+  const auto player = player_.getPos();
+  const auto distX = player.x - enemy.pos.x;
+  const auto distY = player.y - enemy.pos.y;
+
+  const auto enemyCell = gridCell(enemy.pos.asSdlPoint());
+  const auto playerCell = gridCell(player_.getPos().asSdlPoint());
+  const bool seesPlayer =
+      std::hypot(distX, distY) <= fovRadius * gridSize &&
+      fov_.hasLineOfSight(enemyCell.x, enemyCell.y, playerCell.x, playerCell.y);
+
+  if (!seesPlayer) {
+    enemy.heading.radius = 0;
+    enemy.sprite.setIdle();
+    return;
+  }
+  enemy.heading = {.radius = enemySpeed, .angle = {std::atan2(distY, distX)}};
+  enemy.sprite.setRunning(distX < 0);
+}
+
+auto Game::updateEnemies() -> void {
+  for (auto &enemy : spawnedEnemies_) {
+    enemy.pos += PolarVec{.radius = static_cast<float>(simulationDelta_) *
+                                    enemy.heading.radius,
+                          .angle = enemy.heading.angle};
+  }
+}
+
+auto Game::setTile(const SDL_FPoint &pos, bool wall, bool level,
+                   std::optional<TileTypeId> typeId) -> void {
+  auto &layer = wall ? mapWall_ : map_;
+  detachScript(pos, wall);
+  eraseTiles(layer, pos);
+  if (typeId) {
+    attachScript(
+        insertTile(layer, RendererBuilder{*typeId}.build(pos, level)), wall);
+  }
+  gameGui_.minimap().setCell(pos, wall, typeId);
+  updateGrids(pos, wall, typeId);
+
+  if (server_) {
+    server_->recordEdit({.x = quantize(pos.x),
+                         .y = quantize(pos.y),
+                         .wall = wall,
+                         .level = level,
+                         .typeId = typeId});
+  }
+}
+
+auto Game::attachScript(TileConcrete &tile, bool wall) -> void {
+  if (observer_) {
+    return;
+  }
+
+  const auto record = tile.record();
+  // the scripts of the tiles stepped on wait for a volume of their cell
+  const auto addVolume = [this, &record] {
+    const auto cell = gridCell(record.pos);
+    const auto trigger = scripts_.addTrigger();
+    volumes_.add({cell.x, cell.y, 1, 1}, trigger);
+    return trigger;
+  };
+
+  std::optional<TriggerId> stepped;
+  std::optional<ScriptId> id;
+  // the spikes are saved in whichever frame they were
+  if (record.typeId >= spikesTypeId &&
+      record.typeId < spikesTypeId + spikesFrames) {
+    id = scripts_.spawn(spikesScript(tile, wall));
+  } else if (record.typeId == leverLeftTypeId ||
+             record.typeId == leverRightTypeId) {
+    stepped = addVolume();
+    id = scripts_.spawn(leverScript(tile, wall, *stepped));
+  } else if (record.typeId == doorClosedTypeId ||
+             record.typeId == doorOpenTypeId) {
+    id = scripts_.spawn(doorScript(tile, wall));
+  } else if (record.typeId == chestFullTypeId ||
+             record.typeId == chestEmptyTypeId ||
+             record.typeId == chestMimicTypeId) {
+    stepped = addVolume();
+    id = scripts_.spawn(chestScript(tile, wall, *stepped));
+  }
+
+  if (id) {
+    levelScripts_.push_back(
+        {.pos = record.pos, .wall = wall, .id = *id, .stepped = stepped});
+  } else if (stepped) {
+    volumes_.remove(*stepped);
+    scripts_.removeTrigger(*stepped);
+  }
+}
+
+auto Game::detachScript(const SDL_FPoint &pos, bool wall) -> void {
+  const auto script = std::ranges::find_if(
+      levelScripts_, [pos, wall](const LevelScript &script) {
+        return script.wall == wall && script.pos.x == pos.x &&
+               script.pos.y == pos.y;
+      });
+  if (script == levelScripts_.end()) {
+    return;
+  }
+  scripts_.cancel(script->id);
+  if (script->stepped) {
+    volumes_.remove(*script->stepped);
+    scripts_.removeTrigger(*script->stepped);
+  }
+  levelScripts_.erase(script);
+}
+
+auto Game::rebuildScripts() -> void {
+  // the tiles of the scripts may already be destroyed, they are only
+  // cancelled
+  for (const auto &script : levelScripts_) {
+    scripts_.cancel(script.id);
+    if (script.stepped) {
+      volumes_.remove(*script.stepped);
+      scripts_.removeTrigger(*script.stepped);
+    }
+  }
+  levelScripts_.clear();
+
+  for (const auto wall : {false, true}) {
+    for (const auto &tile : wall ? mapWall_ : map_) {
+      attachScript(*tile, wall);
+    }
+  }
+}
+
+auto Game::setTileType(TileConcrete &tile, bool wall, TileTypeId typeId)
+    -> void {
+  tile.setTypeId(typeId);
+  const auto record = tile.record();
+  gameGui_.minimap().setCell(record.pos, wall, typeId);
+  updateGrids(record.pos, wall, typeId);
+  // the scripts run while the main thread leaves the server alone
+  if (server_) {
+    server_->recordEdit({.x = quantize(record.pos.x),
+                         .y = quantize(record.pos.y),
+                         .wall = wall,
+                         .level = record.level,
+                         .typeId = typeId});
+  }
+}
+
+auto Game::spikesScript(TileConcrete &tile, bool wall) -> ScriptTask {
+  const auto pos = tile.record().pos;
+  const auto cell = gridCell(pos);
+  if (tile.record().typeId != spikesTypeId) {
+    setTileType(tile, wall, spikesTypeId);
+  }
+  for (;;) {
+    co_await scripts_.sleep(spikesDownDuration);
+    for (TileTypeId frame = 1; frame < spikesFrames; ++frame) {
+      setTileType(tile, wall, static_cast<TileTypeId>(spikesTypeId + frame));
+      co_await scripts_.sleep(tileFrameDuration);
+    }
+
+    const auto playerCell = gridCell(player_.getPos().asSdlPoint());
+    if (playerCell.x == cell.x && playerCell.y == cell.y &&
+        player_.getRenderable() != nullptr) {
+      player_.getRenderable()->setHit();
+      particles_.emit(ParticleEffect::Spark,
+                      {pos.x + (gridSize / 2), pos.y + (gridSize / 2)},
+                      sparkCount);
+    }
+    co_await scripts_.sleep(spikesUpDuration);
+
+    for (auto frame = spikesFrames - 1; frame-- > 0;) {
+      setTileType(tile, wall, static_cast<TileTypeId>(spikesTypeId + frame));
+      co_await scripts_.sleep(tileFrameDuration);
+    }
+  }
+}
+
+auto Game::leverScript(TileConcrete &tile, bool wall, TriggerId stepped)
+    -> ScriptTask {
+  for (;;) {
+    co_await scripts_.trigger(stepped);
+    const auto left = tile.record().typeId == leverLeftTypeId;
+    setTileType(tile, wall, left ? leverRightTypeId : leverLeftTypeId);
+    scripts_.fire(leverPulled_);
+  }
+}
+
+auto Game::doorScript(TileConcrete &tile, bool wall) -> ScriptTask {
+  const auto cell = gridCell(tile.record().pos);
+  for (;;) {
+    co_await scripts_.trigger(leverPulled_);
+    const auto open = tile.record().typeId == doorOpenTypeId;
+    setTileType(tile, wall, open ? doorClosedTypeId : doorOpenTypeId);
+    // a door in the wall layer blocks the light and the sight when closed
+    if (wall) {
+      lightMap_.setOpaque(cell.x, cell.y, open);
+      fov_.setOpaque(cell.x, cell.y, open);
+    }
+  }
+}
+
+auto Game::chestScript(TileConcrete &tile, bool wall, TriggerId stepped)
+    -> ScriptTask {
+  co_await scripts_.trigger(stepped);
+  const auto closed = tile.record().typeId;
+  for (TileTypeId frame = 1; frame < chestFrames; ++frame) {
+    co_await scripts_.sleep(tileFrameDuration);
+    setTileType(tile, wall, static_cast<TileTypeId>(closed + frame));
+  }
+  if (closed == chestFullTypeId) {
+    const auto pos = tile.record().pos;
+    for (size_t coin = 0; coin < chestCoins; ++coin) {
+      coinDrops_.push_back(
+          {.x = pos.x + (static_cast<float>(coin) * gridSize / 2),
+           .y = pos.y + gridSize});
+    }
+  }
+}
+
+auto Game::captureEntities() const -> std::vector<EntityState> {
+  const auto capture = [](const CharacterSprite &sprite, Point pos) {
+    return EntityState{.typeId = sprite.typeId(),
+                       .x = quantize(pos.x),
+                       .y = quantize(pos.y),
+                       .clip = sprite.clip(),
+                       .flipped = sprite.isFlipped()};
+  };
+
+  std::vector<EntityState> entities;
+  entities.reserve(spawnedEnemies_.size() + 1);
+  entities.push_back(
+      capture(characters_[gameGui_.getCharacterIndex()], player_.getPos()));
+  for (const auto &enemy : spawnedEnemies_) {
+    entities.push_back(capture(enemy.sprite, enemy.pos));
+  }
+  return entities;
+}
+
+auto Game::captureTiles() const -> std::vector<TileEdit> {
+  std::vector<TileEdit> tiles;
+  tiles.reserve(map_.size() + mapWall_.size());
+  for (const auto wall : {false, true}) {
+    for (const auto &tile : wall ? mapWall_ : map_) {
+      const auto record = tile->record();
+      tiles.push_back({.x = quantize(record.pos.x),
+                       .y = quantize(record.pos.y),
+                       .wall = wall,
+                       .level = record.level,
+                       .typeId = record.typeId});
+    }
+  }
+  return tiles;
+}
+
+auto Game::receiveSnapshot() -> void {
+  auto snapshot = observer_->receive();
+  if (!snapshot || snapshot->entities.empty()) {
+    return;
+  }
+
+  const auto apply = [](CharacterSprite &sprite, const EntityState &state) {
+    if (sprite.clip() != state.clip || sprite.isFlipped() != state.flipped) {
+      sprite.play(state.clip, state.flipped);
+    }
+  };
+  const auto &player = snapshot->entities.front();
+  player_.setPos({.x = dequantize(player.x), .y = dequantize(player.y)});
+  apply(characters_[gameGui_.getCharacterIndex()], player);
+
+  const auto enemies = std::span{snapshot->entities}.subspan(1);
+  if (spawnedEnemies_.size() > enemies.size()) {
+    spawnedEnemies_.erase(spawnedEnemies_.begin() +
+                              static_cast<std::ptrdiff_t>(enemies.size()),
+                          spawnedEnemies_.end());
+  }
+  for (size_t index = 0; index < enemies.size(); ++index) {
+    const auto &state = enemies[index];
+    if (index == spawnedEnemies_.size()) {
+      spawnedEnemies_.push_back(
+          {.sprite = CharacterSprite{state.typeId, animations_},
+           .pos = {},
+           .heading = {}});
+    }
+    auto &enemy = spawnedEnemies_[index];
+    if (enemy.sprite.typeId() != state.typeId) {
+      enemy.sprite.setType(state.typeId);
+    }
+    enemy.pos = {.x = dequantize(state.x), .y = dequantize(state.y)};
+    apply(enemy.sprite, state);
+  }
+
+  if (snapshot->resetTiles) {
+    // a whole level, built at once rather than tile by tile
+    map_.clear();
+    mapWall_.clear();
+    for (const auto &edit : snapshot->edits) {
+      if (edit.typeId) {
+        (edit.wall ? mapWall_ : map_)
+            .push_back(RendererBuilder{*edit.typeId}.build(
+                {dequantize(edit.x), dequantize(edit.y)}, edit.level));
+      }
+    }
+    sortTiles(map_);
+    sortTiles(mapWall_);
+    gameGui_.minimap().rebuild(map_, mapWall_);
+    rebuildGrids();
+    return;
+  }
+  for (const auto &edit : snapshot->edits) {
+    setTile({dequantize(edit.x), dequantize(edit.y)}, edit.wall, edit.level,
+            edit.typeId);
+  }
+}
+
+auto Game::tileColor(const SDL_FPoint &pos) const noexcept
+    -> std::optional<SDL_Color> {
+  const auto cell = gridCell(pos);
+  if (gameGui_.isFogOfWar() && !fov_.isVisible(cell.x, cell.y)) {
+    if (fov_.isExplored(cell.x, cell.y)) {
+      return exploredColor;
+    }
+    return std::nullopt;
+  }
+  return lightColors[lightMap_.level(cell.x, cell.y)];
+}
+
+auto Game::updateGrids(const SDL_FPoint &pos, bool wall,
+                       std::optional<TileTypeId> typeId) -> void {
+  const auto cell = gridCell(pos);
+  if (wall) {
+    lightMap_.setOpaque(cell.x, cell.y, typeId.has_value());
+    fov_.setOpaque(cell.x, cell.y, typeId.has_value());
+  }
+
+  if (wall) {
+    std::erase_if(fountains_, [pos](const SDL_FPoint &fountain) {
+      return fountain.x == pos.x && fountain.y == pos.y;
+    });
+    if (typeId && isFountainBasin(tileType(*typeId))) {
+      fountains_.push_back(pos);
+    }
+  }
+
+  const auto previous = std::ranges::find_if(
+      tileLights_, [pos, wall](const TileLight &light) {
+        return light.wall == wall && light.pos.x == pos.x &&
+               light.pos.y == pos.y;
+      });
+  if (previous != tileLights_.end()) {
+    lightMap_.removeLight(previous->id);
+    tileLights_.erase(previous);
+  }
+
+  if (typeId) {
+    if (const auto intensity = lightIntensity(tileType(*typeId));
+        intensity != 0) {
+      tileLights_.push_back(
+          {.pos = pos,
+           .wall = wall,
+           .id = lightMap_.addLight(
+               {.x = cell.x, .y = cell.y, .intensity = intensity})});
+    }
+  }
+}
+
+auto Game::rebuildGrids() -> void {
+  lightMap_ = LightMap{gridCells.x, gridCells.y};
+  fov_ = FieldOfView{gridCells.x, gridCells.y};
+  tileLights_.clear();
+  fountains_.clear();
+
+  const auto playerCell = gridCell(player_.getPos().asSdlPoint());
+  playerLight_ = lightMap_.addLight(
+      {.x = playerCell.x, .y = playerCell.y, .intensity = maxLightLevel});
+
+  for (const auto &tile : map_) {
+    const auto record = tile->record();
+    updateGrids(record.pos, false, record.typeId);
+  }
+  for (const auto &tile : mapWall_) {
+    const auto record = tile->record();
+    updateGrids(record.pos, true, record.typeId);
   }
 }
@@ -5,12 +5,28 @@ module;
 
 #include <imgui.h>
 
+#include <SDL3/SDL_pixels.h>
+#include <SDL3/SDL_rect.h>
+#include <SDL3/SDL_render.h>
 #include <SDL3/SDL_stdinc.h>
-
+#include <SDL3/SDL_timer.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <format>
 #include <fstream>
 #include <limits>
 #include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -19,6 +35,442 @@ export module gui;
 import sdlHelpers;
 import tile;
 import sprite;
+import level;
+import dungeon;
+import palette;
+import ai;
+import tileTypes;
+import drawList;
+import occlusion;
+import memory;
+
+/// the search state of a palette tab
+struct PaletteState {
+  static constexpr size_t searchSize{64};
+
+  PaletteIndex index;
+  std::array<char, searchSize> search{};
+  /// the category shown, -1 for every category
+  int category{-1};
+};
+
+/// the room kept before an ImGui block for its size, so the alignment of the
+/// block is kept
+inline constexpr size_t guiBlockHeader{alignof(std::max_align_t)};
+
+/// allocate a block for ImGui, accounted to the gui
+auto guiAllocate(size_t size, void * /*userData*/) -> void * {
+  auto *const block =
+      static_cast<std::byte *>(std::malloc(size + guiBlockHeader));
+  if (block == nullptr) {
+    return nullptr;
+  }
+  std::memcpy(block, &size, sizeof(size));
+  trackAllocation(MemoryTag::Gui, size);
+  return block + guiBlockHeader;
+}
+
+/// free a block allocated by guiAllocate
+auto guiFree(void *pointer, void * /*userData*/) -> void {
+  if (pointer == nullptr) {
+    return;
+  }
+  auto *const block = static_cast<std::byte *>(pointer) - guiBlockHeader;
+  size_t size{};
+  std::memcpy(&size, block, sizeof(size));
+  trackDeallocation(MemoryTag::Gui, size);
+  std::free(block);
+}
+
+/// a hash of the geometry ImGui draws, to tell whether the gui changed
+auto hashDrawData(const ImDrawData &drawData) -> std::uint64_t {
+  constexpr std::uint64_t prime{1099511628211ULL};
+  std::uint64_t hash{14695981039346656037ULL};
+  // FNV-1a over words, the bytes past the last word are mixed one by one
+  const auto mix = [&hash](const void *data, size_t size) {
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    size_t offset{};
+    for (; offset + sizeof(std::uint64_t) <= size;
+         offset += sizeof(std::uint64_t)) {
+      std::uint64_t word{};
+      std::memcpy(&word, bytes + offset, sizeof(word));
+      hash = (hash ^ word) * prime;
+    }
+    for (; offset < size; ++offset) {
+      hash = (hash ^ bytes[offset]) * prime;
+    }
+  };
+
+  mix(&drawData.DisplaySize, sizeof(drawData.DisplaySize));
+  for (const auto *list : drawData.CmdLists) {
+    mix(list->VtxBuffer.Data,
+        static_cast<size_t>(list->VtxBuffer.Size) * sizeof(ImDrawVert));
+    mix(list->IdxBuffer.Data,
+        static_cast<size_t>(list->IdxBuffer.Size) * sizeof(ImDrawIdx));
+    for (const auto &command : list->CmdBuffer) {
+      const auto texture = command.GetTexID();
+      mix(&command.ClipRect, sizeof(command.ClipRect));
+      mix(&texture, sizeof(texture));
+      mix(&command.ElemCount, sizeof(command.ElemCount));
+    }
+  }
+  return hash;
+}
+
+/// the color of a tile type on the minimap
+constexpr auto minimapColor(const TileType &type) -> SDL_Color {
+  constexpr Uint8 opaque{255};
+  const auto name = type.name;
+  if (name.contains("fountain")) {
+    return name.contains("red") ? SDL_Color{200, 50, 50, opaque}
+                                : SDL_Color{60, 100, 220, opaque};
+  }
+  if (name.starts_with("wall") || name.starts_with("column")) {
+    return {130, 130, 140, opaque};
+  }
+  if (name.starts_with("floor")) {
+    return {75, 60, 55, opaque};
+  }
+  if (name.starts_with("edge") || name.starts_with("hole")) {
+    return {25, 25, 35, opaque};
+  }
+  if (name.starts_with("doors")) {
+    return {140, 90, 40, opaque};
+  }
+  if (name.starts_with("chest") || name.starts_with("crate")) {
+    return {200, 160, 40, opaque};
+  }
+  return {180, 180, 180, opaque};
+}
+
+/// the minimap color of every tile type
+inline constexpr auto minimapColors = [] {
+  std::array<SDL_Color, tileTypes.size()> colors{};
+  std::ranges::transform(tileTypes, colors.begin(), minimapColor);
+  return colors;
+}();
+
+/// overview of the level
+///
+/// the tiles are kept on the cpu by cell, only for the cells holding one, and
+/// only the pixels changed since the last frame are uploaded to the streaming
+/// texture. The texture has a fixed side, the cells double until they hold
+/// the level and a pixel shows a square block of cells
+export class Minimap {
+public:
+  Minimap() = default;
+  /// constructor
+  ///
+  /// \param[in] Renderer the renderer the texture is created for
+  /// \param[in] Cells the number of cells of the minimap before it grows
+  /// \param[in] CellSize the size of a grid cell in world units
+  Minimap(SdlRenderer renderer, const SDL_Point &cells, float cellSize);
+
+  Minimap(const Minimap &) = delete;
+  Minimap(Minimap &&) = delete;
+  auto operator=(const Minimap &) -> Minimap & = delete;
+  auto operator=(Minimap &&) -> Minimap & = delete;
+
+  ~Minimap() = default;
+
+  /// set the tile of a cell
+  ///
+  /// \param[in] Pos the position of the tile in the world
+  /// \param[in] Wall whether the tile is in the wall layer
+  /// \param[in] TypeId the type of the tile, nullopt when it was removed
+  auto setCell(const SDL_FPoint &pos, bool wall,
+               std::optional<TileTypeId> typeId) -> void;
+
+  /// set every cell from the layers of a level
+  auto rebuild(const std::vector<std::unique_ptr<TileConcrete>> &map,
+               const std::vector<std::unique_ptr<TileConcrete>> &mapWall)
+      -> void;
+
+  /// upload the changed pixels and show the minimap
+  ///
+  /// \param[in] Width the width of the minimap on screen
+  auto render(float width) -> void;
+
+private:
+  static constexpr TileTypeId noTile{std::numeric_limits<TileTypeId>::max()};
+  static constexpr SDL_Color background{0, 0, 0, 255};
+  /// the side of the texture, in pixels
+  static constexpr int textureSide{256};
+  /// the most cells on a side, the tiles past them are not shown
+  static constexpr int maxCells{8192};
+
+  /// the tiles of a cell
+  struct Cell {
+    TileTypeId floor{noTile};
+    TileTypeId wall{noTile};
+  };
+
+  /// the cell containing a position, nullopt if out of the map
+  [[nodiscard]] auto cellOf(const SDL_FPoint &pos) const
+      -> std::optional<SDL_Point>;
+
+  /// the key of a cell in cells_, in row major order
+  [[nodiscard]] static auto keyOf(const SDL_Point &cell) noexcept
+      -> std::uint32_t {
+    return (static_cast<std::uint32_t>(cell.y) * maxCells) +
+           static_cast<std::uint32_t>(cell.x);
+  }
+
+  /// double the cells until they hold a cell
+  auto grow(const SDL_Point &cell) -> void;
+
+  /// recompute every pixel from the cells holding a tile
+  auto resizePixels() -> void;
+
+  /// the color of a pixel, from the first wall of its cells or else their
+  /// first floor
+  [[nodiscard]] auto pixelColor(const SDL_Point &pixel) const -> SDL_Color;
+
+  /// recompute the pixel of a cell and add it to the changed area
+  auto updatePixel(const SDL_Point &cell) -> void;
+
+  std::optional<SdlRenderer> renderer_;
+  /// created by render, textureSide pixels a side
+  SdlTexturePtr texture_{nullptr, SDL_DestroyTexture};
+  /// the number of columns and rows of cells, a power of two times the
+  /// cells given to the constructor
+  SDL_Point cellCount_{};
+  float cellSize_{1};
+  /// the side of the block of cells a pixel shows
+  int cellsPerPixel_{1};
+
+  /// the cells holding a tile, by keyOf
+  std::unordered_map<std::uint32_t, Cell> cells_;
+  std::vector<SDL_Color> pixels_;
+  /// the pixels not uploaded yet, empty if its width is 0
+  SDL_Rect dirty_{};
+  /// the number of columns and rows holding a tile
+  SDL_Point extent_{};
+};
+
+Minimap::Minimap(SdlRenderer renderer, const SDL_Point &cells, float cellSize)
+    : renderer_{renderer}, cellCount_{cells}, cellSize_{cellSize},
+      pixels_(static_cast<size_t>(textureSide) * textureSide, background) {
+  resizePixels();
+}
+
+auto Minimap::cellOf(const SDL_FPoint &pos) const -> std::optional<SDL_Point> {
+  const auto column = std::floor(pos.x / cellSize_);
+  const auto row = std::floor(pos.y / cellSize_);
+  if (column < 0 || row < 0 || column >= maxCells || row >= maxCells) {
+    return std::nullopt;
+  }
+  return SDL_Point{static_cast<int>(column), static_cast<int>(row)};
+}
+
+auto Minimap::grow(const SDL_Point &cell) -> void {
+  while (cellCount_.x <= cell.x) {
+    cellCount_.x = std::min(cellCount_.x * 2, maxCells);
+  }
+  while (cellCount_.y <= cell.y) {
+    cellCount_.y = std::min(cellCount_.y * 2, maxCells);
+  }
+  resizePixels();
+}
+
+auto Minimap::resizePixels() -> void {
+  cellsPerPixel_ = (std::max(cellCount_.x, cellCount_.y) + textureSide - 1) /
+                   textureSide;
+
+  // a pixel shows its first wall or else its first floor, as pixelColor, so
+  // every wall ranks before the floors
+  constexpr auto floorRank = std::uint64_t{maxCells} * maxCells;
+  std::vector<std::uint64_t> ranks(pixels_.size(), 2 * floorRank);
+  std::ranges::fill(pixels_, background);
+  for (const auto &[key, cell] : cells_) {
+    const auto column = static_cast<int>(key % maxCells) / cellsPerPixel_;
+    const auto row = static_cast<int>(key / maxCells) / cellsPerPixel_;
+    const auto index = (static_cast<size_t>(row) * textureSide) +
+                       static_cast<size_t>(column);
+    const bool wall = cell.wall != noTile;
+    const auto rank = key + (wall ? 0 : floorRank);
+    if (rank < ranks[index]) {
+      ranks[index] = rank;
+      pixels_[index] = minimapColors[wall ? cell.wall : cell.floor];
+    }
+  }
+  dirty_ = {0, 0, textureSide, textureSide};
+}
+
+auto Minimap::pixelColor(const SDL_Point &pixel) const -> SDL_Color {
+  const auto left = pixel.x * cellsPerPixel_;
+  const auto top = pixel.y * cellsPerPixel_;
+  std::optional<TileTypeId> floor;
+  for (auto row = top; row < top + cellsPerPixel_; ++row) {
+    for (auto column = left; column < left + cellsPerPixel_; ++column) {
+      const auto cell = cells_.find(keyOf({column, row}));
+      if (cell == cells_.end()) {
+        continue;
+      }
+      if (cell->second.wall != noTile) {
+        return minimapColors[cell->second.wall];
+      }
+      if (!floor) {
+        floor = cell->second.floor;
+      }
+    }
+  }
+  return floor ? minimapColors[*floor] : background;
+}
+
+auto Minimap::setCell(const SDL_FPoint &pos, bool wall,
+                      std::optional<TileTypeId> typeId) -> void {
+  const auto cell = cellOf(pos);
+  if (!cell) {
+    return;
+  }
+  if (cell->x >= cellCount_.x || cell->y >= cellCount_.y) {
+    grow(*cell);
+  }
+
+  const auto key = keyOf(*cell);
+  auto &tiles = cells_[key];
+  (wall ? tiles.wall : tiles.floor) = typeId.value_or(noTile);
+  if (tiles.wall == noTile && tiles.floor == noTile) {
+    cells_.erase(key);
+  } else {
+    extent_ = {std::max(extent_.x, cell->x + 1),
+               std::max(extent_.y, cell->y + 1)};
+  }
+  updatePixel(*cell);
+}
+
+auto Minimap::rebuild(
+    const std::vector<std::unique_ptr<TileConcrete>> &map,
+    const std::vector<std::unique_ptr<TileConcrete>> &mapWall) -> void {
+  cells_.clear();
+  std::ranges::fill(pixels_, background);
+  dirty_ = {0, 0, textureSide, textureSide};
+  extent_ = {};
+
+  for (const auto &tile : map) {
+    const auto record = tile->record();
+    setCell(record.pos, false, record.typeId);
+  }
+  for (const auto &tile : mapWall) {
+    const auto record = tile->record();
+    setCell(record.pos, true, record.typeId);
+  }
+}
+
+auto Minimap::updatePixel(const SDL_Point &cell) -> void {
+  const SDL_Point pixel{cell.x / cellsPerPixel_, cell.y / cellsPerPixel_};
+  pixels_[(static_cast<size_t>(pixel.y) * textureSide) +
+          static_cast<size_t>(pixel.x)] = pixelColor(pixel);
+
+  if (dirty_.w == 0) {
+    dirty_ = {pixel.x, pixel.y, 1, 1};
+    return;
+  }
+  const auto right = std::max(dirty_.x + dirty_.w, pixel.x + 1);
+  const auto bottom = std::max(dirty_.y + dirty_.h, pixel.y + 1);
+  dirty_.x = std::min(dirty_.x, pixel.x);
+  dirty_.y = std::min(dirty_.y, pixel.y);
+  dirty_.w = right - dirty_.x;
+  dirty_.h = bottom - dirty_.y;
+}
+
+auto Minimap::render(float width) -> void {
+  if (!renderer_) {
+    return;
+  }
+  if (!texture_) {
+    texture_ = renderer_->createStreamingTexture({textureSide, textureSide});
+  }
+
+  if (dirty_.w > 0) {
+    const auto first = (static_cast<size_t>(dirty_.y) * textureSide) +
+                       static_cast<size_t>(dirty_.x);
+    SDL_UpdateTexture(texture_.get(), &dirty_, &pixels_[first],
+                      textureSide * static_cast<int>(sizeof(SDL_Color)));
+    dirty_ = {};
+  }
+
+  // only the area holding tiles is shown, so small levels are not a dot
+  const SDL_Point shown{
+      std::max((extent_.x + cellsPerPixel_ - 1) / cellsPerPixel_, 1),
+      std::max((extent_.y + cellsPerPixel_ - 1) / cellsPerPixel_, 1)};
+  const auto scale = width / static_cast<float>(std::max(shown.x, shown.y));
+  ImGui::Image((ImTextureID)(intptr_t)texture_.get(),
+               {static_cast<float>(shown.x) * scale,
+                static_cast<float>(shown.y) * scale},
+               {0, 0},
+               {static_cast<float>(shown.x) / textureSide,
+                static_cast<float>(shown.y) / textureSide});
+}
+
+/// debug view of the number of times each pixel of the world is filled
+///
+/// the overdraw is counted from the draw list on the cpu, so it measures the
+/// fill rate of any renderer, and shown as a heatmap
+export class OverdrawView {
+public:
+  OverdrawView() = default;
+  /// constructor
+  ///
+  /// \param[in] Renderer the renderer the heatmap texture is created for
+  explicit OverdrawView(SdlRenderer renderer) : renderer_{renderer} {}
+
+  /// count the overdraw of a draw list and upload its heatmap
+  ///
+  /// \param[in] DrawList the commands of the frame
+  /// \param[in] Size the size of the screen the commands are drawn to
+  auto update(const DrawList &drawList, const SDL_Point &size) -> void;
+
+  /// show the heatmap and the fill rate
+  ///
+  /// \param[in] Width the width of the heatmap on screen
+  /// \param[in] Stats the sprites culled by the occlusion of the frame
+  auto render(float width, const OcclusionStats &stats) const -> void;
+
+private:
+  std::optional<SdlRenderer> renderer_;
+  SdlTexturePtr texture_{nullptr, SDL_DestroyTexture};
+  OverdrawMap map_;
+  std::vector<SDL_Color> pixels_;
+};
+
+auto OverdrawView::update(const DrawList &drawList, const SDL_Point &size)
+    -> void {
+  if (!renderer_) {
+    return;
+  }
+  const auto previous = map_.size();
+  map_.count(drawList, size);
+  if (!texture_ || previous.x != size.x || previous.y != size.y) {
+    texture_ = renderer_->createStreamingTexture(size);
+  }
+
+  pixels_.resize(map_.fills().size());
+  std::ranges::transform(map_.fills(), pixels_.begin(), heatColor);
+  SDL_UpdateTexture(texture_.get(), nullptr, pixels_.data(),
+                    size.x * static_cast<int>(sizeof(SDL_Color)));
+}
+
+auto OverdrawView::render(float width, const OcclusionStats &stats) const
+    -> void {
+  const auto fillRate =
+      map_.covered() > 0 ? static_cast<double>(map_.filled()) /
+                               static_cast<double>(map_.covered())
+                         : 0.;
+  const auto text = std::format(
+      "sprites drawn:{} culled:{}\npixels filled:{} overdraw:{:.2f}",
+      stats.drawn, stats.culled, map_.filled(), fillRate);
+  ImGui::TextUnformatted(text.data(), &*text.cend());
+
+  const auto size = map_.size();
+  if (!texture_ || size.x == 0) {
+    return;
+  }
+  const auto scale = width / static_cast<float>(size.x);
+  ImGui::Image((ImTextureID)(intptr_t)texture_.get(),
+               {width, static_cast<float>(size.y) * scale});
+}
 
 /// used to manage ImGui gui
 export class Gui {
@@ -30,21 +482,39 @@ public:
   /// \param[in] Renderer the renderer used to render to the window
   Gui(const SdlWindow &window, SdlRenderer renderer);
 
-  Gui(const Gui &) = default;
+  Gui(const Gui &) = delete;
   Gui(Gui &&) = delete;
-  auto operator=(const Gui &) -> Gui & = default;
+  auto operator=(const Gui &) -> Gui & = delete;
   auto operator=(Gui &&) -> Gui & = delete;
 
   ~Gui();
 
-  auto render(const SdlRenderer &renderer,
-              std::vector<CharacterSprite> &characters,
-              std::vector<CharacterSprite> &enemies,
+  /// get the minimap, to report the cells changed outside of the Gui
+  [[nodiscard]] auto minimap() noexcept -> Minimap & { return minimap_; }
+  /// get the overdraw view, fed the draw lists while isOverdrawView
+  [[nodiscard]] auto overdraw() noexcept -> OverdrawView & {
+    return overdraw_;
+  }
+
+  /// set the texture the palette thumbnails are taken from
+  ///
+  /// \param[in] Texture the tileset texture
+  auto setAtlas(const SdlTexturePtr &texture) -> void;
+
+  /// build the Gui of the frame
+  ///
+  /// the Gui is drawn afterward with SdlRenderer::imguiRenderDrawData
+  auto render(CharacterSprites &characters, CharacterSprites &enemies,
               std::vector<RendererBuilder> &tiles,
               std::vector<std::unique_ptr<TileConcrete>> &map,
               std::vector<std::unique_ptr<TileConcrete>> &mapWall) -> void;
 
   [[nodiscard]] auto isEditorMode() const -> bool { return checkEditor_; }
+  [[nodiscard]] auto isFogOfWar() const -> bool { return checkFogOfWar_; }
+  [[nodiscard]] auto isOcclusionCulling() const -> bool {
+    return checkOcclusion_;
+  }
+  [[nodiscard]] auto isOverdrawView() const -> bool { return checkOverdraw_; }
   [[nodiscard]] auto isLevel() const -> bool { return checkLevel_; }
   [[nodiscard]] auto isRunning() const -> bool { return checkBoxRuning_; }
   [[nodiscard]] auto isWall() const -> bool { return checkBoxWall_; }
@@ -53,18 +523,51 @@ public:
     this->timeToRenderFrame_ = timeToRenderFrame;
   }
 
-  auto renderEditorOptions(std::vector<CharacterSprite> &characters,
-                           std::vector<CharacterSprite> &enemies,
+  /// set the AI cost of the last tick, shown under the frame duration
+  auto aiStats(const AiStats &stats) noexcept -> void { aiStats_ = stats; }
+
+  /// set the sprites culled in the last tick, shown in the overdraw view
+  auto occlusionStats(const OcclusionStats &stats) noexcept -> void {
+    occlusionStats_ = stats;
+  }
+
+  auto renderEditorOptions(CharacterSprites &characters,
+                           CharacterSprites &enemies,
                            std::vector<RendererBuilder> &tiles,
                            std::vector<std::unique_ptr<TileConcrete>> &map,
                            std::vector<std::unique_ptr<TileConcrete>> &mapWall)
 
       -> void;
 
-  template <class Array>
-  auto renderComboBox(const char *name, Array &array, size_t &currentIndex)
+  /// queue a save of the level if autosave is enabled and due
+  auto autosave(const std::vector<std::unique_ptr<TileConcrete>> &map,
+                const std::vector<std::unique_ptr<TileConcrete>> &mapWall)
       -> void;
 
+  /// show the progress or the result of the last save
+  auto renderSaveStatus() const -> void;
+
+  /// show the memory of every subsystem and its allocation rate
+  auto renderMemory() -> void;
+
+  /// show the palette window, a searchable list of tiles and characters
+  auto renderPalette(const CharacterSprites &characters,
+                     const CharacterSprites &enemies,
+                     const std::vector<RendererBuilder> &tiles) -> void;
+
+  /// show a palette tab
+  ///
+  /// only the visible rows are built, the search filters a prebuilt index
+  /// \param[in] Array the entries of the palette
+  /// \param[in,out] State the search state of the palette
+  /// \param[in,out] CurrentIndex the index of the selected entry
+  template <class Array>
+  auto renderPaletteTab(const Array &array, PaletteState &state,
+                        size_t &currentIndex) -> void;
+
+  /// show the atlas area of a tile type
+  auto renderThumbnail(TileTypeId typeId) const -> void;
+
   /// processEvent for imgui
   ///
   /// \param Event the event from Sdl
@@ -77,19 +580,69 @@ public:
   [[nodiscard]] auto getEnemyIndex() const -> size_t { return enemyIndex_; }
   [[nodiscard]] auto getTileIndex() const -> size_t { return tileIndex_; }
 
+  /// whether the last render drew something else than the one before
+  [[nodiscard]] auto isDamaged() const noexcept -> bool { return damaged_; }
+
+  /// whether a level was loaded since the last call
+  [[nodiscard]] auto takeLevelLoaded() noexcept -> bool {
+    return std::exchange(levelLoaded_, false);
+  }
+
 private:
+  static constexpr const char *levelPath{"test.lvl"};
+  static constexpr int defaultAutosaveInterval{60};
+  static constexpr Uint64 msPerSecond{1000};
+  static constexpr float thumbnailSize{32};
+  static constexpr SDL_Point minimapCells{256, 256};
+  static constexpr float minimapCellSize{16};
+  static constexpr float minimapWidth{256};
+  static constexpr float overdrawWidth{640};
+  /// the size of the generated dungeons, the size of the game grid
+  static constexpr SDL_Point dungeonCells{256, 256};
+
   bool checkBoxRuning_{};
   bool checkBoxWall_{};
   bool checkLevel_{};
   bool checkEditor_{};
+  bool checkFogOfWar_{};
+  bool checkOcclusion_{true};
+  bool checkOverdraw_{};
+  bool checkMemory_{};
   Uint64 timeToRenderFrame_{};
+  AiStats aiStats_{};
+  /// the frame duration and the AI cost as shown
+  std::string statsText_;
+  Uint64 lastStatsUpdate_{};
+  OcclusionStats occlusionStats_{};
   size_t characterIndex_{};
   size_t enemyIndex_{};
   size_t tileIndex_{};
+  bool levelLoaded_{};
+  /// the hash of the last draw data
+  std::uint64_t drawDataHash_{};
+  bool damaged_{true};
+
+  PaletteState characterPalette_;
+  PaletteState enemyPalette_;
+  PaletteState tilePalette_;
+  SDL_Texture *atlas_{};
+  ImVec2 atlasSize_{};
+  Minimap minimap_;
+  OverdrawView overdraw_;
+  MemoryMeter memoryMeter_{msPerSecond};
+
+  bool checkAutosave_{};
+  int autosaveInterval_{defaultAutosaveInterval}; ///< in seconds
+  Uint64 lastAutosave_{};
+  LevelSaver levelSaver_;
+  /// the seed of the next generated dungeon
+  int dungeonSeed_{};
 };
 
-Gui::Gui(const SdlWindow &window, SdlRenderer renderer) {
+Gui::Gui(const SdlWindow &window, SdlRenderer renderer)
+    : minimap_{renderer, minimapCells, minimapCellSize}, overdraw_{renderer} {
   IMGUI_CHECKVERSION();
+  ImGui::SetAllocatorFunctions(guiAllocate, guiFree);
   ImGui::CreateContext();
   auto &imIo = ImGui::GetIO();
   imIo.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
@@ -106,9 +659,12 @@ Gui::~Gui() {
   ImGui::DestroyContext();
 }
 
-auto Gui::render(const SdlRenderer &renderer,
-                 std::vector<CharacterSprite> &characters,
-                 std::vector<CharacterSprite> &enemies,
+auto Gui::setAtlas(const SdlTexturePtr &texture) -> void {
+  atlas_ = texture.get();
+  SDL_GetTextureSize(atlas_, &atlasSize_.x, &atlasSize_.y);
+}
+
+auto Gui::render(CharacterSprites &characters, CharacterSprites &enemies,
                  std::vector<RendererBuilder> &tiles,
                  std::vector<std::unique_ptr<TileConcrete>> &map,
                  std::vector<std::unique_ptr<TileConcrete>> &mapWall) -> void {
@@ -120,22 +676,57 @@ auto Gui::render(const SdlRenderer &renderer,
   if (ImGui::BeginMainMenuBar()) {
     if (ImGui::BeginMenu("File")) {
       ImGui::MenuItem("Editor mode", nullptr, &checkEditor_);
+      ImGui::MenuItem("Fog of war", nullptr, &checkFogOfWar_);
+      ImGui::MenuItem("Occlusion culling", nullptr, &checkOcclusion_);
+      ImGui::MenuItem("Overdraw heatmap", nullptr, &checkOverdraw_);
+      ImGui::MenuItem("Memory", nullptr, &checkMemory_);
       ImGui::EndMenu();
     }
     ImGui::EndMainMenuBar();
   }
 
-  std::string frameRenderingDuationText =
-      std::format("frame ms:{}", timeToRenderFrame_);
-  ImGui::TextUnformatted(frameRenderingDuationText.data(),
-                         &*frameRenderingDuationText.cend());
+  // the counters change on most frames, refreshing them once a second keeps
+  // them from damaging an idle gui
+  const auto now = SDL_GetTicks();
+  if (statsText_.empty() || now - lastStatsUpdate_ >= msPerSecond) {
+    statsText_ = std::format("frame ms:{}\nai us:{} updated:{} skipped:{}",
+                             timeToRenderFrame_, aiStats_.cost.count(),
+                             aiStats_.updated, aiStats_.skipped);
+    lastStatsUpdate_ = now;
+  }
+  ImGui::TextUnformatted(statsText_.data(), &*statsText_.cend());
 
   if (checkEditor_) {
     renderEditorOptions(characters, enemies, tiles, map, mapWall);
   }
 
+  if (ImGui::Begin("Minimap")) {
+    minimap_.render(minimapWidth);
+  }
+  ImGui::End();
+
+  if (checkOverdraw_) {
+    if (ImGui::Begin("Overdraw", &checkOverdraw_)) {
+      overdraw_.render(overdrawWidth, occlusionStats_);
+    }
+    ImGui::End();
+  }
+
+  memoryMeter_.sample(SDL_GetTicks());
+  if (checkMemory_) {
+    if (ImGui::Begin("Memory", &checkMemory_)) {
+      renderMemory();
+    }
+    ImGui::End();
+  }
+
+  autosave(map, mapWall);
+
   ImGui::Render();
-  renderer.imguiRenderDrawData();
+
+  const auto hash = hashDrawData(*ImGui::GetDrawData());
+  damaged_ = hash != drawDataHash_;
+  drawDataHash_ = hash;
 }
 
 auto Gui::processEvent(SDL_Event &event) -> bool {
@@ -144,33 +735,186 @@ auto Gui::processEvent(SDL_Event &event) -> bool {
   return ImGui::GetIO().WantCaptureMouse;
 }
 
-template <class Array>
-auto Gui::renderComboBox(const char *name, Array &array, size_t &currentIndex)
+auto Gui::autosave(const std::vector<std::unique_ptr<TileConcrete>> &map,
+                   const std::vector<std::unique_ptr<TileConcrete>> &mapWall)
     -> void {
-  if (ImGui::BeginCombo(name, array[currentIndex].name().c_str())) {
-    for (auto index = 0; index < array.size(); ++index) {
-      if (ImGui::Selectable(array[index].name().c_str(),
-                            std::cmp_equal(currentIndex, index))) {
-        currentIndex = index;
-      }
+  const auto now = SDL_GetTicks();
+  if (!checkAutosave_ ||
+      now - lastAutosave_ <
+          static_cast<Uint64>(autosaveInterval_) * msPerSecond) {
+    return;
+  }
+  lastAutosave_ = now;
+
+  if (levelSaver_.state() != SaveState::Saving) {
+    levelSaver_.save(LevelSnapshot::capture(map, mapWall), levelPath);
+  }
+}
+
+auto Gui::renderSaveStatus() const -> void {
+  switch (levelSaver_.state()) {
+  case SaveState::Idle:
+    break;
+  case SaveState::Saving:
+    ImGui::SameLine();
+    ImGui::ProgressBar(levelSaver_.progress());
+    break;
+  case SaveState::Done:
+    ImGui::SameLine();
+    ImGui::TextUnformatted("saved");
+    break;
+  case SaveState::Failed: {
+    ImGui::SameLine();
+    const auto error = std::format("save failed: {}", levelSaver_.lastError());
+    ImGui::TextUnformatted(error.data(), &*error.cend());
+    break;
+  }
+  }
+}
 
-      if (std::cmp_equal(currentIndex, index)) {
-        ImGui::SetItemDefaultFocus();
+auto Gui::renderMemory() -> void {
+  constexpr int columns{4};
+  if (!ImGui::BeginTable("memory", columns)) {
+    return;
+  }
+  ImGui::TableSetupColumn("subsystem");
+  ImGui::TableSetupColumn("live");
+  ImGui::TableSetupColumn("peak");
+  ImGui::TableSetupColumn("allocated/s");
+  ImGui::TableHeadersRow();
+  for (size_t index = 0; index < memoryTagCount; ++index) {
+    const auto tag = static_cast<MemoryTag>(index);
+    const auto usage = memoryUsage(tag);
+    const auto name = memoryTagName(tag);
+    const std::array cells{
+        std::string{name}, formatBytes(static_cast<double>(usage.live)),
+        formatBytes(static_cast<double>(usage.peak)),
+        formatBytes(memoryMeter_.rate(tag))};
+    ImGui::TableNextRow();
+    for (const auto &cell : cells) {
+      ImGui::TableNextColumn();
+      ImGui::TextUnformatted(cell.data(), &*cell.cend());
+    }
+  }
+  ImGui::EndTable();
+}
+
+auto Gui::renderPalette(const CharacterSprites &characters,
+                        const CharacterSprites &enemies,
+                        const std::vector<RendererBuilder> &tiles) -> void {
+  ImGui::Begin("Palette");
+  if (ImGui::BeginTabBar("palette")) {
+    if (ImGui::BeginTabItem("Tiles")) {
+      renderPaletteTab(tiles, tilePalette_, tileIndex_);
+      ImGui::EndTabItem();
+    }
+    if (ImGui::BeginTabItem("Characters")) {
+      renderPaletteTab(characters, characterPalette_, characterIndex_);
+      ImGui::EndTabItem();
+    }
+    if (ImGui::BeginTabItem("Enemies")) {
+      renderPaletteTab(enemies, enemyPalette_, enemyIndex_);
+      ImGui::EndTabItem();
+    }
+    ImGui::EndTabBar();
+  }
+  ImGui::End();
+}
+
+template <class Array>
+auto Gui::renderPaletteTab(const Array &array, PaletteState &state,
+                           size_t &currentIndex) -> void {
+  if (state.index.size() != array.size()) {
+    std::vector<TileTypeId> typeIds;
+    typeIds.reserve(array.size());
+    for (const auto &entry : array) {
+      typeIds.push_back(entry.typeId());
+    }
+    state.index = PaletteIndex{typeIds};
+  }
+
+  ImGui::InputTextWithHint("##search", "search", state.search.data(),
+                           state.search.size());
+
+  const auto categories = state.index.categories();
+  const char *preview =
+      state.category < 0 ? "all" : categories[state.category].c_str();
+  if (ImGui::BeginCombo("category", preview)) {
+    if (ImGui::Selectable("all", state.category < 0)) {
+      state.category = -1;
+    }
+    for (int category = 0; std::cmp_less(category, categories.size());
+         ++category) {
+      if (ImGui::Selectable(categories[category].c_str(),
+                            state.category == category)) {
+        state.category = category;
       }
     }
     ImGui::EndCombo();
   }
+
+  std::string query{state.search.data()};
+  std::ranges::transform(query, query.begin(), [](unsigned char character) {
+    return static_cast<char>(std::tolower(character));
+  });
+  state.index.filter(query, state.category < 0
+                                ? std::nullopt
+                                : std::optional<size_t>{state.category});
+
+  const auto results = state.index.results();
+  ImGui::BeginChild("entries");
+  ImGuiListClipper clipper;
+  clipper.Begin(static_cast<int>(results.size()),
+                thumbnailSize + ImGui::GetStyle().ItemSpacing.y);
+  while (clipper.Step()) {
+    for (auto row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+      const auto &entry = state.index.entry(results[row]);
+      const auto &type = tileType(entry.typeId);
+
+      ImGui::PushID(row);
+      renderThumbnail(entry.typeId);
+      ImGui::SameLine(thumbnailSize + ImGui::GetStyle().ItemSpacing.x);
+      if (ImGui::Selectable(type.name.data(), currentIndex == entry.item, 0,
+                            {0, thumbnailSize})) {
+        currentIndex = entry.item;
+      }
+      ImGui::SameLine();
+      ImGui::TextDisabled("%s", categories[entry.category].c_str());
+      ImGui::PopID();
+    }
+  }
+  ImGui::EndChild();
+}
+
+auto Gui::renderThumbnail(TileTypeId typeId) const -> void {
+  const auto &rect = sourceRect(typeId);
+  if (atlas_ == nullptr) {
+    ImGui::Dummy({thumbnailSize, thumbnailSize});
+    return;
+  }
+
+  const auto scale = thumbnailSize / std::max(rect.w, rect.h);
+  const ImVec2 uvMin{rect.x / atlasSize_.x, rect.y / atlasSize_.y};
+  const ImVec2 uvMax{(rect.x + rect.w) / atlasSize_.x,
+                     (rect.y + rect.h) / atlasSize_.y};
+  ImGui::Image((ImTextureID)(intptr_t)atlas_, {rect.w * scale, rect.h * scale},
+               uvMin, uvMax);
 }
 
-auto Gui::renderEditorOptions(std::vector<CharacterSprite> &characters,
-                              std::vector<CharacterSprite> &enemies,
+auto Gui::renderEditorOptions(CharacterSprites &characters,
+                              CharacterSprites &enemies,
                               std::vector<RendererBuilder> &tiles,
                               std::vector<std::unique_ptr<TileConcrete>> &map,
                               std::vector<std::unique_ptr<TileConcrete>> &mapWall)
     -> void {
+  renderPalette(characters, enemies, tiles);
+
   ImGui::Begin("Editor");
-  renderComboBox("Character Selector", characters, characterIndex_);
-  renderComboBox("Enemy Selector", enemies, enemyIndex_);
+  const auto selection =
+      std::format("character: {}\nenemy: {}\ntile: {}",
+                  characters[characterIndex_].type().name,
+                  enemies[enemyIndex_].type().name, tiles[tileIndex_].name());
+  ImGui::TextUnformatted(selection.data(), &*selection.cend());
 
   if (ImGui::Checkbox("running", &checkBoxRuning_)) {
     if (checkBoxRuning_) {
@@ -180,55 +924,41 @@ auto Gui::renderEditorOptions(std::vector<CharacterSprite> &characters,
     }
   }
 
-  renderComboBox("Tile Selector", tiles, tileIndex_);
-
   ImGui::Checkbox("wall", &checkBoxWall_);
 
   ImGui::Checkbox("Level", &checkLevel_);
 
   if (ImGui::Button("save")) {
-    std::fstream file;
-    file.open("test.lvl", std::ios::out | std::ios::trunc);
+    levelSaver_.save(LevelSnapshot::capture(map, mapWall), levelPath);
+  }
+  renderSaveStatus();
 
-    for (auto &tile : map) {
-      file << *tile << '\n';
-    }
-    file << "=====\n";
-    for (auto &tile : mapWall) {
-      file << *tile << '\n';
+  ImGui::Checkbox("autosave", &checkAutosave_);
+  if (checkAutosave_) {
+    ImGui::SameLine();
+    if (ImGui::InputInt("seconds", &autosaveInterval_)) {
+      autosaveInterval_ = std::max(autosaveInterval_, 1);
     }
   }
 
   if (ImGui::Button("load")) {
-    map.clear();
-    mapWall.clear();
     std::fstream file;
-    file.open("test.lvl", std::ios::in);
-    while (!file.eof()) {
-      RendererBuilder builder;
-      file >> builder;
-      file.ignore();
-      if (file.good()) {
-        map.push_back(builder.build());
-      } else {
-        break;
-      }
-    }
-    file.clear();
-    file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-    while (!file.eof()) {
-      RendererBuilder builder;
-      file >> builder;
-      file.ignore();
-      if (file.good()) {
-
-        mapWall.push_back(builder.build());
-      } else {
-        file.clear();
-        file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-      }
-    }
+    file.open(levelPath, std::ios::in);
+    readLevel(file, map, mapWall);
+    minimap_.rebuild(map, mapWall);
+    levelLoaded_ = true;
+  }
+
+  if (ImGui::Button("generate")) {
+    buildLevel(generateDungeon({.cells = dungeonCells,
+                                .seed = static_cast<std::uint64_t>(
+                                    dungeonSeed_)}),
+               map, mapWall);
+    minimap_.rebuild(map, mapWall);
+    levelLoaded_ = true;
   }
+  ImGui::SameLine();
+  ImGui::InputInt("seed", &dungeonSeed_);
 
   ImGui::End();
 }
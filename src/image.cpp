@@ -0,0 +1,25 @@
+module;
+
+#include "SDL3/SDL_pixels.h"
+
+#include <cstddef>
+#include <vector>
+
+export module image;
+
+/// an image in memory, in the byte order of SDL_PIXELFORMAT_RGBA32
+export struct Image {
+  int width{};
+  int height{};
+  /// the pixels, row by row
+  std::vector<SDL_Color> pixels;
+
+  [[nodiscard]] auto at(int x, int y) const noexcept -> const SDL_Color & {
+    return pixels[(static_cast<size_t>(y) * static_cast<size_t>(width)) +
+                  static_cast<size_t>(x)];
+  }
+  [[nodiscard]] auto at(int x, int y) noexcept -> SDL_Color & {
+    return pixels[(static_cast<size_t>(y) * static_cast<size_t>(width)) +
+                  static_cast<size_t>(x)];
+  }
+};
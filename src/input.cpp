@@ -0,0 +1,384 @@
+module;
+
+#include "SDL3/SDL_events.h"
+#include "SDL3/SDL_rect.h"
+#include "SDL3/SDL_scancode.h"
+#include "SDL3/SDL_stdinc.h"
+#include "SDL3/SDL_video.h"
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+export module input;
+
+/// an error occured while reading or writing an input recording
+export class InputFileError : public std::exception {
+public:
+  /// constructor
+  ///
+  /// \param[in] ErrorMessage the error message
+  InputFileError(std::string_view errorMessage) : errorMessage_(errorMessage) {}
+
+  /// get the error message
+  ///
+  /// \return the error message
+  [[nodiscard]] auto what() const noexcept -> const char * override {
+    return errorMessage_.c_str();
+  }
+
+private:
+  std::string errorMessage_; ///< the error message
+};
+
+constexpr std::array<char, 4> recordingMagic{'I', 'R', 'E', 'C'};
+constexpr Uint16 recordingVersion{2};
+
+/// the part of an SDL_Event the game reacts to
+struct RecordedEvent {
+  Uint32 type;
+  /// keycode for key events, button for mouse button events
+  Uint32 key;
+  Uint16 scancode;
+  Uint16 mod;
+  /// mouse position, or scroll amount for wheel events
+  float x;
+  float y;
+  bool down;
+  /// the text of text input events
+  std::string text;
+};
+
+template <class Type>
+auto writeValue(std::ostream &ostream, const Type &value) -> void {
+  std::array<char, sizeof(Type)> bytes{};
+  std::memcpy(bytes.data(), &value, sizeof(Type));
+  ostream.write(bytes.data(), bytes.size());
+}
+
+template <class Type> auto readValue(std::istream &istream) -> Type {
+  std::array<char, sizeof(Type)> bytes{};
+  istream.read(bytes.data(), bytes.size());
+  Type value;
+  std::memcpy(&value, bytes.data(), sizeof(Type));
+  return value;
+}
+
+/// whether the game reacts to an event of this type
+auto isRecorded(Uint32 type) -> bool {
+  switch (type) {
+  case SDL_EVENT_QUIT:
+  case SDL_EVENT_WINDOW_CLOSE_REQUESTED:
+  case SDL_EVENT_KEY_DOWN:
+  case SDL_EVENT_KEY_UP:
+  case SDL_EVENT_MOUSE_MOTION:
+  case SDL_EVENT_MOUSE_BUTTON_DOWN:
+  case SDL_EVENT_MOUSE_BUTTON_UP:
+  case SDL_EVENT_MOUSE_WHEEL:
+  case SDL_EVENT_TEXT_INPUT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+auto toRecorded(const SDL_Event &event) -> RecordedEvent {
+  RecordedEvent recorded{.type = event.type};
+  switch (event.type) {
+  case SDL_EVENT_KEY_DOWN:
+  case SDL_EVENT_KEY_UP:
+    recorded.key = event.key.key;
+    recorded.scancode = static_cast<Uint16>(event.key.scancode);
+    recorded.mod = event.key.mod;
+    recorded.down = event.key.down;
+    break;
+  case SDL_EVENT_MOUSE_MOTION:
+    recorded.x = event.motion.x;
+    recorded.y = event.motion.y;
+    break;
+  case SDL_EVENT_MOUSE_BUTTON_DOWN:
+  case SDL_EVENT_MOUSE_BUTTON_UP:
+    recorded.key = event.button.button;
+    recorded.x = event.button.x;
+    recorded.y = event.button.y;
+    recorded.down = event.button.down;
+    break;
+  case SDL_EVENT_MOUSE_WHEEL:
+    recorded.x = event.wheel.x;
+    recorded.y = event.wheel.y;
+    break;
+  case SDL_EVENT_TEXT_INPUT:
+    recorded.text = event.text.text;
+    break;
+  default:
+    break;
+  }
+  return recorded;
+}
+
+/// the event played back for a recorded one
+///
+/// the text of a text input event points into the recorded event, so it is
+/// valid as long as the recorded event is
+auto toSdlEvent(const RecordedEvent &recorded, SDL_WindowID windowId)
+    -> SDL_Event {
+  SDL_Event event{};
+  event.type = recorded.type;
+  switch (recorded.type) {
+  case SDL_EVENT_WINDOW_CLOSE_REQUESTED:
+    event.window.windowID = windowId;
+    break;
+  case SDL_EVENT_KEY_DOWN:
+  case SDL_EVENT_KEY_UP:
+    event.key.windowID = windowId;
+    event.key.key = recorded.key;
+    event.key.scancode = static_cast<SDL_Scancode>(recorded.scancode);
+    event.key.mod = recorded.mod;
+    event.key.down = recorded.down;
+    break;
+  case SDL_EVENT_MOUSE_MOTION:
+    event.motion.windowID = windowId;
+    event.motion.x = recorded.x;
+    event.motion.y = recorded.y;
+    break;
+  case SDL_EVENT_MOUSE_BUTTON_DOWN:
+  case SDL_EVENT_MOUSE_BUTTON_UP:
+    event.button.windowID = windowId;
+    event.button.button = static_cast<Uint8>(recorded.key);
+    event.button.x = recorded.x;
+    event.button.y = recorded.y;
+    event.button.down = recorded.down;
+    event.button.clicks = 1;
+    break;
+  case SDL_EVENT_MOUSE_WHEEL:
+    event.wheel.windowID = windowId;
+    event.wheel.x = recorded.x;
+    event.wheel.y = recorded.y;
+    break;
+  case SDL_EVENT_TEXT_INPUT:
+    event.text.windowID = windowId;
+    event.text.text = recorded.text.c_str();
+    break;
+  default:
+    break;
+  }
+  return event;
+}
+
+/// record the input of every tick to a binary file
+///
+/// each tick is written as:\n
+/// 'DeltaTime MouseX MouseY KeyChangeCount Scancode... EventCount Event...'\n
+/// only the keys whose state changed since the previous tick are written, a
+/// text input event is followed by 'TextLength Text'
+export class InputRecorder {
+public:
+  /// constructor
+  ///
+  /// \param[in] Path the file to record to
+  explicit InputRecorder(const std::filesystem::path &path);
+
+  /// start recording a tick
+  ///
+  /// \param[in] DeltaTime the time since the last tick in ms
+  auto beginTick(Uint64 deltaTime) -> void;
+
+  /// record the mouse position of the current tick
+  auto recordMouse(const SDL_FPoint &pos) noexcept -> void { mouse_ = pos; }
+
+  /// record the keyboard state of the current tick
+  auto recordKeys(std::span<const bool> keys) -> void;
+
+  /// record an event of the current tick
+  auto recordEvent(const SDL_Event &event) -> void;
+
+  /// write the current tick to the file
+  auto endTick() -> void;
+
+private:
+  std::ofstream file_;
+
+  Uint32 deltaTime_{};
+  SDL_FPoint mouse_{};
+  std::array<bool, SDL_SCANCODE_COUNT> keys_{};
+  std::vector<Uint16> changedKeys_;
+  std::vector<RecordedEvent> events_;
+};
+
+InputRecorder::InputRecorder(const std::filesystem::path &path)
+    : file_{path, std::ios::out | std::ios::binary | std::ios::trunc} {
+  if (!file_) {
+    throw InputFileError{std::format("could not open {}", path.string())};
+  }
+  file_.write(recordingMagic.data(), recordingMagic.size());
+  writeValue(file_, recordingVersion);
+}
+
+auto InputRecorder::beginTick(Uint64 deltaTime) -> void {
+  deltaTime_ = static_cast<Uint32>(deltaTime);
+  changedKeys_.clear();
+  events_.clear();
+}
+
+auto InputRecorder::recordKeys(std::span<const bool> keys) -> void {
+  for (size_t scancode = 0; scancode < keys.size() && scancode < keys_.size();
+       ++scancode) {
+    if (keys[scancode] != keys_[scancode]) {
+      keys_[scancode] = keys[scancode];
+      changedKeys_.push_back(static_cast<Uint16>(scancode));
+    }
+  }
+}
+
+auto InputRecorder::recordEvent(const SDL_Event &event) -> void {
+  if (isRecorded(event.type)) {
+    events_.push_back(toRecorded(event));
+  }
+}
+
+auto InputRecorder::endTick() -> void {
+  writeValue(file_, deltaTime_);
+  writeValue(file_, mouse_.x);
+  writeValue(file_, mouse_.y);
+
+  writeValue(file_, static_cast<Uint16>(changedKeys_.size()));
+  for (const auto scancode : changedKeys_) {
+    writeValue(file_, scancode);
+  }
+
+  writeValue(file_, static_cast<Uint16>(events_.size()));
+  for (const auto &event : events_) {
+    writeValue(file_, event.type);
+    writeValue(file_, event.key);
+    writeValue(file_, event.scancode);
+    writeValue(file_, event.mod);
+    writeValue(file_, event.x);
+    writeValue(file_, event.y);
+    writeValue(file_, static_cast<Uint8>(event.down));
+    if (event.type == SDL_EVENT_TEXT_INPUT) {
+      writeValue(file_, static_cast<Uint16>(event.text.size()));
+      file_.write(event.text.data(),
+                  static_cast<std::streamsize>(event.text.size()));
+    }
+  }
+}
+
+/// play back a file written by an InputRecorder, one tick at a time
+export class InputReplay {
+public:
+  /// constructor
+  ///
+  /// \param[in] Path the recording to play
+  explicit InputReplay(const std::filesystem::path &path);
+
+  /// load the next tick
+  ///
+  /// \return false when the recording is over
+  auto nextTick() -> bool;
+
+  /// the time between the previous tick and this one in ms
+  [[nodiscard]] auto deltaTime() const noexcept -> Uint64 {
+    return deltaTime_;
+  }
+
+  /// the mouse position of the tick
+  [[nodiscard]] auto mousePos() const noexcept -> SDL_FPoint { return mouse_; }
+
+  /// the keyboard state of the tick, indexed by scancode
+  [[nodiscard]] auto keys() const noexcept -> std::span<const bool> {
+    return keys_;
+  }
+
+  /// get the next event of the tick
+  ///
+  /// \param[out] Event the event
+  /// \param[in] WindowId the window the event is sent to
+  /// \return false when every event of the tick was returned
+  auto pollEvent(SDL_Event &event, SDL_WindowID windowId) -> bool;
+
+  /// the number of ticks already played
+  [[nodiscard]] auto tickCount() const noexcept -> size_t { return tick_; }
+
+private:
+  std::ifstream file_;
+
+  size_t tick_{};
+  Uint64 deltaTime_{};
+  SDL_FPoint mouse_{};
+  std::array<bool, SDL_SCANCODE_COUNT> keys_{};
+  std::vector<RecordedEvent> events_;
+  size_t nextEvent_{};
+};
+
+InputReplay::InputReplay(const std::filesystem::path &path)
+    : file_{path, std::ios::in | std::ios::binary} {
+  if (!file_) {
+    throw InputFileError{std::format("could not open {}", path.string())};
+  }
+
+  std::array<char, recordingMagic.size()> magic{};
+  file_.read(magic.data(), magic.size());
+  const auto version = readValue<Uint16>(file_);
+  if (!file_ || magic != recordingMagic || version != recordingVersion) {
+    throw InputFileError{
+        std::format("{} is not an input recording", path.string())};
+  }
+}
+
+auto InputReplay::nextTick() -> bool {
+  const auto deltaTime = readValue<Uint32>(file_);
+  if (!file_) {
+    return false;
+  }
+  deltaTime_ = deltaTime;
+  mouse_.x = readValue<float>(file_);
+  mouse_.y = readValue<float>(file_);
+
+  const auto changedKeys = readValue<Uint16>(file_);
+  for (Uint16 index = 0; index < changedKeys; ++index) {
+    const auto scancode = readValue<Uint16>(file_);
+    if (scancode < keys_.size()) {
+      keys_[scancode] = !keys_[scancode];
+    }
+  }
+
+  events_.resize(readValue<Uint16>(file_));
+  for (auto &event : events_) {
+    event.type = readValue<Uint32>(file_);
+    event.key = readValue<Uint32>(file_);
+    event.scancode = readValue<Uint16>(file_);
+    event.mod = readValue<Uint16>(file_);
+    event.x = readValue<float>(file_);
+    event.y = readValue<float>(file_);
+    event.down = readValue<Uint8>(file_) != 0;
+    event.text.clear();
+    if (event.type == SDL_EVENT_TEXT_INPUT) {
+      event.text.resize(readValue<Uint16>(file_));
+      file_.read(event.text.data(),
+                 static_cast<std::streamsize>(event.text.size()));
+    }
+  }
+  nextEvent_ = 0;
+
+  if (!file_) {
+    return false;
+  }
+  ++tick_;
+  return true;
+}
+
+auto InputReplay::pollEvent(SDL_Event &event, SDL_WindowID windowId) -> bool {
+  if (nextEvent_ == events_.size()) {
+    return false;
+  }
+  event = toSdlEvent(events_[nextEvent_++], windowId);
+  return true;
+}
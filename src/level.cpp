@@ -0,0 +1,599 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <istream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+export module level;
+
+import tile;
+import tileOrder;
+import memory;
+import tileTypes;
+
+/// the records of a layer, accounted to the level io
+export using TileRecords = TrackedVector<TileRecord, MemoryTag::LevelIo>;
+/// the bytes of a compact level, accounted to the level io
+export using LevelBytes = TrackedVector<std::uint8_t, MemoryTag::LevelIo>;
+
+/// copy of every placed tile of a level
+///
+/// taken on the main thread and handed to the LevelSaver, so the map can keep
+/// being edited while the snapshot is written
+export struct LevelSnapshot {
+  /// take a snapshot of the floor and wall layers
+  ///
+  /// \param[in] Map the floor layer
+  /// \param[in] MapWall the wall layer
+  static auto capture(const std::vector<std::unique_ptr<TileConcrete>> &map,
+                      const std::vector<std::unique_ptr<TileConcrete>> &mapWall)
+      -> LevelSnapshot;
+
+  /// the number of tiles in the snapshot
+  [[nodiscard]] auto size() const noexcept -> size_t {
+    return floor.size() + walls.size();
+  }
+
+  TileRecords floor; ///< the floor layer
+  TileRecords walls; ///< the wall layer
+};
+
+auto LevelSnapshot::capture(
+    const std::vector<std::unique_ptr<TileConcrete>> &map,
+    const std::vector<std::unique_ptr<TileConcrete>> &mapWall)
+    -> LevelSnapshot {
+  LevelSnapshot snapshot;
+  snapshot.floor.reserve(map.size());
+  for (const auto &tile : map) {
+    snapshot.floor.push_back(tile->record());
+  }
+  snapshot.walls.reserve(mapWall.size());
+  for (const auto &tile : mapWall) {
+    snapshot.walls.push_back(tile->record());
+  }
+  return snapshot;
+}
+
+/// the first bytes of a level in the compact format
+inline constexpr std::array<char, 4> compactMagic{'L', 'V', 'L', 'Z'};
+
+/// the most tiles a compact level may decode to, 4096 by 4096 cells
+inline constexpr std::uint64_t maxCompactTiles{std::uint64_t{1} << 24};
+
+/// the largest coordinate of a tile in a compact level, in world units
+inline constexpr std::int64_t maxCompactCoordinate{std::int64_t{1} << 30};
+
+/// append an unsigned integer 7 bits per byte, the high bit set on every
+/// byte but the last
+auto writeVarint(LevelBytes &bytes, std::uint64_t value) -> void {
+  constexpr std::uint64_t groupMask{0x7F};
+  constexpr std::uint8_t continued{0x80};
+  while (value > groupMask) {
+    bytes.push_back(static_cast<std::uint8_t>(value & groupMask) | continued);
+    value >>= 7U;
+  }
+  bytes.push_back(static_cast<std::uint8_t>(value));
+}
+
+/// append a signed integer, zigzag mapped so small magnitudes stay short
+auto writeSigned(LevelBytes &bytes, std::int64_t value) -> void {
+  writeVarint(bytes, (static_cast<std::uint64_t>(value) << 1U) ^
+                         static_cast<std::uint64_t>(value >> 63U));
+}
+
+/// read the integers written by writeVarint and writeSigned
+class ByteReader {
+public:
+  explicit ByteReader(std::span<const std::uint8_t> bytes) : bytes_{bytes} {}
+
+  /// \return the integer, nullopt if the bytes end first or it overflows
+  auto varint() noexcept -> std::optional<std::uint64_t> {
+    constexpr unsigned maxShift{63};
+    std::uint64_t value{};
+    for (unsigned shift = 0; next_ < bytes_.size() && shift <= maxShift;
+         shift += 7) {
+      const auto byte = bytes_[next_++];
+      value |= static_cast<std::uint64_t>(byte & 0x7FU) << shift;
+      if ((byte & 0x80U) == 0) {
+        return value;
+      }
+    }
+    return std::nullopt;
+  }
+
+  auto signedVarint() noexcept -> std::optional<std::int64_t> {
+    const auto value = varint();
+    if (!value) {
+      return std::nullopt;
+    }
+    return static_cast<std::int64_t>(*value >> 1U) ^
+           -static_cast<std::int64_t>(*value & 1U);
+  }
+
+  [[nodiscard]] auto remaining() const noexcept -> size_t {
+    return bytes_.size() - next_;
+  }
+
+private:
+  std::span<const std::uint8_t> bytes_;
+  size_t next_{};
+};
+
+/// a position of a tile in grid units
+struct Cell {
+  std::int64_t column;
+  std::int64_t row;
+};
+
+/// append a layer as runs of identical tiles in consecutive cells of a row
+///
+/// each run is written as the delta of its row with the row of the previous
+/// run, the delta of its first column with the end of the previous run of the
+/// row, the tile type and level packed together and the run length
+auto encodeLayer(LevelBytes &bytes, std::span<const TileRecord> tiles,
+                 std::int64_t unit) -> void {
+  struct Entry {
+    Cell cell;
+    std::uint64_t tile;
+  };
+  TrackedVector<Entry, MemoryTag::LevelIo> entries;
+  entries.reserve(tiles.size());
+  for (const auto &record : tiles) {
+    entries.push_back(
+        {.cell = {.column = static_cast<std::int64_t>(record.pos.x) / unit,
+                  .row = static_cast<std::int64_t>(record.pos.y) / unit},
+         .tile = (std::uint64_t{record.typeId} << 1U) |
+                 (record.level ? 1U : 0U)});
+  }
+  std::ranges::stable_sort(entries, [](const Entry &lhs, const Entry &rhs) {
+    return lhs.cell.row != rhs.cell.row ? lhs.cell.row < rhs.cell.row
+                                        : lhs.cell.column < rhs.cell.column;
+  });
+
+  // the runs are counted first, their number leads the layer
+  LevelBytes runs;
+  std::uint64_t runCount{};
+  std::int64_t previousRow{};
+  std::int64_t previousEnd{};
+  for (size_t first = 0; first < entries.size();) {
+    auto last = first + 1;
+    while (last < entries.size() &&
+           entries[last].cell.row == entries[first].cell.row &&
+           entries[last].cell.column ==
+               entries[first].cell.column +
+                   static_cast<std::int64_t>(last - first) &&
+           entries[last].tile == entries[first].tile) {
+      ++last;
+    }
+
+    const auto &cell = entries[first].cell;
+    if (cell.row != previousRow) {
+      previousEnd = 0;
+    }
+    writeSigned(runs, cell.row - previousRow);
+    writeSigned(runs, cell.column - previousEnd);
+    writeVarint(runs, entries[first].tile);
+    writeVarint(runs, last - first - 1);
+    previousRow = cell.row;
+    previousEnd = cell.column + static_cast<std::int64_t>(last - first);
+    ++runCount;
+    first = last;
+  }
+
+  writeVarint(bytes, runCount);
+  bytes.insert(bytes.end(), runs.begin(), runs.end());
+}
+
+/// read a layer written by encodeLayer
+///
+/// \return false if the bytes are not a valid layer
+auto decodeLayer(ByteReader &reader, TileRecords &tiles,
+                 std::int64_t unit, std::uint64_t &tileCount) -> bool {
+  const auto runCount = reader.varint();
+  // a run takes at least four bytes
+  if (!runCount || *runCount > reader.remaining() / 4) {
+    return false;
+  }
+
+  // the cells stay within the coordinates encodeLevel accepts, so the sums
+  // and the products by the unit below cannot overflow
+  const auto maxCell = maxCompactCoordinate / unit;
+  const auto inRange = [](std::int64_t value, std::int64_t bound) {
+    return value >= -bound && value <= bound;
+  };
+
+  std::int64_t row{};
+  std::int64_t end{};
+  for (std::uint64_t run = 0; run < *runCount; ++run) {
+    const auto rowDelta = reader.signedVarint();
+    const auto columnDelta = reader.signedVarint();
+    const auto tile = reader.varint();
+    const auto extra = reader.varint();
+    if (!rowDelta || !columnDelta || !tile || !extra ||
+        (*tile >> 1U) >= tileTypes.size() ||
+        *extra >= maxCompactTiles - tileCount ||
+        !inRange(*rowDelta, 2 * maxCell) ||
+        !inRange(*columnDelta, 2 * maxCell)) {
+      return false;
+    }
+    tileCount += *extra + 1;
+
+    if (*rowDelta != 0) {
+      end = 0;
+    }
+    row += *rowDelta;
+    const auto column = end + *columnDelta;
+    if (!inRange(row, maxCell) || !inRange(column, maxCell) ||
+        !inRange(column + static_cast<std::int64_t>(*extra), maxCell)) {
+      return false;
+    }
+    const auto typeId = static_cast<TileTypeId>(*tile >> 1U);
+    const bool level = (*tile & 1U) != 0;
+    for (std::uint64_t index = 0; index <= *extra; ++index) {
+      tiles.push_back(
+          {.typeId = typeId,
+           .pos = {static_cast<float>(
+                       (column + static_cast<std::int64_t>(index)) * unit),
+                   static_cast<float>(row * unit)},
+           .level = level});
+    }
+    end = column + static_cast<std::int64_t>(*extra) + 1;
+  }
+  return true;
+}
+
+/// encode a level in the compact format
+///
+/// the positions are stored in cells of the largest size dividing every
+/// coordinate, the tiles of a layer come back ordered by row then column
+///
+/// \return the bytes, nullopt if a coordinate is not an integer
+export auto encodeLevel(const LevelSnapshot &snapshot)
+    -> std::optional<LevelBytes> {
+  constexpr auto maxCoordinate = static_cast<float>(maxCompactCoordinate);
+  std::int64_t unit{};
+  for (const auto *layer : {&snapshot.floor, &snapshot.walls}) {
+    for (const auto &record : *layer) {
+      for (const auto coordinate : {record.pos.x, record.pos.y}) {
+        if (std::trunc(coordinate) != coordinate ||
+            std::abs(coordinate) > maxCoordinate) {
+          return std::nullopt;
+        }
+        unit = std::gcd(unit, static_cast<std::int64_t>(coordinate));
+      }
+    }
+  }
+  unit = std::max(unit, std::int64_t{1});
+
+  LevelBytes bytes(compactMagic.begin(), compactMagic.end());
+  writeVarint(bytes, static_cast<std::uint64_t>(unit));
+  encodeLayer(bytes, snapshot.floor, unit);
+  encodeLayer(bytes, snapshot.walls, unit);
+  return bytes;
+}
+
+/// decode a level in the compact format
+///
+/// \return the level, nullopt if the bytes are not a valid compact level
+export auto decodeLevel(std::span<const std::uint8_t> bytes)
+    -> std::optional<LevelSnapshot> {
+  if (bytes.size() < compactMagic.size() ||
+      !std::ranges::equal(bytes.first(compactMagic.size()), compactMagic)) {
+    return std::nullopt;
+  }
+
+  constexpr std::uint64_t maxUnit{1 << 30};
+  ByteReader reader{bytes.subspan(compactMagic.size())};
+  const auto unit = reader.varint();
+  if (!unit || *unit == 0 || *unit > maxUnit) {
+    return std::nullopt;
+  }
+
+  LevelSnapshot snapshot;
+  std::uint64_t tileCount{};
+  const auto signedUnit = static_cast<std::int64_t>(*unit);
+  if (!decodeLayer(reader, snapshot.floor, signedUnit, tileCount) ||
+      !decodeLayer(reader, snapshot.walls, signedUnit, tileCount)) {
+    return std::nullopt;
+  }
+  return snapshot;
+}
+
+/// build the tiles of a layer in the order of their keys
+///
+/// the tiles are allocated in that order too, so walking the layer mostly
+/// walks the memory forward
+auto buildLayer(const TileRecords &records,
+                std::vector<std::unique_ptr<TileConcrete>> &layer) -> void {
+  std::vector<std::pair<std::uint64_t, const TileRecord *>> keyed;
+  keyed.reserve(records.size());
+  for (const auto &record : records) {
+    keyed.emplace_back(mortonKey(orderCell(record.pos)), &record);
+  }
+  std::ranges::stable_sort(keyed, {}, [](const auto &entry) {
+    return entry.first;
+  });
+
+  layer.clear();
+  layer.reserve(keyed.size());
+  for (const auto &[key, record] : keyed) {
+    layer.push_back(
+        RendererBuilder{record->typeId}.build(record->pos, record->level));
+  }
+}
+
+/// build the tiles of a snapshot, each layer in the order of tileOrder
+///
+/// \param[in] Snapshot the records of the tiles
+/// \param[out] Map the floor layer, cleared first
+/// \param[out] MapWall the wall layer, cleared first
+export auto buildLevel(const LevelSnapshot &snapshot,
+                       std::vector<std::unique_ptr<TileConcrete>> &map,
+                       std::vector<std::unique_ptr<TileConcrete>> &mapWall)
+    -> void {
+  buildLayer(snapshot.floor, map);
+  buildLayer(snapshot.walls, mapWall);
+}
+
+/// read a level in the text or the compact format written by LevelSaver
+///
+/// the failbit of the stream is set if a compact level is invalid. Each
+/// layer is in the order of tileOrder
+///
+/// \param[in] Istream the stream to read the level from
+/// \param[out] Map the floor layer, cleared first
+/// \param[out] MapWall the wall layer, cleared first
+export auto readLevel(std::istream &istream,
+                      std::vector<std::unique_ptr<TileConcrete>> &map,
+                      std::vector<std::unique_ptr<TileConcrete>> &mapWall)
+    -> void {
+  map.clear();
+  mapWall.clear();
+
+  const auto start = istream.tellg();
+  std::array<char, compactMagic.size()> magic{};
+  istream.read(magic.data(), magic.size());
+  if (istream && magic == compactMagic) {
+    LevelBytes bytes(compactMagic.begin(), compactMagic.end());
+    bytes.insert(bytes.end(), std::istreambuf_iterator<char>{istream},
+                 std::istreambuf_iterator<char>{});
+    const auto snapshot = decodeLevel(bytes);
+    if (!snapshot) {
+      istream.setstate(std::ios_base::failbit);
+      return;
+    }
+    buildLevel(*snapshot, map, mapWall);
+    return;
+  }
+  istream.clear();
+  istream.seekg(start);
+
+  while (!istream.eof()) {
+    RendererBuilder builder;
+    istream >> builder;
+    istream.ignore();
+    if (istream.good()) {
+      map.push_back(builder.build());
+    } else {
+      break;
+    }
+  }
+  istream.clear();
+  istream.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  while (!istream.eof()) {
+    RendererBuilder builder;
+    istream >> builder;
+    istream.ignore();
+    if (istream.good()) {
+      mapWall.push_back(builder.build());
+    } else {
+      istream.clear();
+      istream.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+  }
+  sortTiles(map);
+  sortTiles(mapWall);
+}
+
+/// how a LevelSaver writes the levels
+export enum class LevelFormat : std::uint8_t {
+  /// one line of text per tile
+  Text,
+  /// the runs of encodeLevel, the text format is used when it cannot encode
+  Compact
+};
+
+/// state of the last save requested to a LevelSaver
+export enum class SaveState { Idle, Saving, Done, Failed };
+
+/// write level snapshots to disk on a background thread
+///
+/// the level is first written to 'path.tmp' and then renamed to 'path', so a
+/// crash during the save never leaves a truncated level behind
+export class LevelSaver {
+public:
+  /// constructor
+  ///
+  /// \param[in] Format how the levels are written
+  explicit LevelSaver(LevelFormat format = LevelFormat::Compact);
+
+  LevelSaver(const LevelSaver &) = delete;
+  LevelSaver(LevelSaver &&) = delete;
+  auto operator=(const LevelSaver &) -> LevelSaver & = delete;
+  auto operator=(LevelSaver &&) -> LevelSaver & = delete;
+
+  ~LevelSaver() = default;
+
+  /// queue a snapshot to be written
+  ///
+  /// a snapshot still waiting to be written is replaced by the new one
+  ///
+  /// \param[in] Snapshot the level to write
+  /// \param[in] Path the file to write the level to
+  auto save(LevelSnapshot snapshot, std::filesystem::path path) -> void;
+
+  /// get the state of the last save
+  [[nodiscard]] auto state() const noexcept -> SaveState {
+    return state_.load(std::memory_order_acquire);
+  }
+
+  /// get the progress of the current save between 0 and 1
+  [[nodiscard]] auto progress() const noexcept -> float;
+
+  /// get the error message of the last failed save
+  [[nodiscard]] auto lastError() const -> std::string;
+
+private:
+  /// the saver thread main loop
+  auto run(const std::stop_token &stopToken) -> void;
+
+  /// write a snapshot to path
+  ///
+  /// \return an empty string on success, the error message otherwise
+  auto write(const LevelSnapshot &snapshot, const std::filesystem::path &path)
+      -> std::string;
+
+  mutable std::mutex mutex_;
+  std::condition_variable_any pendingCondition_;
+  /// the next snapshot to write, guarded by mutex_
+  std::optional<std::pair<LevelSnapshot, std::filesystem::path>> pending_;
+  /// the error message of the last failed save, guarded by mutex_
+  std::string error_;
+
+  LevelFormat format_;
+  std::atomic<SaveState> state_{SaveState::Idle};
+  std::atomic<size_t> written_;
+  std::atomic<size_t> total_;
+
+  /// declared last so it is joined before the other members are destroyed
+  std::jthread worker_;
+};
+
+LevelSaver::LevelSaver(LevelFormat format)
+    : format_{format},
+      worker_{[this](const std::stop_token &stopToken) { run(stopToken); }} {}
+
+auto LevelSaver::save(LevelSnapshot snapshot, std::filesystem::path path)
+    -> void {
+  {
+    // stored before the job is queued, so the worker's Done or Failed for it
+    // always comes after
+    const std::scoped_lock lock{mutex_};
+    state_.store(SaveState::Saving, std::memory_order_release);
+    pending_.emplace(std::move(snapshot), std::move(path));
+  }
+  pendingCondition_.notify_one();
+}
+
+auto LevelSaver::progress() const noexcept -> float {
+  const auto total = total_.load(std::memory_order_relaxed);
+  if (total == 0) {
+    return 0;
+  }
+  return static_cast<float>(written_.load(std::memory_order_relaxed)) /
+         static_cast<float>(total);
+}
+
+auto LevelSaver::lastError() const -> std::string {
+  const std::scoped_lock lock{mutex_};
+  return error_;
+}
+
+auto LevelSaver::run(const std::stop_token &stopToken) -> void {
+  while (!stopToken.stop_requested()) {
+    std::pair<LevelSnapshot, std::filesystem::path> job;
+    {
+      std::unique_lock lock{mutex_};
+      if (!pendingCondition_.wait(lock, stopToken,
+                                  [this] { return pending_.has_value(); })) {
+        return;
+      }
+      job = std::move(*pending_);
+      pending_.reset();
+    }
+
+    auto error = write(job.first, job.second);
+
+    const std::scoped_lock lock{mutex_};
+    if (pending_) {
+      // a newer snapshot was queued while writing, keep reporting Saving
+      continue;
+    }
+    if (error.empty()) {
+      state_.store(SaveState::Done, std::memory_order_release);
+    } else {
+      error_ = std::move(error);
+      state_.store(SaveState::Failed, std::memory_order_release);
+    }
+  }
+}
+
+auto LevelSaver::write(const LevelSnapshot &snapshot,
+                       const std::filesystem::path &path) -> std::string {
+  written_.store(0, std::memory_order_relaxed);
+  total_.store(snapshot.size(), std::memory_order_relaxed);
+
+  auto tmpPath = path;
+  tmpPath += ".tmp";
+
+  {
+    std::ofstream file{tmpPath,
+                       std::ios::out | std::ios::trunc | std::ios::binary};
+    if (!file) {
+      return "could not open " + tmpPath.string();
+    }
+
+    std::optional<LevelBytes> bytes;
+    if (format_ == LevelFormat::Compact) {
+      bytes = encodeLevel(snapshot);
+    }
+    if (bytes) {
+      file.write(reinterpret_cast<const char *>(bytes->data()),
+                 static_cast<std::streamsize>(bytes->size()));
+      written_.store(snapshot.size(), std::memory_order_relaxed);
+    } else {
+      for (const auto &tile : snapshot.floor) {
+        file << tile << '\n';
+        written_.fetch_add(1, std::memory_order_relaxed);
+      }
+      file << "=====\n";
+      for (const auto &tile : snapshot.walls) {
+        file << tile << '\n';
+        written_.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    file.close();
+    if (!file) {
+      return "could not write " + tmpPath.string();
+    }
+  }
+
+  std::error_code errorCode;
+  std::filesystem::rename(tmpPath, path, errorCode);
+  if (errorCode) {
+    return std::format("rename(): {}", errorCode.message());
+  }
+  return {};
+}
@@ -0,0 +1,276 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+export module light;
+
+/// the light level of a cell lit by a source of full intensity
+export inline constexpr std::uint8_t maxLightLevel{15};
+
+/// the offsets of the cells the light spreads to from a cell
+inline constexpr std::array<std::pair<int, int>, 4> neighborOffsets{
+    {{1, 0}, {-1, 0}, {0, 1}, {0, -1}}};
+
+/// handle of a light in a LightMap
+export using LightId = std::uint32_t;
+
+/// a light source
+export struct Light {
+  /// the column of the cell holding the light
+  int x;
+  /// the row of the cell holding the light
+  int y;
+  /// the level of the light cell, it loses one level per cell walked
+  std::uint8_t intensity;
+};
+
+/// light level of every cell of a grid
+///
+/// light spreads from the sources by breadth first search and stops at
+/// opaque cells, which are lit but do not let the light through. A change only
+/// marks the area it can affect, and update recomputes those areas only
+export class LightMap {
+public:
+  /// constructor
+  ///
+  /// \param[in] Width the number of columns
+  /// \param[in] Height the number of rows
+  LightMap(int width, int height);
+
+  /// set whether a cell blocks the light
+  auto setOpaque(int x, int y, bool opaque) -> void;
+
+  /// add a light source
+  ///
+  /// \return the handle of the light
+  auto addLight(const Light &light) -> LightId;
+
+  /// move a light source to another cell
+  auto moveLight(LightId id, int x, int y) -> void;
+
+  /// remove a light source, its handle can be given to a new light
+  auto removeLight(LightId id) -> void;
+
+  /// recompute the areas changed since the last update
+  auto update() -> void;
+
+  /// get the light level of a cell, 0 outside of the grid
+  [[nodiscard]] auto level(int x, int y) const noexcept -> std::uint8_t {
+    if (!contains(x, y)) {
+      return 0;
+    }
+    return levels_[index(x, y)];
+  }
+
+  [[nodiscard]] auto width() const noexcept -> int { return width_; }
+  [[nodiscard]] auto height() const noexcept -> int { return height_; }
+
+private:
+  /// a rectangle of cells, bounds included
+  struct Area {
+    int left;
+    int top;
+    int right;
+    int bottom;
+
+    [[nodiscard]] auto overlaps(const Area &other) const noexcept -> bool {
+      return left <= other.right && other.left <= right &&
+             top <= other.bottom && other.top <= bottom;
+    }
+  };
+
+  /// a cell waiting in the spread queue
+  struct SpreadCell {
+    int x;
+    int y;
+    std::uint8_t level;
+  };
+
+  [[nodiscard]] auto contains(int x, int y) const noexcept -> bool {
+    return x >= 0 && y >= 0 && x < width_ && y < height_;
+  }
+  [[nodiscard]] auto index(int x, int y) const noexcept -> size_t {
+    return (static_cast<size_t>(y) * static_cast<size_t>(width_)) +
+           static_cast<size_t>(x);
+  }
+
+  /// the cells a light can reach
+  [[nodiscard]] static auto reach(const Light &light) noexcept -> Area;
+
+  /// mark an area to be recomputed, merged with the areas it overlaps
+  auto markDirty(Area area) -> void;
+
+  /// clear an area and spread again every light reaching it
+  auto recompute(const Area &area) -> void;
+
+  /// add the light of a source to the cells it reaches
+  auto spread(const Light &light) -> void;
+
+  int width_;
+  int height_;
+  std::vector<std::uint8_t> opaque_;
+  std::vector<std::uint8_t> levels_;
+
+  /// the light sources, removed ones have an intensity of 0
+  std::vector<Light> lights_;
+  std::vector<LightId> freeLights_;
+  std::vector<Area> dirty_;
+
+  /// cells already queued by the current spread are marked with stamp_
+  std::vector<std::uint32_t> visited_;
+  std::uint32_t stamp_{};
+  std::vector<SpreadCell> queue_;
+};
+
+LightMap::LightMap(int width, int height)
+    : width_{width}, height_{height},
+      opaque_(static_cast<size_t>(width) * static_cast<size_t>(height)),
+      levels_(opaque_.size()), visited_(opaque_.size()) {}
+
+auto LightMap::reach(const Light &light) noexcept -> Area {
+  const auto radius = static_cast<int>(light.intensity) - 1;
+  return {.left = light.x - radius,
+          .top = light.y - radius,
+          .right = light.x + radius,
+          .bottom = light.y + radius};
+}
+
+auto LightMap::setOpaque(int x, int y, bool opaque) -> void {
+  if (!contains(x, y) || (opaque_[index(x, y)] != 0) == opaque) {
+    return;
+  }
+  opaque_[index(x, y)] = opaque ? 1 : 0;
+
+  const Area cell{.left = x, .top = y, .right = x, .bottom = y};
+  for (const auto &light : lights_) {
+    if (light.intensity != 0 && reach(light).overlaps(cell)) {
+      markDirty(reach(light));
+    }
+  }
+}
+
+auto LightMap::addLight(const Light &light) -> LightId {
+  LightId id{};
+  if (freeLights_.empty()) {
+    id = static_cast<LightId>(lights_.size());
+    lights_.push_back(light);
+  } else {
+    id = freeLights_.back();
+    freeLights_.pop_back();
+    lights_[id] = light;
+  }
+  markDirty(reach(light));
+  return id;
+}
+
+auto LightMap::moveLight(LightId id, int x, int y) -> void {
+  auto &light = lights_[id];
+  if (light.x == x && light.y == y) {
+    return;
+  }
+  markDirty(reach(light));
+  light.x = x;
+  light.y = y;
+  markDirty(reach(light));
+}
+
+auto LightMap::removeLight(LightId id) -> void {
+  markDirty(reach(lights_[id]));
+  lights_[id].intensity = 0;
+  freeLights_.push_back(id);
+}
+
+auto LightMap::markDirty(Area area) -> void {
+  area.left = std::max(area.left, 0);
+  area.top = std::max(area.top, 0);
+  area.right = std::min(area.right, width_ - 1);
+  area.bottom = std::min(area.bottom, height_ - 1);
+  if (area.left > area.right || area.top > area.bottom) {
+    return;
+  }
+
+  // merging can make the area overlap areas it did not before, so merge
+  // until it overlaps none of them
+  for (auto merged = true; merged;) {
+    merged = false;
+    for (auto iter = dirty_.begin(); iter != dirty_.end(); ++iter) {
+      if (iter->overlaps(area)) {
+        area = {.left = std::min(area.left, iter->left),
+                .top = std::min(area.top, iter->top),
+                .right = std::max(area.right, iter->right),
+                .bottom = std::max(area.bottom, iter->bottom)};
+        dirty_.erase(iter);
+        merged = true;
+        break;
+      }
+    }
+  }
+  dirty_.push_back(area);
+}
+
+auto LightMap::update() -> void {
+  for (const auto &area : dirty_) {
+    recompute(area);
+  }
+  dirty_.clear();
+}
+
+auto LightMap::recompute(const Area &area) -> void {
+  for (auto row = area.top; row <= area.bottom; ++row) {
+    std::fill_n(levels_.begin() +
+                    static_cast<std::ptrdiff_t>(index(area.left, row)),
+                area.right - area.left + 1, std::uint8_t{0});
+  }
+
+  // a light spreads to every cell it reaches, the cells out of the area get
+  // the level they already had
+  for (const auto &light : lights_) {
+    if (light.intensity != 0 && reach(light).overlaps(area)) {
+      spread(light);
+    }
+  }
+}
+
+auto LightMap::spread(const Light &light) -> void {
+  if (!contains(light.x, light.y)) {
+    return;
+  }
+  if (++stamp_ == 0) {
+    std::ranges::fill(visited_, 0);
+    stamp_ = 1;
+  }
+
+  queue_.clear();
+  queue_.push_back({light.x, light.y, light.intensity});
+  visited_[index(light.x, light.y)] = stamp_;
+
+  for (size_t head = 0; head < queue_.size(); ++head) {
+    const auto cell = queue_[head];
+    const auto cellIndex = index(cell.x, cell.y);
+    levels_[cellIndex] = std::max(levels_[cellIndex], cell.level);
+
+    const bool isSource = cell.x == light.x && cell.y == light.y;
+    if (cell.level <= 1 || (opaque_[cellIndex] != 0 && !isSource)) {
+      continue;
+    }
+
+    const auto next = static_cast<std::uint8_t>(cell.level - 1);
+    for (const auto &[offsetX, offsetY] : neighborOffsets) {
+      const auto neighborX = cell.x + offsetX;
+      const auto neighborY = cell.y + offsetY;
+      if (!contains(neighborX, neighborY)) {
+        continue;
+      }
+      auto &visited = visited_[index(neighborX, neighborY)];
+      if (visited != stamp_) {
+        visited = stamp_;
+        queue_.push_back({neighborX, neighborY, next});
+      }
+    }
+  }
+}
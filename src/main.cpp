@@ -1,7 +1,14 @@
+#include <cstddef>
+#include <span>
+
 import game;
 
-auto main(int  /*argc*/, char * /*argv*/[]) -> int {
-  Game gameInstance;
+auto main(int argc, char *argv[]) -> int {
+  const auto options =
+      GameOptions::fromArgs({argv, static_cast<size_t>(argc)});
+  options.applyHints();
+
+  Game gameInstance{options};
 
   while (!gameInstance.done()) {
     gameInstance.frame();
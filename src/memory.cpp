@@ -0,0 +1,217 @@
+module;
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+export module memory;
+
+/// the subsystems the memory is accounted to
+export enum class MemoryTag : std::uint8_t {
+  Tiles,
+  Sprites,
+  /// the textures on the renderer, counted from their size and format
+  Textures,
+  Gui,
+  /// the level snapshots and the buffers of the level formats
+  LevelIo,
+};
+
+export inline constexpr size_t memoryTagCount{5};
+
+export constexpr auto memoryTagName(MemoryTag tag) noexcept
+    -> std::string_view {
+  constexpr std::array<std::string_view, memoryTagCount> names{
+      "tiles", "sprites", "textures", "gui", "level io"};
+  return names[std::to_underlying(tag)];
+}
+
+/// the memory accounted to a tag since the start
+export struct MemoryUsage {
+  /// the bytes allocated and not released
+  size_t live;
+  /// the most bytes live at once
+  size_t peak;
+  /// the bytes ever allocated
+  size_t allocated;
+  /// the number of allocations
+  size_t allocations;
+};
+
+/// the counters of a tag, updated from any thread
+struct MemoryCounters {
+  std::atomic<size_t> live;
+  std::atomic<size_t> peak;
+  std::atomic<size_t> allocated;
+  std::atomic<size_t> allocations;
+};
+
+auto memoryCounters() noexcept -> std::array<MemoryCounters, memoryTagCount> & {
+  static std::array<MemoryCounters, memoryTagCount> counters{};
+  return counters;
+}
+
+/// account an allocation to a tag
+export auto trackAllocation(MemoryTag tag, size_t bytes) noexcept -> void {
+  auto &counters = memoryCounters()[std::to_underlying(tag)];
+  const auto live =
+      counters.live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  counters.allocated.fetch_add(bytes, std::memory_order_relaxed);
+  counters.allocations.fetch_add(1, std::memory_order_relaxed);
+  auto peak = counters.peak.load(std::memory_order_relaxed);
+  while (live > peak && !counters.peak.compare_exchange_weak(
+                            peak, live, std::memory_order_relaxed)) {
+  }
+}
+
+/// account the release of an allocation to a tag
+export auto trackDeallocation(MemoryTag tag, size_t bytes) noexcept -> void {
+  memoryCounters()[std::to_underlying(tag)].live.fetch_sub(
+      bytes, std::memory_order_relaxed);
+}
+
+/// get the memory accounted to a tag
+export auto memoryUsage(MemoryTag tag) noexcept -> MemoryUsage {
+  const auto &counters = memoryCounters()[std::to_underlying(tag)];
+  return {.live = counters.live.load(std::memory_order_relaxed),
+          .peak = counters.peak.load(std::memory_order_relaxed),
+          .allocated = counters.allocated.load(std::memory_order_relaxed),
+          .allocations = counters.allocations.load(std::memory_order_relaxed)};
+}
+
+/// format a number of bytes with a binary unit, as '1.5 MiB'
+export auto formatBytes(double bytes) -> std::string {
+  constexpr std::array<std::string_view, 4> units{"B", "KiB", "MiB", "GiB"};
+  constexpr double step{1024};
+  size_t unit{};
+  while (bytes >= step && unit + 1 < units.size()) {
+    bytes /= step;
+    ++unit;
+  }
+  return std::format("{:.1f} {}", bytes, units[unit]);
+}
+
+/// set the peak of every tag to its live bytes, to measure the peak of a
+/// phase
+export auto resetMemoryPeaks() noexcept -> void {
+  for (auto &counters : memoryCounters()) {
+    counters.peak.store(counters.live.load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+  }
+}
+
+/// an allocator accounting its memory to a tag
+///
+/// \tparam Type the type allocated
+/// \tparam Tag the tag the memory is accounted to
+export template <class Type, MemoryTag Tag> class TrackedAllocator {
+public:
+  using value_type = Type;
+  /// the tag is not a type, so the rebind is not deduced
+  template <class Other> struct rebind {
+    using other = TrackedAllocator<Other, Tag>;
+  };
+
+  TrackedAllocator() noexcept = default;
+  /// the rebound allocators of the containers
+  template <class Other>
+  TrackedAllocator(const TrackedAllocator<Other, Tag> & /*other*/) noexcept {}
+
+  [[nodiscard]] auto allocate(size_t count) -> Type * {
+    auto *const pointer = std::allocator<Type>{}.allocate(count);
+    trackAllocation(Tag, count * sizeof(Type));
+    return pointer;
+  }
+
+  auto deallocate(Type *pointer, size_t count) noexcept -> void {
+    trackDeallocation(Tag, count * sizeof(Type));
+    std::allocator<Type>{}.deallocate(pointer, count);
+  }
+
+  template <class Other>
+  auto operator==(const TrackedAllocator<Other, Tag> & /*other*/)
+      const noexcept -> bool {
+    return true;
+  }
+};
+
+/// a vector whose memory is accounted to a tag
+export template <class Type, MemoryTag Tag>
+using TrackedVector = std::vector<Type, TrackedAllocator<Type, Tag>>;
+
+/// a base accounting the objects allocated with new to a tag
+///
+/// the objects deleted through a base pointer need a virtual destructor, so
+/// the size of their dynamic type is released
+///
+/// \tparam Tag the tag the objects are accounted to
+export template <MemoryTag Tag> class Tracked {
+public:
+  static auto operator new(size_t size) -> void * {
+    auto *const pointer = ::operator new(size);
+    trackAllocation(Tag, size);
+    return pointer;
+  }
+
+  static auto operator delete(void *pointer, size_t size) noexcept -> void {
+    trackDeallocation(Tag, size);
+    ::operator delete(pointer, size);
+  }
+};
+
+/// measures the allocation rate of every tag
+///
+/// the rate is the bytes allocated between two samples at least a period
+/// apart, so it stays readable when sampled every frame
+export class MemoryMeter {
+public:
+  /// constructor
+  ///
+  /// \param[in] Period the shortest time between two measures in ms
+  explicit MemoryMeter(std::uint64_t period) noexcept : period_{period} {}
+
+  /// take a sample of the counters
+  ///
+  /// \param[in] Now the time of the sample in ms
+  auto sample(std::uint64_t now) noexcept -> void;
+
+  /// the bytes allocated per second between the last two measures
+  [[nodiscard]] auto rate(MemoryTag tag) const noexcept -> double {
+    return rates_[std::to_underlying(tag)];
+  }
+
+private:
+  std::uint64_t period_;
+  std::uint64_t last_{};
+  bool sampled_{};
+  std::array<size_t, memoryTagCount> allocated_{};
+  std::array<double, memoryTagCount> rates_{};
+};
+
+auto MemoryMeter::sample(std::uint64_t now) noexcept -> void {
+  if (sampled_ && now - last_ < period_) {
+    return;
+  }
+
+  constexpr double msPerSecond{1000};
+  const auto elapsed = static_cast<double>(now - last_);
+  for (size_t index = 0; index < memoryTagCount; ++index) {
+    const auto allocated =
+        memoryUsage(static_cast<MemoryTag>(index)).allocated;
+    if (sampled_ && elapsed > 0) {
+      rates_[index] = static_cast<double>(allocated - allocated_[index]) *
+                      msPerSecond / elapsed;
+    }
+    allocated_[index] = allocated;
+  }
+  last_ = now;
+  sampled_ = true;
+}
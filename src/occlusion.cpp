@@ -0,0 +1,224 @@
+module;
+
+#include "SDL3/SDL_pixels.h"
+#include "SDL3/SDL_rect.h"
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+export module occlusion;
+
+import drawList;
+import image;
+import tileTypes;
+
+/// whether each tile type hides what is drawn under it, indexed by id
+export using OpacityTable = std::bitset<tileTypes.size()>;
+
+/// find the tile types whose sprites are fully opaque
+///
+/// a type is opaque when every pixel of every frame of its sprite has a full
+/// alpha, so whatever it is drawn over never shows. The frames out of the
+/// atlas make their type transparent
+///
+/// \param[in] Atlas the texture atlas
+/// \param[in] Rects the source rect of every tile type
+/// \return the opaque types
+export auto findOpaqueTypes(const Image &atlas, const SourceRects &rects)
+    -> OpacityTable {
+  constexpr std::uint8_t opaque{255};
+  const auto isOpaque = [&atlas](int left, int top, int width, int height) {
+    if (left < 0 || top < 0 || width <= 0 || height <= 0 ||
+        left + width > atlas.width || top + height > atlas.height) {
+      return false;
+    }
+    for (auto row = top; row < top + height; ++row) {
+      const auto first = atlas.pixels.begin() +
+                         (static_cast<std::ptrdiff_t>(row) * atlas.width) +
+                         left;
+      if (!std::all_of(first, first + width, [](const SDL_Color &pixel) {
+            return pixel.a == opaque;
+          })) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  OpacityTable table;
+  for (TileTypeId typeId = 0; typeId < tileTypes.size(); ++typeId) {
+    const auto &type = tileType(typeId);
+    const auto &rect = rects[typeId];
+    const auto frames = type.idleFrames + type.runFrames + type.hitFrames;
+    const auto left = static_cast<int>(rect.x);
+    const auto top = static_cast<int>(rect.y);
+    const auto width = static_cast<int>(rect.w);
+    const auto height = static_cast<int>(rect.h);
+
+    bool opaqueType{true};
+    for (auto frame = 0; opaqueType && frame < frames; ++frame) {
+      opaqueType = isOpaque(left + (frame * width), top, width, height);
+    }
+    table[typeId] = opaqueType;
+  }
+  return table;
+}
+
+/// the grid cells hidden by the opaque sprites drawn over them
+///
+/// the sprites are given front to back: a sprite is hidden when every cell it
+/// touches is already covered, and an opaque sprite covers the cells it fully
+/// contains. Out of the grid nothing is covered
+export class OcclusionGrid {
+public:
+  /// constructor
+  ///
+  /// \param[in] Cells the number of cells of the grid
+  /// \param[in] CellSize the side of a cell in world units
+  OcclusionGrid(const SDL_Point &cells, float cellSize)
+      : cells_{cells}, cellSize_{cellSize},
+        covered_(static_cast<size_t>(cells.x) * static_cast<size_t>(cells.y)) {}
+
+  /// uncover every cell, before the sprites of a frame
+  auto clear() -> void { covered_.assign(covered_.size(), false); }
+
+  /// cover the cells fully inside an opaque area
+  ///
+  /// \param[in] Rect the area in world units
+  auto cover(const SDL_FRect &rect) -> void;
+
+  /// whether every cell an area touches is covered
+  ///
+  /// \param[in] Rect the area in world units
+  [[nodiscard]] auto isCovered(const SDL_FRect &rect) const -> bool;
+
+private:
+  SDL_Point cells_;
+  float cellSize_;
+  std::vector<bool> covered_;
+};
+
+auto OcclusionGrid::cover(const SDL_FRect &rect) -> void {
+  const auto left =
+      std::max(static_cast<int>(std::ceil(rect.x / cellSize_)), 0);
+  const auto top =
+      std::max(static_cast<int>(std::ceil(rect.y / cellSize_)), 0);
+  const auto right = std::min(
+      static_cast<int>(std::floor((rect.x + rect.w) / cellSize_)), cells_.x);
+  const auto bottom = std::min(
+      static_cast<int>(std::floor((rect.y + rect.h) / cellSize_)), cells_.y);
+  for (auto row = top; row < bottom; ++row) {
+    for (auto column = left; column < right; ++column) {
+      covered_[(static_cast<size_t>(row) * static_cast<size_t>(cells_.x)) +
+               static_cast<size_t>(column)] = true;
+    }
+  }
+}
+
+auto OcclusionGrid::isCovered(const SDL_FRect &rect) const -> bool {
+  const auto left = static_cast<int>(std::floor(rect.x / cellSize_));
+  const auto top = static_cast<int>(std::floor(rect.y / cellSize_));
+  const auto right = static_cast<int>(std::ceil((rect.x + rect.w) / cellSize_));
+  const auto bottom =
+      static_cast<int>(std::ceil((rect.y + rect.h) / cellSize_));
+  if (left < 0 || top < 0 || right > cells_.x || bottom > cells_.y ||
+      left >= right || top >= bottom) {
+    return false;
+  }
+  for (auto row = top; row < bottom; ++row) {
+    for (auto column = left; column < right; ++column) {
+      if (!covered_[(static_cast<size_t>(row) * static_cast<size_t>(cells_.x)) +
+                    static_cast<size_t>(column)]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/// the number of sprites drawn and culled in a frame
+export struct OcclusionStats {
+  size_t drawn;
+  size_t culled;
+};
+
+/// the number of times each pixel of the screen is filled by a draw list
+///
+/// the sprites and quads fill their whole area whatever their alpha, as the
+/// renderer does, so the total is the fill rate of the frame
+export class OverdrawMap {
+public:
+  /// count the fills of every pixel of a draw list
+  ///
+  /// \param[in] DrawList the commands of a frame
+  /// \param[in] Size the size of the screen
+  auto count(const DrawList &drawList, const SDL_Point &size) -> void;
+
+  /// the fills of every pixel, row by row, saturated at 255
+  [[nodiscard]] auto fills() const noexcept -> std::span<const std::uint8_t> {
+    return fills_;
+  }
+  [[nodiscard]] auto size() const noexcept -> SDL_Point { return size_; }
+
+  /// the number of pixels filled, counting each fill
+  [[nodiscard]] auto filled() const noexcept -> size_t { return filled_; }
+  /// the number of pixels filled at least once
+  [[nodiscard]] auto covered() const noexcept -> size_t { return covered_; }
+
+private:
+  SDL_Point size_{};
+  std::vector<std::uint8_t> fills_;
+  size_t filled_{};
+  size_t covered_{};
+};
+
+auto OverdrawMap::count(const DrawList &drawList, const SDL_Point &size)
+    -> void {
+  size_ = size;
+  fills_.assign(static_cast<size_t>(size.x) * static_cast<size_t>(size.y), 0);
+  filled_ = 0;
+
+  for (const auto &command : drawList.commands()) {
+    if (command.kind == DrawKind::Rect) {
+      continue;
+    }
+    // the pixels whose center is inside the area, as the renderer fills them
+    const auto &dest = command.dest;
+    const auto left = std::max(static_cast<int>(std::round(dest.x)), 0);
+    const auto top = std::max(static_cast<int>(std::round(dest.y)), 0);
+    const auto right =
+        std::min(static_cast<int>(std::round(dest.x + dest.w)), size.x);
+    const auto bottom =
+        std::min(static_cast<int>(std::round(dest.y + dest.h)), size.y);
+    for (auto row = top; row < bottom; ++row) {
+      const auto line = static_cast<size_t>(row) * static_cast<size_t>(size.x);
+      for (auto column = left; column < right; ++column) {
+        auto &fill = fills_[line + static_cast<size_t>(column)];
+        fill = static_cast<std::uint8_t>(std::min(fill + 1, 255));
+      }
+    }
+    filled_ += static_cast<size_t>(std::max(right - left, 0)) *
+               static_cast<size_t>(std::max(bottom - top, 0));
+  }
+
+  covered_ = static_cast<size_t>(std::ranges::count_if(
+      fills_, [](std::uint8_t fill) { return fill > 0; }));
+}
+
+/// the color of a number of fills in the overdraw heatmap
+///
+/// black for none, then blue, green, yellow and red from 4 fills
+export constexpr auto heatColor(std::uint8_t fills) noexcept -> SDL_Color {
+  constexpr std::array<SDL_Color, 5> colors{{{0, 0, 0, 255},
+                                             {40, 60, 200, 255},
+                                             {40, 180, 60, 255},
+                                             {230, 210, 40, 255},
+                                             {220, 40, 30, 255}}};
+  return colors[std::min<size_t>(fills, colors.size() - 1)];
+}
@@ -0,0 +1,185 @@
+module;
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <numeric>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+export module palette;
+
+import tileTypes;
+
+/// an entry of a PaletteIndex
+export struct PaletteEntry {
+  /// index of the entry in the array the palette was built from
+  size_t item;
+  /// the type of the entry
+  TileTypeId typeId;
+  /// index of the entry category in PaletteIndex::categories
+  size_t category;
+};
+
+/// score a fuzzy match of query in name
+///
+/// every character of query has to appear in name in the same order,
+/// consecutive characters and characters starting a word score higher
+///
+/// \return the score or nullopt if query does not match
+export constexpr auto fuzzyScore(std::string_view query, std::string_view name)
+    -> std::optional<int> {
+  constexpr int matchScore{1};
+  constexpr int consecutiveBonus{4};
+  constexpr int wordStartBonus{3};
+
+  int score{};
+  size_t namePos{};
+  size_t lastMatch{std::string_view::npos};
+  for (const auto character : query) {
+    namePos = name.find(character, namePos);
+    if (namePos == std::string_view::npos) {
+      return std::nullopt;
+    }
+    score += matchScore;
+    if (lastMatch != std::string_view::npos && namePos == lastMatch + 1) {
+      score += consecutiveBonus;
+    }
+    if (namePos == 0 || name[namePos - 1] == '_') {
+      score += wordStartBonus;
+    }
+    lastMatch = namePos;
+    ++namePos;
+  }
+  return score;
+}
+
+/// searchable index of the entries of a palette
+///
+/// built once from the palette types, then filtered incrementally: when the
+/// query only grows, only the entries of the previous result are scored again
+export class PaletteIndex {
+public:
+  PaletteIndex() = default;
+
+  /// constructor
+  ///
+  /// \param[in] TypeIds the type of each item of the palette
+  explicit PaletteIndex(std::span<const TileTypeId> typeIds);
+
+  /// select the entries matching a query in a category
+  ///
+  /// \param[in] Query the fuzzy query, in lower case
+  /// \param[in] Category the category index, or nullopt for every category
+  auto filter(std::string_view query, std::optional<size_t> category) -> void;
+
+  /// the indexes in entries of the selected entries, best match first
+  [[nodiscard]] auto results() const noexcept -> std::span<const size_t> {
+    return results_;
+  }
+
+  [[nodiscard]] auto entry(size_t index) const noexcept
+      -> const PaletteEntry & {
+    return entries_[index];
+  }
+
+  /// the category names, sorted
+  [[nodiscard]] auto categories() const noexcept
+      -> std::span<const std::string> {
+    return categories_;
+  }
+
+  /// the number of entries
+  [[nodiscard]] auto size() const noexcept -> size_t {
+    return entries_.size();
+  }
+
+private:
+  /// the category of a type, the first word of its name
+  static auto categoryName(const TileType &type) -> std::string_view;
+
+  /// entries grouped by category, in palette order inside a category
+  std::vector<PaletteEntry> entries_;
+  std::vector<std::string> categories_;
+
+  std::vector<size_t> results_;
+  std::vector<int> scores_;
+  std::string query_;
+  std::optional<size_t> category_;
+};
+
+auto PaletteIndex::categoryName(const TileType &type) -> std::string_view {
+  switch (type.tileClass) {
+  case TileClass::Character:
+    return "character";
+  case TileClass::Enemy:
+    return "enemy";
+  default:
+    return type.name.substr(0, type.name.find('_'));
+  }
+}
+
+PaletteIndex::PaletteIndex(std::span<const TileTypeId> typeIds) {
+  for (const auto typeId : typeIds) {
+    const std::string name{categoryName(tileType(typeId))};
+    if (std::ranges::find(categories_, name) == categories_.end()) {
+      categories_.push_back(name);
+    }
+  }
+  std::ranges::sort(categories_);
+
+  entries_.reserve(typeIds.size());
+  for (size_t item = 0; item < typeIds.size(); ++item) {
+    const auto category = std::ranges::lower_bound(
+        categories_, categoryName(tileType(typeIds[item])));
+    entries_.push_back(
+        {.item = item,
+         .typeId = typeIds[item],
+         .category = static_cast<size_t>(category - categories_.begin())});
+  }
+  std::ranges::stable_sort(entries_, {}, &PaletteEntry::category);
+
+  results_.resize(entries_.size());
+  std::iota(results_.begin(), results_.end(), size_t{0});
+  scores_.resize(entries_.size());
+}
+
+auto PaletteIndex::filter(std::string_view query,
+                          std::optional<size_t> category) -> void {
+  const bool narrowing = category == category_ && query.starts_with(query_);
+  if (narrowing && query.size() == query_.size()) {
+    return;
+  }
+
+  if (!narrowing) {
+    results_.clear();
+    for (size_t index = 0; index < entries_.size(); ++index) {
+      if (!category || entries_[index].category == *category) {
+        results_.push_back(index);
+      }
+    }
+  }
+
+  std::erase_if(results_, [this, query](size_t index) {
+    const auto score = fuzzyScore(query, tileType(entries_[index].typeId).name);
+    if (score) {
+      scores_[index] = *score;
+    }
+    return !score;
+  });
+
+  // entries are grouped by category, keep that order between equal scores:
+  // the previous results are in the order of the previous scores, so the
+  // index breaks the ties rather than the order they are in
+  std::ranges::sort(results_, [this](size_t lhs, size_t rhs) {
+    return scores_[lhs] != scores_[rhs] ? scores_[lhs] > scores_[rhs]
+                                        : lhs < rhs;
+  });
+
+  query_ = query;
+  category_ = category;
+}
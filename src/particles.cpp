@@ -0,0 +1,194 @@
+module;
+
+#include "SDL3/SDL_pixels.h"
+#include "SDL3/SDL_rect.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
+#include <random>
+#include <utility>
+#include <vector>
+
+export module particles;
+
+import drawList;
+
+/// the kinds of particles
+export enum class ParticleEffect : std::uint8_t { Spark, Splash, Dust };
+
+/// how the particles of an effect look and move
+struct ParticleStyle {
+  SDL_Color color;
+  /// the side of the particle quad in world units
+  float size;
+  /// the initial speed range in world units per ms
+  float minSpeed;
+  float maxSpeed;
+  /// the initial direction range in radians, y going down
+  float minAngle;
+  float maxAngle;
+  /// the vertical acceleration in world units per ms²
+  float gravity;
+  /// the lifetime range in ms
+  float minLifetime;
+  float maxLifetime;
+};
+
+inline constexpr auto pi = std::numbers::pi_v<float>;
+
+inline constexpr std::array<ParticleStyle, 3> particleStyles{{
+    {.color = {255, 220, 120, 255},
+     .size = 1,
+     .minSpeed = 0.05F,
+     .maxSpeed = 0.15F,
+     .minAngle = 0,
+     .maxAngle = 2 * pi,
+     .gravity = 0.0002F,
+     .minLifetime = 150,
+     .maxLifetime = 300},
+    {.color = {90, 140, 255, 255},
+     .size = 1,
+     .minSpeed = 0.02F,
+     .maxSpeed = 0.05F,
+     .minAngle = pi * 1.25F,
+     .maxAngle = pi * 1.75F,
+     .gravity = 0.0003F,
+     .minLifetime = 300,
+     .maxLifetime = 500},
+    {.color = {150, 130, 110, 255},
+     .size = 2,
+     .minSpeed = 0.005F,
+     .maxSpeed = 0.015F,
+     .minAngle = pi,
+     .maxAngle = 2 * pi,
+     .gravity = 0,
+     .minLifetime = 200,
+     .maxLifetime = 400},
+}};
+
+/// short lived colored quads
+///
+/// the particles are stored by field in arrays sized once by the
+/// constructor. The update is a single branchless pass over the arrays the
+/// compiler vectorizes, then dead particles are removed by moving the last
+/// particle in their place
+export class ParticleSystem {
+public:
+  /// constructor
+  ///
+  /// \param[in] Capacity the maximum number of live particles
+  explicit ParticleSystem(size_t capacity);
+
+  /// add particles, the ones over capacity are dropped
+  ///
+  /// \param[in] Effect the kind of particles
+  /// \param[in] Pos the position the particles start from
+  /// \param[in] Count the number of particles
+  auto emit(ParticleEffect effect, const SDL_FPoint &pos, size_t count) -> void;
+
+  /// advance every particle
+  ///
+  /// \param[in] DeltaTime the time since the last update in ms
+  auto update(float deltaTime) -> void;
+
+  /// add every particle to a draw list as a quad, fading with its age
+  auto render(DrawList &drawList) const -> void;
+
+  [[nodiscard]] auto size() const noexcept -> size_t { return count_; }
+  [[nodiscard]] auto capacity() const noexcept -> size_t { return x_.size(); }
+
+private:
+  /// move the last particle to index
+  auto removeAt(size_t index) noexcept -> void;
+
+  size_t count_{};
+  std::vector<float> x_;
+  std::vector<float> y_;
+  std::vector<float> speedX_;
+  std::vector<float> speedY_;
+  std::vector<float> gravity_;
+  std::vector<float> age_;
+  std::vector<float> lifetime_;
+  std::vector<ParticleEffect> effect_;
+
+  std::minstd_rand random_;
+};
+
+ParticleSystem::ParticleSystem(size_t capacity)
+    : x_(capacity), y_(capacity), speedX_(capacity), speedY_(capacity),
+      gravity_(capacity), age_(capacity), lifetime_(capacity),
+      effect_(capacity) {}
+
+auto ParticleSystem::emit(ParticleEffect effect, const SDL_FPoint &pos,
+                          size_t count) -> void {
+  const auto &style = particleStyles[std::to_underlying(effect)];
+  std::uniform_real_distribution<float> speed{style.minSpeed, style.maxSpeed};
+  std::uniform_real_distribution<float> angle{style.minAngle, style.maxAngle};
+  std::uniform_real_distribution<float> lifetime{style.minLifetime,
+                                                 style.maxLifetime};
+
+  const auto end = std::min(count_ + count, capacity());
+  for (; count_ < end; ++count_) {
+    const auto particleSpeed = speed(random_);
+    const auto particleAngle = angle(random_);
+    x_[count_] = pos.x;
+    y_[count_] = pos.y;
+    speedX_[count_] = particleSpeed * std::cos(particleAngle);
+    speedY_[count_] = particleSpeed * std::sin(particleAngle);
+    gravity_[count_] = style.gravity;
+    age_[count_] = 0;
+    lifetime_[count_] = lifetime(random_);
+    effect_[count_] = effect;
+  }
+}
+
+auto ParticleSystem::update(float deltaTime) -> void {
+  // branchless over plain float arrays, so the loop is vectorized
+  auto *const positionX = x_.data();
+  auto *const positionY = y_.data();
+  const auto *const speedX = speedX_.data();
+  auto *const speedY = speedY_.data();
+  const auto *const gravity = gravity_.data();
+  auto *const age = age_.data();
+  for (size_t index = 0; index < count_; ++index) {
+    speedY[index] += gravity[index] * deltaTime;
+    positionX[index] += speedX[index] * deltaTime;
+    positionY[index] += speedY[index] * deltaTime;
+    age[index] += deltaTime;
+  }
+
+  for (size_t index = 0; index < count_;) {
+    if (age_[index] >= lifetime_[index]) {
+      removeAt(index);
+    } else {
+      ++index;
+    }
+  }
+}
+
+auto ParticleSystem::removeAt(size_t index) noexcept -> void {
+  const auto last = --count_;
+  x_[index] = x_[last];
+  y_[index] = y_[last];
+  speedX_[index] = speedX_[last];
+  speedY_[index] = speedY_[last];
+  gravity_[index] = gravity_[last];
+  age_[index] = age_[last];
+  lifetime_[index] = lifetime_[last];
+  effect_[index] = effect_[last];
+}
+
+auto ParticleSystem::render(DrawList &drawList) const -> void {
+  constexpr float opaque{255};
+  for (size_t index = 0; index < count_; ++index) {
+    const auto &style = particleStyles[std::to_underlying(effect_[index])];
+    auto color = style.color;
+    color.a =
+        static_cast<Uint8>(opaque * (1 - (age_[index] / lifetime_[index])));
+    drawList.quad({x_[index], y_[index], style.size, style.size}, color);
+  }
+}
@@ -0,0 +1,167 @@
+module;
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+export module pool;
+
+/// handle of an object in a Pool
+///
+/// a handle outlives its object: once the object is despawned the slot
+/// generation changes and the handle no longer resolves
+export struct PoolHandle {
+  std::uint32_t slot;
+  std::uint32_t generation;
+
+  auto operator==(const PoolHandle &) const -> bool = default;
+};
+
+/// fixed capacity storage for short lived objects
+///
+/// every buffer is allocated by the constructor, spawn and despawn are O(1)
+/// and never allocate. The live objects are kept contiguous, a despawn moves
+/// the last object in the hole, so updates are a pass over a dense array
+export template <class Type> class Pool {
+public:
+  /// constructor
+  ///
+  /// \param[in] Capacity the maximum number of live objects
+  explicit Pool(std::uint32_t capacity);
+
+  /// create an object
+  ///
+  /// \param[in] Args the arguments of the object constructor
+  /// \return the handle of the object, nullopt if the pool is full
+  template <class... Args>
+  auto spawn(Args &&...args) -> std::optional<PoolHandle>;
+
+  /// destroy an object
+  ///
+  /// \return false if the handle did not resolve
+  auto despawn(PoolHandle handle) -> bool;
+
+  /// get an object
+  ///
+  /// \return the object or nullptr if it was despawned
+  [[nodiscard]] auto get(PoolHandle handle) noexcept -> Type *;
+
+  /// the live objects, in no particular order
+  [[nodiscard]] auto objects() noexcept -> std::span<Type> { return objects_; }
+  [[nodiscard]] auto objects() const noexcept -> std::span<const Type> {
+    return objects_;
+  }
+
+  /// the handle of a live object from its index in objects
+  [[nodiscard]] auto handle(size_t index) const noexcept -> PoolHandle {
+    const auto slot = objectSlots_[index];
+    return {.slot = slot, .generation = slots_[slot].generation};
+  }
+
+  /// destroy the live objects for which predicate returns true
+  template <class Predicate> auto despawnIf(Predicate &&predicate) -> size_t;
+
+  [[nodiscard]] auto size() const noexcept -> size_t {
+    return objects_.size();
+  }
+  [[nodiscard]] auto capacity() const noexcept -> size_t {
+    return slots_.size();
+  }
+
+private:
+  static constexpr std::uint32_t endOfList{
+      std::numeric_limits<std::uint32_t>::max()};
+
+  struct Slot {
+    /// index in objects_ when live, next free slot otherwise
+    std::uint32_t index;
+    std::uint32_t generation;
+  };
+
+  /// remove the object at an index of objects_
+  auto removeAt(std::uint32_t index) -> void;
+
+  std::vector<Type> objects_;
+  /// the slot of each object of objects_
+  std::vector<std::uint32_t> objectSlots_;
+  std::vector<Slot> slots_;
+  std::uint32_t freeSlot_;
+};
+
+template <class Type>
+Pool<Type>::Pool(std::uint32_t capacity)
+    : slots_(capacity), freeSlot_{capacity == 0 ? endOfList : 0} {
+  objects_.reserve(capacity);
+  objectSlots_.reserve(capacity);
+  for (std::uint32_t slot = 0; slot < capacity; ++slot) {
+    slots_[slot] = {.index = slot + 1 < capacity ? slot + 1 : endOfList,
+                    .generation = 0};
+  }
+}
+
+template <class Type>
+template <class... Args>
+auto Pool<Type>::spawn(Args &&...args) -> std::optional<PoolHandle> {
+  if (freeSlot_ == endOfList) {
+    return std::nullopt;
+  }
+
+  const auto slot = freeSlot_;
+  freeSlot_ = slots_[slot].index;
+
+  slots_[slot].index = static_cast<std::uint32_t>(objects_.size());
+  objects_.push_back(Type{std::forward<Args>(args)...});
+  objectSlots_.push_back(slot);
+  return PoolHandle{.slot = slot, .generation = slots_[slot].generation};
+}
+
+template <class Type>
+auto Pool<Type>::get(PoolHandle handle) noexcept -> Type * {
+  if (handle.slot >= slots_.size() ||
+      slots_[handle.slot].generation != handle.generation) {
+    return nullptr;
+  }
+  return &objects_[slots_[handle.slot].index];
+}
+
+template <class Type> auto Pool<Type>::despawn(PoolHandle handle) -> bool {
+  if (get(handle) == nullptr) {
+    return false;
+  }
+  removeAt(slots_[handle.slot].index);
+  return true;
+}
+
+template <class Type>
+template <class Predicate>
+auto Pool<Type>::despawnIf(Predicate &&predicate) -> size_t {
+  size_t removed{};
+  // walking backward, the object moved in a hole was already tested
+  for (auto index = objects_.size(); index-- > 0;) {
+    if (predicate(objects_[index])) {
+      removeAt(static_cast<std::uint32_t>(index));
+      ++removed;
+    }
+  }
+  return removed;
+}
+
+template <class Type> auto Pool<Type>::removeAt(std::uint32_t index) -> void {
+  const auto slot = objectSlots_[index];
+  const auto last = static_cast<std::uint32_t>(objects_.size() - 1);
+  if (index != last) {
+    objects_[index] = std::move(objects_[last]);
+    objectSlots_[index] = objectSlots_[last];
+    slots_[objectSlots_[index]].index = index;
+  }
+  objects_.pop_back();
+  objectSlots_.pop_back();
+
+  ++slots_[slot].generation;
+  slots_[slot].index = freeSlot_;
+  freeSlot_ = slot;
+}
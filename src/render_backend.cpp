@@ -0,0 +1,334 @@
+module;
+
+#include "SDL3/SDL_pixels.h"
+#include "SDL3/SDL_rect.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+export module renderBackend;
+
+import drawList;
+import image;
+
+/// the render backends the game can start with
+export enum class BackendKind : std::uint8_t { Sdl, Software, Null };
+
+/// get a backend from its name on the command line
+///
+/// \param[in] Name 'sdl', 'software' or 'null'
+/// \return the backend, nullopt if the name is unknown
+export constexpr auto findBackendKind(std::string_view name) noexcept
+    -> std::optional<BackendKind> {
+  if (name == "sdl") {
+    return BackendKind::Sdl;
+  }
+  if (name == "software") {
+    return BackendKind::Software;
+  }
+  if (name == "null") {
+    return BackendKind::Null;
+  }
+  return std::nullopt;
+}
+
+/// draws the draw lists into the scene
+///
+/// the scene is redrawn area by area, each damaged area is cleared then the
+/// commands touching it are drawn clipped to it. Where the scene ends up
+/// depends on the backend
+export class RenderBackend {
+public:
+  RenderBackend() = default;
+  RenderBackend(const RenderBackend &) = delete;
+  RenderBackend(RenderBackend &&) = delete;
+  auto operator=(const RenderBackend &) -> RenderBackend & = delete;
+  auto operator=(RenderBackend &&) -> RenderBackend & = delete;
+  virtual ~RenderBackend() = default;
+
+  /// the name of the backend on the command line
+  [[nodiscard]] virtual auto name() const noexcept -> std::string_view = 0;
+
+  /// use a new texture atlas
+  ///
+  /// \param[in] Atlas the decoded atlas
+  virtual auto setAtlas(const Image &atlas) -> void = 0;
+
+  /// fill an area of the scene with black
+  virtual auto clear(const SDL_Rect &area) -> void = 0;
+
+  /// draw the commands of a draw list touching an area of the scene
+  ///
+  /// \param[in] DrawList the commands to draw
+  /// \param[in] Area the area drawn, the commands are clipped to it
+  virtual auto submit(const DrawList &drawList, const SDL_Rect &area)
+      -> void = 0;
+
+  /// make the areas drawn since the last call visible
+  virtual auto finish() -> void {}
+};
+
+/// the calls received by a NullBackend
+export struct BackendCalls {
+  size_t clears;
+  size_t submits;
+  size_t sprites;
+  size_t rects;
+  size_t quads;
+};
+
+/// a backend drawing nothing, to measure the cost of building the scene
+/// alone
+export class NullBackend final : public RenderBackend {
+public:
+  [[nodiscard]] auto name() const noexcept -> std::string_view override {
+    return "null";
+  }
+
+  auto setAtlas(const Image & /*atlas*/) -> void override {}
+
+  auto clear(const SDL_Rect & /*area*/) -> void override { ++calls_.clears; }
+
+  auto submit(const DrawList &drawList, const SDL_Rect & /*area*/)
+      -> void override;
+
+  /// the calls received since the backend was created
+  [[nodiscard]] auto calls() const noexcept -> const BackendCalls & {
+    return calls_;
+  }
+
+private:
+  BackendCalls calls_{};
+};
+
+auto NullBackend::submit(const DrawList &drawList, const SDL_Rect & /*area*/)
+    -> void {
+  ++calls_.submits;
+  for (const auto &command : drawList.commands()) {
+    switch (command.kind) {
+    case DrawKind::Sprite:
+    case DrawKind::FlippedSprite:
+      ++calls_.sprites;
+      break;
+    case DrawKind::Rect:
+      ++calls_.rects;
+      break;
+    case DrawKind::Quad:
+      ++calls_.quads;
+      break;
+    }
+  }
+}
+
+/// a backend rasterizing on the cpu into an image in memory
+///
+/// it draws the way SdlRenderer::submit does: the sprites are sampled from
+/// the atlas without filtering, modulated and blended with their alpha, and
+/// a pixel is drawn when its center is inside the area of a command. It
+/// needs no window, so tests and benchmarks can render with it
+export class SoftwareBackend : public RenderBackend {
+public:
+  /// constructor
+  ///
+  /// \param[in] Size the size of the scene
+  explicit SoftwareBackend(const SDL_Point &size)
+      : scene_{.width = size.x,
+               .height = size.y,
+               .pixels = std::vector<SDL_Color>(
+                   static_cast<size_t>(size.x) * static_cast<size_t>(size.y),
+                   black)} {}
+
+  [[nodiscard]] auto name() const noexcept -> std::string_view override {
+    return "software";
+  }
+
+  auto setAtlas(const Image &atlas) -> void override { atlas_ = atlas; }
+
+  auto clear(const SDL_Rect &area) -> void override;
+
+  auto submit(const DrawList &drawList, const SDL_Rect &area)
+      -> void override;
+
+  /// the scene drawn so far
+  [[nodiscard]] auto scene() const noexcept -> const Image & { return scene_; }
+
+private:
+  static constexpr SDL_Color black{0, 0, 0, 255};
+
+  /// a block of pixels, from the left column and top row to the right
+  /// column and bottom row excluded
+  struct Span {
+    int left;
+    int top;
+    int right;
+    int bottom;
+  };
+
+  /// the pixels whose center is in a rect, clipped to an area
+  [[nodiscard]] static auto pixelsIn(const SDL_FRect &rect,
+                                     const Span &clip) noexcept -> Span;
+
+  /// blend a color over a pixel with its alpha
+  static auto blend(SDL_Color &pixel, const SDL_Color &color) noexcept
+      -> void;
+
+  auto drawSprite(const DrawCommand &command, const Span &clip) -> void;
+  auto drawQuad(const DrawCommand &command, const Span &clip) -> void;
+  auto drawRect(const DrawCommand &command, const Span &clip) -> void;
+
+  Image scene_;
+  Image atlas_;
+};
+
+auto SoftwareBackend::pixelsIn(const SDL_FRect &rect, const Span &clip) noexcept
+    -> Span {
+  constexpr float half{0.5F};
+  const auto first = [](float edge) {
+    return static_cast<int>(std::ceil(edge - half));
+  };
+  return {.left = std::max(first(rect.x), clip.left),
+          .top = std::max(first(rect.y), clip.top),
+          .right = std::min(first(rect.x + rect.w), clip.right),
+          .bottom = std::min(first(rect.y + rect.h), clip.bottom)};
+}
+
+auto SoftwareBackend::blend(SDL_Color &pixel, const SDL_Color &color) noexcept
+    -> void {
+  constexpr int opaque{255};
+  const int alpha = color.a;
+  const auto mix = [alpha](Uint8 source, Uint8 dest) {
+    return static_cast<Uint8>(
+        ((source * alpha) + (dest * (opaque - alpha)) + (opaque / 2)) /
+        opaque);
+  };
+  pixel = {mix(color.r, pixel.r), mix(color.g, pixel.g), mix(color.b, pixel.b),
+           static_cast<Uint8>(opaque)};
+}
+
+auto SoftwareBackend::clear(const SDL_Rect &area) -> void {
+  const auto span = pixelsIn(
+      {static_cast<float>(area.x), static_cast<float>(area.y),
+       static_cast<float>(area.w), static_cast<float>(area.h)},
+      {.left = 0, .top = 0, .right = scene_.width, .bottom = scene_.height});
+  if (span.left >= span.right) {
+    return;
+  }
+  for (auto row = span.top; row < span.bottom; ++row) {
+    std::fill_n(&scene_.at(span.left, row), span.right - span.left, black);
+  }
+}
+
+auto SoftwareBackend::submit(const DrawList &drawList, const SDL_Rect &area)
+    -> void {
+  const Span clip{.left = std::max(area.x, 0),
+                  .top = std::max(area.y, 0),
+                  .right = std::min(area.x + area.w, scene_.width),
+                  .bottom = std::min(area.y + area.h, scene_.height)};
+  for (const auto &command : drawList.commands()) {
+    switch (command.kind) {
+    case DrawKind::Sprite:
+    case DrawKind::FlippedSprite:
+      drawSprite(command, clip);
+      break;
+    case DrawKind::Rect:
+      drawRect(command, clip);
+      break;
+    case DrawKind::Quad:
+      drawQuad(command, clip);
+      break;
+    }
+  }
+}
+
+auto SoftwareBackend::drawSprite(const DrawCommand &command, const Span &clip)
+    -> void {
+  const auto span = pixelsIn(command.dest, clip);
+  if (span.left >= span.right || span.top >= span.bottom ||
+      atlas_.pixels.empty()) {
+    return;
+  }
+
+  constexpr float half{0.5F};
+  constexpr int opaque{255};
+  const auto &source = command.source;
+  const auto &dest = command.dest;
+  const auto flipped = command.kind == DrawKind::FlippedSprite;
+  const auto stepX = source.w / dest.w;
+  const auto stepY = source.h / dest.h;
+  const auto texel = [](float coordinate, int size) {
+    return std::clamp(static_cast<int>(std::floor(coordinate)), 0, size - 1);
+  };
+  const auto modulate = [&command](const SDL_Color &color) {
+    const auto channel = [](Uint8 value, Uint8 modulation) {
+      return static_cast<Uint8>((value * modulation) / opaque);
+    };
+    return SDL_Color{channel(color.r, command.color.r),
+                     channel(color.g, command.color.g),
+                     channel(color.b, command.color.b), color.a};
+  };
+
+  for (auto row = span.top; row < span.bottom; ++row) {
+    const auto sourceY = texel(
+        source.y + ((static_cast<float>(row) + half - dest.y) * stepY),
+        atlas_.height);
+    for (auto column = span.left; column < span.right; ++column) {
+      auto offset = (static_cast<float>(column) + half - dest.x) * stepX;
+      if (flipped) {
+        offset = source.w - offset;
+      }
+      const auto &color =
+          atlas_.at(texel(source.x + offset, atlas_.width), sourceY);
+      if (color.a != 0) {
+        blend(scene_.at(column, row), modulate(color));
+      }
+    }
+  }
+}
+
+auto SoftwareBackend::drawQuad(const DrawCommand &command, const Span &clip)
+    -> void {
+  const auto span = pixelsIn(command.dest, clip);
+  for (auto row = span.top; row < span.bottom; ++row) {
+    for (auto column = span.left; column < span.right; ++column) {
+      blend(scene_.at(column, row), command.color);
+    }
+  }
+}
+
+auto SoftwareBackend::drawRect(const DrawCommand &command, const Span &clip)
+    -> void {
+  // the outline is the first and last rows and columns of the rect, each
+  // pixel drawn once
+  const auto span = pixelsIn(
+      command.dest, {.left = std::numeric_limits<int>::min(),
+                     .top = std::numeric_limits<int>::min(),
+                     .right = std::numeric_limits<int>::max(),
+                     .bottom = std::numeric_limits<int>::max()});
+  if (span.left >= span.right || span.top >= span.bottom) {
+    return;
+  }
+  const auto plot = [this, &clip, &command](int column, int row) {
+    if (column >= clip.left && column < clip.right && row >= clip.top &&
+        row < clip.bottom) {
+      blend(scene_.at(column, row), command.color);
+    }
+  };
+  for (auto column = span.left; column < span.right; ++column) {
+    plot(column, span.top);
+    if (span.bottom - 1 != span.top) {
+      plot(column, span.bottom - 1);
+    }
+  }
+  for (auto row = span.top + 1; row < span.bottom - 1; ++row) {
+    plot(span.left, row);
+    if (span.right - 1 != span.left) {
+      plot(span.right - 1, row);
+    }
+  }
+}
@@ -0,0 +1,239 @@
+module;
+
+#include "SDL3/SDL_pixels.h"
+#include "SDL3/SDL_rect.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <ranges>
+#include <vector>
+
+export module scene;
+
+import tile;
+import tileOrder;
+import tileTypes;
+import drawList;
+import light;
+import occlusion;
+
+/// the light level of the cell of a tile of this type, 0 if it is not a light
+export constexpr auto lightIntensity(const TileType &type) -> std::uint8_t {
+  constexpr std::uint8_t fountainIntensity{10};
+  if (type.name.starts_with("wall_fountain_mid")) {
+    return fountainIntensity;
+  }
+  return 0;
+}
+
+/// the color modulation of every light level
+export inline constexpr auto lightColors = [] {
+  constexpr int ambient{48};
+  constexpr int opaque{255};
+  std::array<SDL_Color, maxLightLevel + 1> colors{};
+  for (int level = 0; level <= maxLightLevel; ++level) {
+    const auto value = static_cast<std::uint8_t>(
+        ambient + ((opaque - ambient) * level / maxLightLevel));
+    colors[level] = {value, value, value, opaque};
+  }
+  return colors;
+}();
+
+/// the largest sprite of the tile types, the tiles this far out of a view may
+/// still show on it
+export inline constexpr SDL_FPoint maxTileSize = [] {
+  SDL_FPoint size{};
+  for (const auto &type : tileTypes) {
+    size = {std::max(size.x, type.sourceRect.w),
+            std::max(size.y, type.sourceRect.h)};
+  }
+  return size;
+}();
+
+/// builds the draw list of the sprites of the world seen by a view
+///
+/// the floor is drawn first in the order of its layer, then the walls and the
+/// characters back to front. Walking the sprites front to back, a tile is
+/// culled when the opaque tiles drawn after it cover every cell it touches.
+/// Each sprite is modulated by the color of its position
+export class SceneBuilder {
+public:
+  /// the color of a sprite at a position, nullopt if it is hidden, in which
+  /// case it is left out and hides nothing
+  using ColorOf = std::function<std::optional<SDL_Color>(const SDL_FPoint &)>;
+
+  /// constructor
+  ///
+  /// \param[in] Cells the number of cells of the occlusion grid
+  /// \param[in] CellSize the side of a cell in world units
+  SceneBuilder(const SDL_Point &cells, float cellSize)
+      : occlusion_{cells, cellSize} {}
+
+  /// forget the sprites of the previous frame
+  auto clear() noexcept -> void;
+
+  /// add the tiles of the floor shown by a view, before any other sprite
+  ///
+  /// \param[in] Layer the tiles, in the order of their keys
+  /// \param[in] View the world area shown
+  /// \param[in] OpaqueTypes the types hiding what is drawn under them
+  /// \param[in] ColorOf the color of a position
+  auto addFloor(const TileLayer &layer, const SDL_FRect &view,
+                const OpacityTable &opaqueTypes, const ColorOf &colorOf)
+      -> void;
+
+  /// add the tiles of the walls shown by a view
+  ///
+  /// \param[in] Layer the tiles, in the order of their keys
+  /// \param[in] View the world area shown
+  /// \param[in] OpaqueTypes the types hiding what is drawn under them
+  /// \param[in] ColorOf the color of a position
+  auto addWalls(const TileLayer &layer, const SDL_FRect &view,
+                const OpacityTable &opaqueTypes, const ColorOf &colorOf)
+      -> void;
+
+  /// add a character, it is never culled
+  ///
+  /// \param[in] Sprite the sprite of the character
+  /// \param[in] ColorOf the color of a position
+  auto addCharacter(Renderable &sprite, const ColorOf &colorOf) -> void;
+
+  /// sort the sprites added since clear, cull them and add them to a draw list
+  ///
+  /// \param[out] DrawList the draw list, its modulation is left opaque white
+  /// \param[in] Culling whether the hidden tiles are culled
+  /// \param[in] FrameCount the number of frames already drawn
+  /// \return the number of sprites drawn and culled
+  auto build(DrawList &drawList, bool culling, size_t frameCount)
+      -> OcclusionStats;
+
+  /// whether an animated tile was added since clear
+  [[nodiscard]] auto hasAnimatedTile() const noexcept -> bool {
+    return animatedTile_;
+  }
+
+private:
+  /// a sprite of the world, in the order it is drawn
+  struct DrawItem {
+    Renderable *renderable;
+    /// the sort key of the walls and the characters
+    float depth;
+    SDL_Color color;
+    /// the area of a tile in world units, nullopt for the characters which
+    /// are never culled
+    std::optional<SDL_FRect> bounds;
+    /// whether the sprite hides what is drawn under it
+    bool opaque;
+    bool culled;
+  };
+
+  /// add the tiles of a layer shown by a view
+  auto addTiles(const TileLayer &layer, const SDL_FRect &view,
+                const OpacityTable &opaqueTypes, const ColorOf &colorOf)
+      -> void;
+
+  std::vector<DrawItem> items_;
+  /// the number of items of the floor, they keep the order of their layer
+  size_t floorCount_{};
+  OcclusionGrid occlusion_;
+  bool animatedTile_{};
+};
+
+auto SceneBuilder::clear() noexcept -> void {
+  items_.clear();
+  floorCount_ = 0;
+  animatedTile_ = false;
+}
+
+auto SceneBuilder::addFloor(const TileLayer &layer, const SDL_FRect &view,
+                            const OpacityTable &opaqueTypes,
+                            const ColorOf &colorOf) -> void {
+  addTiles(layer, view, opaqueTypes, colorOf);
+  floorCount_ = items_.size();
+}
+
+auto SceneBuilder::addWalls(const TileLayer &layer, const SDL_FRect &view,
+                            const OpacityTable &opaqueTypes,
+                            const ColorOf &colorOf) -> void {
+  addTiles(layer, view, opaqueTypes, colorOf);
+}
+
+auto SceneBuilder::addTiles(const TileLayer &layer, const SDL_FRect &view,
+                            const OpacityTable &opaqueTypes,
+                            const ColorOf &colorOf) -> void {
+  // a sprite is drawn above and right of its position, so the tiles shown
+  // are the ones from the left of the view down to under it
+  const SDL_FRect area{view.x - maxTileSize.x, view.y, view.w + maxTileSize.x,
+                       view.h + maxTileSize.y};
+  forEachTileIn(layer, area, [&](TileConcrete &tile) {
+    const auto pos = tile.getPos();
+    const auto color = colorOf(pos);
+    if (!color) {
+      return;
+    }
+    const auto record = tile.record();
+    const auto &rect = sourceRect(record.typeId);
+    animatedTile_ = animatedTile_ || tileType(record.typeId).tileClass ==
+                                         TileClass::AnimatedTerrain;
+    items_.push_back(
+        {.renderable = &tile,
+         .depth = pos.y,
+         .color = *color,
+         .bounds =
+             SDL_FRect{record.pos.x, record.pos.y - rect.h, rect.w, rect.h},
+         .opaque = opaqueTypes[record.typeId],
+         .culled = false});
+  });
+}
+
+auto SceneBuilder::addCharacter(Renderable &sprite, const ColorOf &colorOf)
+    -> void {
+  const auto pos = sprite.getPos();
+  if (const auto color = colorOf(pos)) {
+    items_.push_back({.renderable = &sprite,
+                      .depth = pos.y,
+                      .color = *color,
+                      .bounds = std::nullopt,
+                      .opaque = false,
+                      .culled = false});
+  }
+}
+
+auto SceneBuilder::build(DrawList &drawList, bool culling, size_t frameCount)
+    -> OcclusionStats {
+  // the sprites of equal depth keep the order they were added in, so the
+  // same world always gives the same draw list
+  std::ranges::stable_sort(
+      items_.begin() + static_cast<std::ptrdiff_t>(floorCount_), items_.end(),
+      {}, &DrawItem::depth);
+
+  OcclusionStats stats{.drawn = items_.size(), .culled = 0};
+  if (culling) {
+    occlusion_.clear();
+    for (auto &item : std::views::reverse(items_)) {
+      if (!item.bounds) {
+        continue;
+      }
+      if (occlusion_.isCovered(*item.bounds)) {
+        item.culled = true;
+        ++stats.culled;
+      } else if (item.opaque) {
+        occlusion_.cover(*item.bounds);
+      }
+    }
+    stats.drawn -= stats.culled;
+  }
+
+  for (const auto &item : items_) {
+    if (!item.culled) {
+      drawList.setModulation(item.color);
+      item.renderable->render(drawList, frameCount);
+    }
+  }
+  drawList.setModulation(lightColors.back());
+  return stats;
+}
@@ -0,0 +1,360 @@
+module;
+
+#include "SDL3/SDL_rect.h"
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+export module script;
+
+import pool;
+
+/// handle of a script in a ScriptScheduler
+export using ScriptId = PoolHandle;
+
+/// an event scripts can wait for
+export using TriggerId = std::uint32_t;
+
+/// a script, a coroutine run by a ScriptScheduler
+///
+/// the coroutine starts suspended, it runs once it is given to
+/// ScriptScheduler::spawn. An exception it does not catch is thrown by
+/// ScriptScheduler::update
+export class ScriptTask {
+public:
+  struct promise_type {
+    auto get_return_object() -> ScriptTask {
+      return ScriptTask{
+          std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    auto initial_suspend() noexcept -> std::suspend_always { return {}; }
+    auto final_suspend() noexcept -> std::suspend_always { return {}; }
+    auto return_void() noexcept -> void {}
+    auto unhandled_exception() -> void { throw; }
+
+    /// the handle of the script, set by the scheduler
+    ScriptId id{};
+  };
+
+  ScriptTask(const ScriptTask &) = delete;
+  ScriptTask(ScriptTask &&other) noexcept
+      : handle_{std::exchange(other.handle_, {})} {}
+  auto operator=(const ScriptTask &) -> ScriptTask & = delete;
+  auto operator=(ScriptTask &&) -> ScriptTask & = delete;
+
+  ~ScriptTask() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  /// give up the ownership of the coroutine
+  auto release() noexcept -> std::coroutine_handle<promise_type> {
+    return std::exchange(handle_, {});
+  }
+
+private:
+  explicit ScriptTask(std::coroutine_handle<promise_type> handle)
+      : handle_{handle} {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+/// runs scripts, resuming only the ones whose wait is over
+///
+/// a script waits for the next update, for a time or for a trigger, and is
+/// kept in the list of its wait condition: the scripts waiting for time are in
+/// a heap sorted by deadline, the ones waiting for a trigger in the list of
+/// the trigger. An update only looks at the scripts it resumes, so dormant
+/// scripts cost nothing per frame
+export class ScriptScheduler {
+public:
+  /// constructor
+  ///
+  /// \param[in] Capacity the maximum number of scripts alive at once
+  explicit ScriptScheduler(std::uint32_t capacity) : scripts_{capacity} {}
+
+  ScriptScheduler(const ScriptScheduler &) = delete;
+  ScriptScheduler(ScriptScheduler &&) = delete;
+  auto operator=(const ScriptScheduler &) -> ScriptScheduler & = delete;
+  auto operator=(ScriptScheduler &&) -> ScriptScheduler & = delete;
+
+  ~ScriptScheduler();
+
+  /// start a script at the next update
+  ///
+  /// \return the handle of the script, nullopt if the scheduler is full
+  auto spawn(ScriptTask task) -> std::optional<ScriptId>;
+
+  /// destroy a script wherever it waits, not from the script itself
+  ///
+  /// \return false if the script already finished
+  auto cancel(ScriptId id) -> bool;
+
+  /// create a trigger
+  auto addTrigger() -> TriggerId;
+
+  /// destroy a trigger, the scripts waiting for it never resume
+  auto removeTrigger(TriggerId trigger) -> void;
+
+  /// resume the scripts waiting for a trigger at the next update
+  auto fire(TriggerId trigger) -> void;
+
+  /// advance the time and resume the scripts whose wait is over
+  ///
+  /// \param[in] DeltaTime the time since the last update in ms
+  auto update(std::uint64_t deltaTime) -> void;
+
+  /// wait for the next update
+  [[nodiscard]] auto nextTick() noexcept { return Wait<Next>{this, {}}; }
+
+  /// wait for a duration
+  ///
+  /// \param[in] Duration the time to wait in ms
+  [[nodiscard]] auto sleep(std::uint64_t duration) noexcept {
+    return Wait<Deadline>{this, {now_ + duration}};
+  }
+
+  /// wait for a trigger to be fired
+  [[nodiscard]] auto trigger(TriggerId trigger) noexcept {
+    return Wait<TriggerId>{this, trigger};
+  }
+
+  /// the time since the scheduler was created in ms
+  [[nodiscard]] auto now() const noexcept -> std::uint64_t { return now_; }
+  /// the number of scripts alive
+  [[nodiscard]] auto size() const noexcept -> size_t {
+    return scripts_.size();
+  }
+  /// the number of scripts resumed by the last update
+  [[nodiscard]] auto resumed() const noexcept -> size_t { return resumed_; }
+
+private:
+  using Handle = std::coroutine_handle<ScriptTask::promise_type>;
+
+  struct Next {};
+  struct Deadline {
+    std::uint64_t time;
+  };
+
+  /// the awaitable of every wait condition
+  template <class Condition> struct Wait {
+    ScriptScheduler *scheduler;
+    Condition condition;
+
+    [[nodiscard]] auto await_ready() const noexcept -> bool { return false; }
+    auto await_suspend(Handle handle) -> void {
+      scheduler->suspend(handle.promise().id, condition);
+    }
+    auto await_resume() const noexcept -> void {}
+  };
+
+  struct Timer {
+    std::uint64_t deadline;
+    /// the order of the waits, so equal deadlines resume in order
+    std::uint64_t sequence;
+    ScriptId id;
+
+    auto operator>(const Timer &other) const noexcept -> bool {
+      return deadline != other.deadline ? deadline > other.deadline
+                                        : sequence > other.sequence;
+    }
+  };
+
+  auto suspend(ScriptId id, Next /*condition*/) -> void {
+    next_.push_back(id);
+  }
+  auto suspend(ScriptId id, Deadline condition) -> void {
+    timers_.push({condition.time, sequence_++, id});
+  }
+  auto suspend(ScriptId id, TriggerId condition) -> void {
+    triggers_[condition].push_back(id);
+  }
+
+  /// resume a script, and destroy it once it is over
+  auto resume(ScriptId id) -> void;
+
+  Pool<Handle> scripts_;
+  std::uint64_t now_{};
+  std::uint64_t sequence_{};
+  size_t resumed_{};
+
+  /// the scripts resumed by the next update
+  std::vector<ScriptId> next_;
+  /// kept to reuse its memory
+  std::vector<ScriptId> resuming_;
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<>> timers_;
+  /// the scripts waiting for each trigger
+  std::vector<std::vector<ScriptId>> triggers_;
+  std::vector<TriggerId> freeTriggers_;
+};
+
+ScriptScheduler::~ScriptScheduler() {
+  for (const auto handle : scripts_.objects()) {
+    handle.destroy();
+  }
+}
+
+auto ScriptScheduler::spawn(ScriptTask task) -> std::optional<ScriptId> {
+  const auto handle = task.release();
+  const auto id = scripts_.spawn(handle);
+  if (!id) {
+    handle.destroy();
+    return std::nullopt;
+  }
+  handle.promise().id = *id;
+  next_.push_back(*id);
+  return id;
+}
+
+auto ScriptScheduler::cancel(ScriptId id) -> bool {
+  // the waits of the script are left behind, the stale id resumes nothing
+  auto *const handle = scripts_.get(id);
+  if (handle == nullptr) {
+    return false;
+  }
+  handle->destroy();
+  return scripts_.despawn(id);
+}
+
+auto ScriptScheduler::addTrigger() -> TriggerId {
+  if (!freeTriggers_.empty()) {
+    const auto trigger = freeTriggers_.back();
+    freeTriggers_.pop_back();
+    return trigger;
+  }
+  triggers_.emplace_back();
+  return static_cast<TriggerId>(triggers_.size() - 1);
+}
+
+auto ScriptScheduler::removeTrigger(TriggerId trigger) -> void {
+  triggers_[trigger].clear();
+  freeTriggers_.push_back(trigger);
+}
+
+auto ScriptScheduler::fire(TriggerId trigger) -> void {
+  auto &waiting = triggers_[trigger];
+  next_.insert(next_.end(), waiting.begin(), waiting.end());
+  waiting.clear();
+}
+
+auto ScriptScheduler::resume(ScriptId id) -> void {
+  auto *const handle = scripts_.get(id);
+  if (handle == nullptr) {
+    return;
+  }
+  ++resumed_;
+  // the pool moves its objects, so the handle is copied before resuming
+  const auto script = *handle;
+  try {
+    script.resume();
+  } catch (...) {
+    script.destroy();
+    scripts_.despawn(id);
+    throw;
+  }
+  if (script.done()) {
+    script.destroy();
+    scripts_.despawn(id);
+  }
+}
+
+auto ScriptScheduler::update(std::uint64_t deltaTime) -> void {
+  now_ += deltaTime;
+  resumed_ = 0;
+
+  // the scripts waiting again for the next tick are resumed by the next
+  // update
+  std::swap(resuming_, next_);
+  for (const auto id : resuming_) {
+    resume(id);
+  }
+  resuming_.clear();
+
+  // the timers started by the scripts resumed here wait for the next update,
+  // even when their deadline is already over
+  const auto lastSequence = sequence_;
+  while (!timers_.empty() && timers_.top().deadline <= now_ &&
+         timers_.top().sequence < lastSequence) {
+    const auto id = timers_.top().id;
+    timers_.pop();
+    resume(id);
+  }
+}
+
+/// areas of the grid firing a trigger when the player enters them
+///
+/// the cells are hashed to the triggers covering them, so entering a cell
+/// only looks at the volumes of that cell
+export class TriggerVolumes {
+public:
+  /// add a volume
+  ///
+  /// \param[in] Cells the cells of the volume
+  /// \param[in] Trigger the trigger fired when a cell is entered
+  auto add(const SDL_Rect &cells, TriggerId trigger) -> void;
+
+  /// remove the volumes of a trigger
+  auto remove(TriggerId trigger) -> void;
+
+  /// fire the triggers of the volumes covering a cell
+  ///
+  /// \param[in] Cell the cell entered
+  /// \param[in] Scheduler the scheduler of the triggers
+  auto enter(const SDL_Point &cell, ScriptScheduler &scheduler) const -> void;
+
+private:
+  [[nodiscard]] static auto key(int x, int y) noexcept -> std::uint64_t {
+    constexpr unsigned halfBits{32};
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x))
+            << halfBits) |
+           static_cast<std::uint32_t>(y);
+  }
+
+  std::unordered_multimap<std::uint64_t, TriggerId> cells_;
+  std::unordered_map<TriggerId, std::vector<SDL_Rect>> volumes_;
+};
+
+auto TriggerVolumes::add(const SDL_Rect &cells, TriggerId trigger) -> void {
+  for (auto y = cells.y; y < cells.y + cells.h; ++y) {
+    for (auto x = cells.x; x < cells.x + cells.w; ++x) {
+      cells_.emplace(key(x, y), trigger);
+    }
+  }
+  volumes_[trigger].push_back(cells);
+}
+
+auto TriggerVolumes::remove(TriggerId trigger) -> void {
+  const auto volumes = volumes_.find(trigger);
+  if (volumes == volumes_.end()) {
+    return;
+  }
+  for (const auto &cells : volumes->second) {
+    for (auto y = cells.y; y < cells.y + cells.h; ++y) {
+      for (auto x = cells.x; x < cells.x + cells.w; ++x) {
+        auto [first, last] = cells_.equal_range(key(x, y));
+        while (first != last) {
+          first = first->second == trigger ? cells_.erase(first)
+                                           : std::next(first);
+        }
+      }
+    }
+  }
+  volumes_.erase(volumes);
+}
+
+auto TriggerVolumes::enter(const SDL_Point &cell,
+                           ScriptScheduler &scheduler) const -> void {
+  const auto [first, last] = cells_.equal_range(key(cell.x, cell.y));
+  for (auto iter = first; iter != last; ++iter) {
+    scheduler.fire(iter->second);
+  }
+}
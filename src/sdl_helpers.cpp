@@ -4,53 +4,48 @@ module;
 #include "backends/imgui_impl_sdlrenderer3.h"
 
 #include "SDL3/SDL_pixels.h"
+#include "SDL3/SDL_rect.h"
 #include "SDL3/SDL_render.h"
 #include "SDL3/SDL_video.h"
 #include "SDL3_image/SDL_image.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <exception>
 #include <format>
-#include <istream>
 #include <memory>
-#include <ostream>
+#include <optional>
+#include <string_view>
 
 export module sdlHelpers;
 
+export import sdlStreams;
+import drawList;
+import image;
+import renderBackend;
+import memory;
+
 /// Used to  auto delete SDL_Texture
 export using SdlTexturePtr =
     std::unique_ptr<SDL_Texture, void (*)(SDL_Texture *)>;
 
-/// Used to  auto delete SDL_Surface
-export using SdlSurfacePtr =
-    std::unique_ptr<SDL_Surface, void (*)(SDL_Surface *)>;
-
-/// add SDL_FPoint to an output stream in the form 'x y'
-export auto operator<<(std::ostream &ostream, const SDL_FPoint &point)
-    -> std::ostream & {
-  ostream << point.x << ' ' << point.y;
-  return ostream;
-}
-
-/// add SDL_Frect to an output stream in the form 'x y w h'
-export auto operator<<(std::ostream &ostream, const SDL_FRect &rect)
-    -> std::ostream & {
-  ostream << rect.x << ' ' << rect.y << ' ' << rect.w << ' ' << rect.h;
-  return ostream;
+/// the bytes of a texture, from its size and its pixel format
+export auto textureBytes(const SDL_Texture *texture) noexcept -> size_t {
+  return static_cast<size_t>(texture->w) * static_cast<size_t>(texture->h) *
+         SDL_BYTESPERPIXEL(texture->format);
 }
 
-/// read an SDL_FPoint from an input stream in the form 'x y'
-export auto operator>>(std::istream &istream, SDL_FPoint &point)
-    -> std::istream & {
-  istream >> point.x >> point.y;
-  return istream;
+/// destroy a texture created by SdlRenderer, releasing its memory from the
+/// textures
+auto destroyTrackedTexture(SDL_Texture *texture) -> void {
+  trackDeallocation(MemoryTag::Textures, textureBytes(texture));
+  SDL_DestroyTexture(texture);
 }
 
-/// read an SDL_Frect from an input stream in the form 'x y w h'
-export auto operator>>(std::istream &istream, SDL_FRect &rect)
-    -> std::istream & {
-  istream >> rect.x >> rect.y >> rect.w >> rect.h;
-  return istream;
-}
+/// Used to  auto delete SDL_Surface
+export using SdlSurfacePtr =
+    std::unique_ptr<SDL_Surface, void (*)(SDL_Surface *)>;
 
 /// an error occured while initializing
 export class InitError : public std::exception {
@@ -91,6 +86,57 @@ private:
   std::string errorMessage_; ///< the error message
 };
 
+/// decode a png image
+///
+/// does not need a renderer, so an image can be decoded on any thread
+///
+/// \param[in] Path the path of the image
+/// \return the image
+export auto loadSurface(const char *path) -> SdlSurfacePtr {
+  auto *iostr = SDL_IOFromFile(path, "r");
+  if (iostr == nullptr) {
+    throw TextureLoadingError{
+        std::format("SDL_IOFromFile(): {}", SDL_GetError())};
+  }
+
+  SdlSurfacePtr surface{IMG_LoadPNG_IO(iostr), SDL_DestroySurface};
+  SDL_CloseIO(iostr);
+  if (!surface) {
+    throw TextureLoadingError{
+        std::format("IMG_LoadPNG_IO(): {}", SDL_GetError())};
+  }
+  return surface;
+}
+
+/// copy a decoded image in memory
+///
+/// \param[in] Surface the image, in any format
+/// \return the pixels of the image
+export auto surfaceImage(const SdlSurfacePtr &surface) -> Image {
+  const SdlSurfacePtr converted{
+      SDL_ConvertSurface(surface.get(), SDL_PIXELFORMAT_RGBA32),
+      SDL_DestroySurface};
+  if (!converted || !SDL_LockSurface(converted.get())) {
+    throw TextureLoadingError{
+        std::format("SDL_ConvertSurface(): {}", SDL_GetError())};
+  }
+
+  Image image{.width = converted->w, .height = converted->h, .pixels = {}};
+  image.pixels.resize(static_cast<size_t>(image.width) *
+                      static_cast<size_t>(image.height));
+  // the RGBA32 bytes are in the order of SDL_Color whatever the endianness
+  const auto rowBytes = static_cast<size_t>(image.width) * sizeof(SDL_Color);
+  const auto *pixels = static_cast<const std::uint8_t *>(converted->pixels);
+  for (int row = 0; row < image.height; ++row) {
+    std::memcpy(&image.at(0, row),
+                pixels + (static_cast<size_t>(row) *
+                          static_cast<size_t>(converted->pitch)),
+                rowBytes);
+  }
+  SDL_UnlockSurface(converted.get());
+  return image;
+}
+
 export class SdlRenderer {
   friend class SdlWindow;
 
@@ -98,30 +144,84 @@ public:
   explicit SdlRenderer(SDL_Renderer *renderer) noexcept : renderer_{renderer} {}
 
   auto createTextureFromPath(const char *path) const -> SdlTexturePtr {
-    auto *iostr = SDL_IOFromFile(path, "r");
-    if (iostr == nullptr) {
+    return createTextureFromSurface(loadSurface(path));
+  }
+
+  /// create a texture from an image already decoded
+  ///
+  /// \param[in] Surface the image
+  /// \return the texture, scaled without filtering
+  auto createTextureFromSurface(const SdlSurfacePtr &surface) const
+      -> SdlTexturePtr {
+    SdlTexturePtr texture = {
+        SDL_CreateTextureFromSurface(renderer_, surface.get()),
+        destroyTrackedTexture};
+    if (!texture) {
       throw TextureLoadingError{
-          std::format("SDL_IOFromFile(): {}", SDL_GetError())};
+          std::format("SDL_CreateTextureFromSurface(): {}", SDL_GetError())};
     }
+    trackAllocation(MemoryTag::Textures, textureBytes(texture.get()));
+
+    SDL_SetTextureScaleMode(texture.get(), SDL_SCALEMODE_NEAREST);
+    return texture;
+  }
 
-    const SdlSurfacePtr surface{IMG_LoadPNG_IO(iostr), SDL_DestroySurface};
-    if (!surface) {
+  /// create a texture updated from the cpu
+  ///
+  /// \param[in] Size the size of the texture in pixels
+  /// \return the texture, in the SDL_PIXELFORMAT_RGBA32 format
+  auto createStreamingTexture(const SDL_Point &size) const -> SdlTexturePtr {
+    SdlTexturePtr texture = {
+        SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_RGBA32,
+                          SDL_TEXTUREACCESS_STREAMING, size.x, size.y),
+        destroyTrackedTexture};
+    if (!texture) {
       throw TextureLoadingError{
-          std::format("IMG_LoadPNG_IO(): {}", SDL_GetError())};
+          std::format("SDL_CreateTexture(): {}", SDL_GetError())};
     }
+    trackAllocation(MemoryTag::Textures, textureBytes(texture.get()));
 
+    SDL_SetTextureScaleMode(texture.get(), SDL_SCALEMODE_NEAREST);
+    return texture;
+  }
+
+  /// create a texture the renderer can draw to
+  ///
+  /// \param[in] Size the size of the texture in pixels
+  /// \return the texture, copied without blending
+  auto createTargetTexture(const SDL_Point &size) const -> SdlTexturePtr {
     SdlTexturePtr texture = {
-        SDL_CreateTextureFromSurface(renderer_, surface.get()),
-        SDL_DestroyTexture};
+        SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_RGBA32,
+                          SDL_TEXTUREACCESS_TARGET, size.x, size.y),
+        destroyTrackedTexture};
     if (!texture) {
       throw TextureLoadingError{
-          std::format("SDL_CreateTextureFromSurface(): {}", SDL_GetError())};
+          std::format("SDL_CreateTexture(): {}", SDL_GetError())};
     }
+    trackAllocation(MemoryTag::Textures, textureBytes(texture.get()));
 
+    SDL_SetTextureBlendMode(texture.get(), SDL_BLENDMODE_NONE);
     SDL_SetTextureScaleMode(texture.get(), SDL_SCALEMODE_NEAREST);
     return texture;
   }
 
+  /// draw to a texture instead of the window
+  auto setRenderTarget(const SdlTexturePtr &texture) const noexcept -> void {
+    SDL_SetRenderTarget(renderer_, texture.get());
+  }
+  /// draw to the window again
+  auto resetRenderTarget() const noexcept -> void {
+    SDL_SetRenderTarget(renderer_, nullptr);
+  }
+
+  /// only draw inside a rect of the target
+  auto setClipRect(const SDL_Rect &rect) const noexcept -> void {
+    SDL_SetRenderClipRect(renderer_, &rect);
+  }
+  auto resetClipRect() const noexcept -> void {
+    SDL_SetRenderClipRect(renderer_, nullptr);
+  }
+
   auto setRenderDrawColor(const SDL_Color &color) const noexcept -> void {
     SDL_SetRenderDrawColor(renderer_, color.r, color.g, color.b, color.a);
   }
@@ -130,6 +230,9 @@ public:
   auto renderRect(const SDL_FRect &rect) const noexcept -> void {
     SDL_RenderRect(renderer_, &rect);
   }
+  auto renderFillRect(const SDL_FRect &rect) const noexcept -> void {
+    SDL_RenderFillRect(renderer_, &rect);
+  }
 
   auto renderTextureRotated(const SdlTexturePtr &texture,
                             const SDL_FRect &sourceRect,
@@ -145,8 +248,86 @@ public:
     SDL_RenderTexture(renderer_, texture.get(), &sourceRect, &destRect);
   }
 
+  /// draw every command of a draw list
+  ///
+  /// \param[in] DrawList the commands to draw
+  /// \param[in] Texture the texture atlas the sprites are taken from
+  /// \param[in] Clip when set, the commands out of this rect are skipped
+  auto submit(const DrawList &drawList, const SdlTexturePtr &texture,
+              const std::optional<SDL_Rect> &clip = std::nullopt) const
+      noexcept -> void {
+    std::optional<SDL_FRect> clipArea;
+    if (clip) {
+      clipArea = SDL_FRect{static_cast<float>(clip->x),
+                           static_cast<float>(clip->y),
+                           static_cast<float>(clip->w),
+                           static_cast<float>(clip->h)};
+    }
+
+    // the modulation is texture state, only change it between commands with
+    // a different color
+    SDL_Color modulation{255, 255, 255, 255};
+    SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_BLEND);
+
+    for (const auto &command : drawList.commands()) {
+      if (clipArea &&
+          !SDL_HasRectIntersectionFloat(&command.dest, &*clipArea)) {
+        continue;
+      }
+
+      const bool isSprite = command.kind == DrawKind::Sprite ||
+                            command.kind == DrawKind::FlippedSprite;
+      if (isSprite &&
+          (command.color.r != modulation.r || command.color.g != modulation.g ||
+           command.color.b != modulation.b)) {
+        modulation = command.color;
+        SDL_SetTextureColorMod(texture.get(), modulation.r, modulation.g,
+                               modulation.b);
+      }
+
+      switch (command.kind) {
+      case DrawKind::Sprite:
+        renderTexture(texture, command.source, command.dest);
+        break;
+      case DrawKind::FlippedSprite: {
+        const SDL_FPoint center{0, 0};
+        renderTextureRotated(texture, command.source, command.dest, 0, center,
+                             SDL_FLIP_HORIZONTAL);
+        break;
+      }
+      case DrawKind::Rect:
+        setRenderDrawColor(command.color);
+        renderRect(command.dest);
+        break;
+      case DrawKind::Quad:
+        setRenderDrawColor(command.color);
+        renderFillRect(command.dest);
+        break;
+      }
+    }
+
+    // the atlas is also drawn by the Gui, which expects it unmodulated
+    SDL_SetTextureColorMod(texture.get(), 255, 255, 255);
+  }
+
   auto renderPresent() const noexcept -> void { SDL_RenderPresent(renderer_); }
 
+  /// get the size of the window in pixels
+  [[nodiscard]] auto outputSize() const noexcept -> SDL_Point {
+    SDL_Point size{};
+    SDL_GetCurrentRenderOutputSize(renderer_, &size.x, &size.y);
+    return size;
+  }
+
+  /// get the pixel under a window position, as given by the mouse events
+  [[nodiscard]] auto coordinatesFromWindow(const SDL_FPoint &pos) const
+      noexcept -> SDL_FPoint {
+    SDL_FPoint pixel{pos};
+    SDL_RenderCoordinatesFromWindow(renderer_, pos.x, pos.y, &pixel.x,
+                                    &pixel.y);
+    return pixel;
+  }
+
   auto imguiRenderDrawData() const noexcept -> void {
     ImGui_ImplSDLRenderer3_RenderDrawData(ImGui::GetDrawData(), renderer_);
   }
@@ -159,6 +340,115 @@ private:
   SDL_Renderer *renderer_;
 };
 
+/// a backend drawing with the SDL renderer into a target texture
+export class SdlBackend final : public RenderBackend {
+public:
+  /// constructor
+  ///
+  /// \param[in] Renderer the renderer to draw with
+  /// \param[in] Atlas the texture atlas, replaced in place when reloaded
+  /// \param[in] Target the texture the scene is drawn to, created by
+  ///   createTargetTexture
+  SdlBackend(SdlRenderer renderer, const SdlTexturePtr &atlas,
+             const SdlTexturePtr &target)
+      : renderer_{renderer}, atlas_{&atlas}, target_{&target} {}
+
+  [[nodiscard]] auto name() const noexcept -> std::string_view override {
+    return "sdl";
+  }
+
+  /// the atlas texture is already replaced
+  auto setAtlas(const Image & /*atlas*/) -> void override {}
+
+  auto clear(const SDL_Rect &area) -> void override {
+    constexpr SDL_Color black{0, 0, 0, 255};
+    const SDL_FRect rect{static_cast<float>(area.x), static_cast<float>(area.y),
+                         static_cast<float>(area.w),
+                         static_cast<float>(area.h)};
+    renderer_.setRenderTarget(*target_);
+    renderer_.setClipRect(area);
+    renderer_.setRenderDrawColor(black);
+    renderer_.renderFillRect(rect);
+  }
+
+  auto submit(const DrawList &drawList, const SDL_Rect &area)
+      -> void override {
+    renderer_.setRenderTarget(*target_);
+    renderer_.setClipRect(area);
+    renderer_.submit(drawList, *atlas_, area);
+  }
+
+  auto finish() -> void override {
+    renderer_.resetClipRect();
+    renderer_.resetRenderTarget();
+  }
+
+private:
+  SdlRenderer renderer_;
+  const SdlTexturePtr *atlas_;
+  const SdlTexturePtr *target_;
+};
+
+/// a SoftwareBackend whose scene is uploaded to a texture of the window
+export class SdlSoftwareBackend final : public SoftwareBackend {
+public:
+  /// constructor
+  ///
+  /// \param[in] Target the texture the scene is uploaded to, created by
+  ///   createStreamingTexture with the size of the scene
+  explicit SdlSoftwareBackend(const SdlTexturePtr &target)
+      : SoftwareBackend{textureSize(target)}, target_{&target} {}
+
+  auto clear(const SDL_Rect &area) -> void override {
+    SoftwareBackend::clear(area);
+    addDirty(area);
+  }
+
+  auto submit(const DrawList &drawList, const SDL_Rect &area)
+      -> void override {
+    SoftwareBackend::submit(drawList, area);
+    addDirty(area);
+  }
+
+  /// upload the area drawn since the last call
+  auto finish() -> void override {
+    if (!dirty_) {
+      return;
+    }
+    const auto &image = scene();
+    SDL_Rect area{};
+    const SDL_Rect bounds{0, 0, image.width, image.height};
+    if (SDL_GetRectIntersection(&*dirty_, &bounds, &area)) {
+      SDL_UpdateTexture(target_->get(), &area, &image.at(area.x, area.y),
+                        image.width * static_cast<int>(sizeof(SDL_Color)));
+    }
+    dirty_.reset();
+  }
+
+private:
+  [[nodiscard]] static auto textureSize(const SdlTexturePtr &texture) noexcept
+      -> SDL_Point {
+    float width{};
+    float height{};
+    SDL_GetTextureSize(texture.get(), &width, &height);
+    return {static_cast<int>(width), static_cast<int>(height)};
+  }
+
+  auto addDirty(const SDL_Rect &area) noexcept -> void {
+    if (!dirty_) {
+      dirty_ = area;
+      return;
+    }
+    SDL_Rect merged{};
+    SDL_GetRectUnion(&*dirty_, &area, &merged);
+    dirty_ = merged;
+  }
+
+  const SdlTexturePtr *target_;
+  /// the bounding box of the areas drawn since the last upload
+  std::optional<SDL_Rect> dirty_;
+};
+
 export class SdlWindow {
 public:
   SdlWindow(const char *name, const SDL_Point &size, Uint32 flags)
@@ -0,0 +1,367 @@
+module;
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+export module snapshot;
+
+import animation;
+import tileTypes;
+
+/// the number of quantized steps in a world unit
+export inline constexpr float positionScale{8};
+
+/// round a world position to the steps sent in snapshots
+export auto quantize(float value) noexcept -> std::int32_t {
+  constexpr auto limit =
+      static_cast<float>(std::numeric_limits<std::int32_t>::max() / 2);
+  return static_cast<std::int32_t>(
+      std::lround(std::clamp(value * positionScale, -limit, limit)));
+}
+
+/// get the world position of a quantized position
+export constexpr auto dequantize(std::int32_t value) noexcept -> float {
+  return static_cast<float>(value) / positionScale;
+}
+
+/// the state of a character sent in snapshots
+export struct EntityState {
+  TileTypeId typeId{};
+  /// the quantized position
+  std::int32_t x{};
+  std::int32_t y{};
+  Clip clip{Clip::Idle};
+  /// whether the character faces left
+  bool flipped{};
+
+  auto operator==(const EntityState &) const -> bool = default;
+};
+
+/// a tile placed or removed
+export struct TileEdit {
+  /// the quantized position
+  std::int32_t x{};
+  std::int32_t y{};
+  bool wall{};
+  /// whether the tile is on the ground or in the air
+  bool level{};
+  /// the type of the tile placed, nullopt when the tile was removed
+  std::optional<TileTypeId> typeId;
+
+  auto operator==(const TileEdit &) const -> bool = default;
+};
+
+/// the state of the world at a tick
+///
+/// the entities are delta compressed against the snapshot of a previous tick,
+/// the edits are not part of that state: they are the tile changes since the
+/// previous snapshot, or the whole level when resetTiles is set
+export struct Snapshot {
+  std::uint32_t tick{};
+  std::vector<EntityState> entities;
+  /// whether the tiles are cleared before the edits are applied
+  bool resetTiles{};
+  std::vector<TileEdit> edits;
+};
+
+/// a mask of the low bits of a word, bits is at most 32
+constexpr auto lowBits(unsigned bits) noexcept -> std::uint64_t {
+  return (std::uint64_t{1} << bits) - 1;
+}
+
+/// writes values of any bit width in a byte buffer, least significant first
+export class BitWriter {
+public:
+  /// write the low bits of a value
+  ///
+  /// \param[in] Value the value
+  /// \param[in] Bits the number of bits written, at most 32
+  auto write(std::uint32_t value, unsigned bits) -> void {
+    const auto mask = lowBits(bits);
+    pending_ |= (value & mask) << pendingBits_;
+    pendingBits_ += bits;
+    while (pendingBits_ >= 8) {
+      bytes_.push_back(static_cast<std::uint8_t>(pending_));
+      pending_ >>= 8U;
+      pendingBits_ -= 8;
+    }
+  }
+
+  auto writeBool(bool value) -> void { write(value ? 1 : 0, 1); }
+
+  /// flush the bits of an incomplete byte and get the buffer
+  auto finish() -> std::vector<std::uint8_t> {
+    if (pendingBits_ > 0) {
+      bytes_.push_back(static_cast<std::uint8_t>(pending_));
+    }
+    pending_ = 0;
+    pendingBits_ = 0;
+    return std::exchange(bytes_, {});
+  }
+
+private:
+  std::vector<std::uint8_t> bytes_;
+  std::uint64_t pending_{};
+  unsigned pendingBits_{};
+};
+
+/// reads the values written by a BitWriter
+///
+/// reading past the end gives zeros and sets failed, so a whole message is
+/// read before checking it once
+export class BitReader {
+public:
+  explicit BitReader(std::span<const std::uint8_t> bytes) : bytes_{bytes} {}
+
+  /// \param[in] Bits the number of bits read, at most 32
+  auto read(unsigned bits) noexcept -> std::uint32_t {
+    while (pendingBits_ < bits) {
+      if (next_ == bytes_.size()) {
+        failed_ = true;
+        return 0;
+      }
+      pending_ |= static_cast<std::uint64_t>(bytes_[next_++]) << pendingBits_;
+      pendingBits_ += 8;
+    }
+    const auto mask = lowBits(bits);
+    const auto value = static_cast<std::uint32_t>(pending_ & mask);
+    pending_ >>= bits;
+    pendingBits_ -= bits;
+    return value;
+  }
+
+  auto readBool() noexcept -> bool { return read(1) != 0; }
+
+  [[nodiscard]] auto failed() const noexcept -> bool { return failed_; }
+
+private:
+  std::span<const std::uint8_t> bytes_;
+  size_t next_{};
+  std::uint64_t pending_{};
+  unsigned pendingBits_{};
+  bool failed_{};
+};
+
+/// the header of an encoded snapshot
+export struct SnapshotHeader {
+  std::uint32_t tick;
+  /// the tick of the snapshot the entities are relative to, nullopt when
+  /// they are not
+  std::optional<std::uint32_t> baselineTick;
+};
+
+inline constexpr unsigned tickBits{32};
+inline constexpr unsigned entityCountBits{16};
+inline constexpr unsigned editCountBits{24};
+inline constexpr unsigned clipBits{2};
+inline constexpr unsigned typeIdBits{
+    static_cast<unsigned>(std::bit_width(tileTypes.size() - 1))};
+/// the zigzag encoded deltas under 1 << smallDeltaBits take a single byte
+inline constexpr unsigned smallDeltaBits{7};
+
+/// map the small negative and positive values to the small unsigned values
+constexpr auto zigzag(std::int32_t value) noexcept -> std::uint32_t {
+  return (static_cast<std::uint32_t>(value) << 1U) ^
+         static_cast<std::uint32_t>(value >> 31);
+}
+
+constexpr auto unzigzag(std::uint32_t value) noexcept -> std::int32_t {
+  return static_cast<std::int32_t>(value >> 1U) ^
+         -static_cast<std::int32_t>(value & 1U);
+}
+
+/// write the difference between two quantized positions, in 8 bits when
+/// it is small
+auto writeDelta(BitWriter &writer, std::int32_t from, std::int32_t to)
+    -> void {
+  const auto delta = zigzag(static_cast<std::int32_t>(
+      static_cast<std::uint32_t>(to) - static_cast<std::uint32_t>(from)));
+  const bool small = delta < (1U << smallDeltaBits);
+  writer.writeBool(small);
+  writer.write(delta, small ? smallDeltaBits : 32);
+}
+
+auto readDelta(BitReader &reader, std::int32_t from) noexcept
+    -> std::int32_t {
+  const auto small = reader.readBool();
+  const auto delta = unzigzag(reader.read(small ? smallDeltaBits : 32));
+  return static_cast<std::int32_t>(static_cast<std::uint32_t>(from) +
+                                   static_cast<std::uint32_t>(delta));
+}
+
+/// read the header of an encoded snapshot
+///
+/// \return the header, nullopt if the bytes are too short
+export auto readSnapshotHeader(std::span<const std::uint8_t> bytes) noexcept
+    -> std::optional<SnapshotHeader> {
+  BitReader reader{bytes};
+  SnapshotHeader header{.tick = reader.read(tickBits), .baselineTick = {}};
+  if (reader.readBool()) {
+    header.baselineTick = reader.read(tickBits);
+  }
+  if (reader.failed()) {
+    return std::nullopt;
+  }
+  return header;
+}
+
+/// encode a snapshot
+///
+/// each entity is compared with the entity at the same index of the
+/// baseline: an unchanged entity takes a bit, and only the fields which
+/// changed are written, the positions as deltas. The edits are written as
+/// deltas from the previous edit, so the tiles of a level written in order
+/// take a few bytes each
+///
+/// \param[in] Snapshot the snapshot
+/// \param[in] Baseline the last snapshot the receiver acknowledged, nullptr to
+///   encode the entities in full
+/// \return the bytes, nullopt if there are too many entities or edits
+export auto encodeSnapshot(const Snapshot &snapshot, const Snapshot *baseline)
+    -> std::optional<std::vector<std::uint8_t>> {
+  if (snapshot.entities.size() >= (size_t{1} << entityCountBits) ||
+      snapshot.edits.size() >= (size_t{1} << editCountBits)) {
+    return std::nullopt;
+  }
+
+  BitWriter writer;
+  writer.write(snapshot.tick, tickBits);
+  writer.writeBool(baseline != nullptr);
+  if (baseline != nullptr) {
+    writer.write(baseline->tick, tickBits);
+  }
+  writer.writeBool(snapshot.resetTiles);
+  writer.write(static_cast<std::uint32_t>(snapshot.entities.size()),
+               entityCountBits);
+  writer.write(static_cast<std::uint32_t>(snapshot.edits.size()),
+               editCountBits);
+
+  for (size_t index = 0; index < snapshot.entities.size(); ++index) {
+    const auto &entity = snapshot.entities[index];
+    const auto previous = baseline != nullptr &&
+                                  index < baseline->entities.size()
+                              ? baseline->entities[index]
+                              : EntityState{};
+    writer.writeBool(entity != previous);
+    if (entity == previous) {
+      continue;
+    }
+
+    writer.writeBool(entity.typeId != previous.typeId);
+    if (entity.typeId != previous.typeId) {
+      writer.write(entity.typeId, typeIdBits);
+    }
+    writer.writeBool(entity.x != previous.x);
+    if (entity.x != previous.x) {
+      writeDelta(writer, previous.x, entity.x);
+    }
+    writer.writeBool(entity.y != previous.y);
+    if (entity.y != previous.y) {
+      writeDelta(writer, previous.y, entity.y);
+    }
+    writer.writeBool(entity.clip != previous.clip);
+    if (entity.clip != previous.clip) {
+      writer.write(std::to_underlying(entity.clip), clipBits);
+    }
+    writer.writeBool(entity.flipped);
+  }
+
+  TileEdit previous;
+  for (const auto &edit : snapshot.edits) {
+    writeDelta(writer, previous.x, edit.x);
+    writeDelta(writer, previous.y, edit.y);
+    writer.writeBool(edit.wall);
+    writer.writeBool(edit.level);
+    writer.writeBool(edit.typeId.has_value());
+    if (edit.typeId) {
+      writer.write(*edit.typeId, typeIdBits);
+    }
+    previous = edit;
+  }
+  return writer.finish();
+}
+
+/// decode a snapshot written by encodeSnapshot
+///
+/// \param[in] Bytes the encoded snapshot
+/// \param[in] Baseline the snapshot of the tick the header names, nullptr if
+///   the header names none
+/// \return the snapshot, nullopt if the bytes are truncated or invalid, or if
+///   the baseline is not the one the snapshot was encoded against
+export auto decodeSnapshot(std::span<const std::uint8_t> bytes,
+                           const Snapshot *baseline)
+    -> std::optional<Snapshot> {
+  BitReader reader{bytes};
+  Snapshot snapshot;
+  snapshot.tick = reader.read(tickBits);
+  const auto hasBaseline = reader.readBool();
+  if (hasBaseline != (baseline != nullptr) ||
+      (hasBaseline && reader.read(tickBits) != baseline->tick)) {
+    return std::nullopt;
+  }
+  snapshot.resetTiles = reader.readBool();
+  const auto entityCount = reader.read(entityCountBits);
+  const auto editCount = reader.read(editCountBits);
+  // every entity and edit takes at least a bit, which bounds the allocation
+  // of a corrupted count
+  if (reader.failed() || entityCount + editCount > bytes.size() * 8) {
+    return std::nullopt;
+  }
+
+  snapshot.entities.resize(entityCount);
+  for (size_t index = 0; index < entityCount; ++index) {
+    auto &entity = snapshot.entities[index];
+    entity = baseline != nullptr && index < baseline->entities.size()
+                 ? baseline->entities[index]
+                 : EntityState{};
+    if (!reader.readBool()) {
+      continue;
+    }
+
+    if (reader.readBool()) {
+      entity.typeId = static_cast<TileTypeId>(reader.read(typeIdBits));
+    }
+    if (reader.readBool()) {
+      entity.x = readDelta(reader, entity.x);
+    }
+    if (reader.readBool()) {
+      entity.y = readDelta(reader, entity.y);
+    }
+    if (reader.readBool()) {
+      entity.clip = static_cast<Clip>(reader.read(clipBits));
+    }
+    entity.flipped = reader.readBool();
+    if (entity.typeId >= tileTypes.size() || entity.clip > Clip::Hit) {
+      return std::nullopt;
+    }
+  }
+
+  snapshot.edits.resize(editCount);
+  TileEdit previous;
+  for (auto &edit : snapshot.edits) {
+    edit.x = readDelta(reader, previous.x);
+    edit.y = readDelta(reader, previous.y);
+    edit.wall = reader.readBool();
+    edit.level = reader.readBool();
+    if (reader.readBool()) {
+      edit.typeId = static_cast<TileTypeId>(reader.read(typeIdBits));
+      if (*edit.typeId >= tileTypes.size()) {
+        return std::nullopt;
+      }
+    }
+    previous = edit;
+  }
+
+  if (reader.failed()) {
+    return std::nullopt;
+  }
+  return snapshot;
+}
@@ -0,0 +1,463 @@
+module;
+
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+export module snapshotLink;
+
+import snapshot;
+
+/// the bytes of a frame length and of an acknowledgement
+inline constexpr size_t wordSize{4};
+/// the number of snapshots kept as baselines
+inline constexpr size_t historySize{32};
+
+/// write a word in little endian
+auto appendWord(std::vector<std::uint8_t> &bytes, std::uint32_t value)
+    -> void {
+  constexpr unsigned byteBits{8};
+  for (size_t index = 0; index < wordSize; ++index) {
+    bytes.push_back(static_cast<std::uint8_t>(value >> (index * byteBits)));
+  }
+}
+
+/// read a word written by appendWord
+auto readWord(std::span<const std::uint8_t> bytes) noexcept -> std::uint32_t {
+  constexpr unsigned byteBits{8};
+  std::uint32_t value{};
+  for (size_t index = 0; index < wordSize; ++index) {
+    value |= static_cast<std::uint32_t>(bytes[index]) << (index * byteBits);
+  }
+  return value;
+}
+
+/// close a socket, if it is open
+auto closeSocket(int socket) noexcept -> void {
+#if defined(__linux__)
+  if (socket >= 0) {
+    close(socket);
+  }
+#endif
+}
+
+/// publishes the snapshots of an authoritative simulation to the observers
+/// connected to a loopback port
+///
+/// each snapshot is sent as a length prefixed frame, delta compressed against
+/// the last snapshot the observer acknowledged. An observer still receiving a
+/// frame is skipped, so a slow observer gets fewer but larger deltas and
+/// never delays the simulation. Where sockets are not available nothing is
+/// published
+export class SnapshotServer {
+public:
+  /// constructor
+  ///
+  /// \param[in] Port the loopback port the observers connect to
+  explicit SnapshotServer(std::uint16_t port);
+
+  SnapshotServer(const SnapshotServer &) = delete;
+  SnapshotServer(SnapshotServer &&) = delete;
+  auto operator=(const SnapshotServer &) -> SnapshotServer & = delete;
+  auto operator=(SnapshotServer &&) -> SnapshotServer & = delete;
+
+  ~SnapshotServer();
+
+  /// whether the port could be listened on
+  [[nodiscard]] auto isListening() const noexcept -> bool {
+    return listener_ >= 0;
+  }
+
+  /// place or remove a tile, sent with the next snapshot
+  auto recordEdit(const TileEdit &edit) -> void;
+
+  /// replace every tile, when a level is loaded
+  ///
+  /// \param[in] Tiles the tiles of the level
+  auto resetTiles(std::span<const TileEdit> tiles) -> void;
+
+  /// send the state of a tick to every observer
+  ///
+  /// \param[in] Entities the characters, in the same order at every tick
+  auto publish(std::vector<EntityState> entities) -> void;
+
+  /// the number of observers connected
+  [[nodiscard]] auto observers() const noexcept -> size_t {
+    return observers_.size();
+  }
+
+private:
+  /// an observer connection
+  struct Observer {
+    int socket{-1};
+    /// the last tick the observer acknowledged
+    std::optional<std::uint32_t> acked;
+    /// the frame being sent and the number of its bytes sent
+    std::vector<std::uint8_t> frame;
+    size_t sent{};
+    /// the bytes of an acknowledgement received so far
+    std::array<std::uint8_t, wordSize> ack{};
+    size_t ackBytes{};
+  };
+
+  /// the key sorting the tiles by layer then in row order
+  using TileKey = std::tuple<bool, std::int32_t, std::int32_t>;
+
+  /// accept the new observers
+  auto accept() -> void;
+  /// read the acknowledgements and send the rest of the frames
+  ///
+  /// \return false if the observer disconnected
+  auto service(Observer &observer) -> bool;
+  /// the snapshot for an observer, relative to the one it acknowledged
+  auto snapshotFor(const Observer &observer, const Snapshot &current) const
+      -> std::pair<Snapshot, const Snapshot *>;
+
+  int listener_{-1};
+  std::vector<Observer> observers_;
+
+  std::uint32_t tick_{};
+  /// the first tick after the last reset of the tiles, older baselines miss
+  /// it
+  std::uint32_t resetTick_{};
+  std::deque<Snapshot> history_;
+  std::map<TileKey, TileEdit> tiles_;
+  /// the edits not older than the oldest snapshot of history_, with their
+  /// tick
+  std::vector<std::pair<std::uint32_t, TileEdit>> edits_;
+};
+
+SnapshotServer::SnapshotServer(std::uint16_t port) {
+#if defined(__linux__)
+  listener_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listener_ < 0) {
+    return;
+  }
+  const int reuse{1};
+  setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(listener_, reinterpret_cast<const sockaddr *>(&address),
+           sizeof(address)) != 0 ||
+      listen(listener_, SOMAXCONN) != 0) {
+    closeSocket(listener_);
+    listener_ = -1;
+  }
+#endif
+}
+
+SnapshotServer::~SnapshotServer() {
+  for (const auto &observer : observers_) {
+    closeSocket(observer.socket);
+  }
+  closeSocket(listener_);
+}
+
+auto SnapshotServer::recordEdit(const TileEdit &edit) -> void {
+  const TileKey key{edit.wall, edit.y, edit.x};
+  if (edit.typeId) {
+    tiles_.insert_or_assign(key, edit);
+  } else {
+    tiles_.erase(key);
+  }
+  edits_.emplace_back(tick_ + 1, edit);
+}
+
+auto SnapshotServer::resetTiles(std::span<const TileEdit> tiles) -> void {
+  tiles_.clear();
+  for (const auto &tile : tiles) {
+    tiles_.insert_or_assign(TileKey{tile.wall, tile.y, tile.x}, tile);
+  }
+  edits_.clear();
+  resetTick_ = tick_ + 1;
+}
+
+auto SnapshotServer::snapshotFor(const Observer &observer,
+                                 const Snapshot &current) const
+    -> std::pair<Snapshot, const Snapshot *> {
+  const auto baseline = std::ranges::find_if(
+      history_, [&observer, this](const Snapshot &snapshot) {
+        return snapshot.tick == observer.acked && snapshot.tick >= resetTick_;
+      });
+
+  Snapshot snapshot{.tick = current.tick,
+                    .entities = current.entities,
+                    .resetTiles = baseline == history_.end(),
+                    .edits = {}};
+  if (snapshot.resetTiles) {
+    for (const auto &[key, tile] : tiles_) {
+      snapshot.edits.push_back(tile);
+    }
+    return {std::move(snapshot), nullptr};
+  }
+  for (const auto &[tick, edit] : edits_) {
+    if (tick > baseline->tick) {
+      snapshot.edits.push_back(edit);
+    }
+  }
+  return {std::move(snapshot), &*baseline};
+}
+
+auto SnapshotServer::publish(std::vector<EntityState> entities) -> void {
+  ++tick_;
+  accept();
+  std::erase_if(observers_, [this](Observer &observer) {
+    if (service(observer)) {
+      return false;
+    }
+    closeSocket(observer.socket);
+    return true;
+  });
+
+  const Snapshot current{.tick = tick_,
+                         .entities = std::move(entities),
+                         .resetTiles = false,
+                         .edits = {}};
+  for (auto &observer : observers_) {
+    if (!observer.frame.empty()) {
+      continue;
+    }
+    const auto [snapshot, baseline] = snapshotFor(observer, current);
+    const auto encoded = encodeSnapshot(snapshot, baseline);
+    if (!encoded) {
+      continue;
+    }
+    appendWord(observer.frame, static_cast<std::uint32_t>(encoded->size()));
+    observer.frame.insert(observer.frame.end(), encoded->begin(),
+                          encoded->end());
+    observer.sent = 0;
+    // a disconnection is seen at the next publish
+    service(observer);
+  }
+
+  history_.push_back(current);
+  if (history_.size() > historySize) {
+    history_.pop_front();
+  }
+  std::erase_if(edits_, [this](const auto &edit) {
+    return edit.first <= history_.front().tick;
+  });
+}
+
+auto SnapshotServer::accept() -> void {
+#if defined(__linux__)
+  if (listener_ < 0) {
+    return;
+  }
+  for (auto client = accept4(listener_, nullptr, nullptr,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC);
+       client >= 0; client = accept4(listener_, nullptr, nullptr,
+                                     SOCK_NONBLOCK | SOCK_CLOEXEC)) {
+    const int noDelay{1};
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    observers_.emplace_back().socket = client;
+  }
+#endif
+}
+
+auto SnapshotServer::service(Observer &observer) -> bool {
+#if defined(__linux__)
+  for (;;) {
+    const auto size =
+        recv(observer.socket, observer.ack.data() + observer.ackBytes,
+             wordSize - observer.ackBytes, 0);
+    if (size == 0) {
+      return false;
+    }
+    if (size < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        return false;
+      }
+      break;
+    }
+    observer.ackBytes += static_cast<size_t>(size);
+    if (observer.ackBytes == wordSize) {
+      observer.acked = readWord(observer.ack);
+      observer.ackBytes = 0;
+    }
+  }
+
+  while (observer.sent < observer.frame.size()) {
+    const auto size = send(observer.socket,
+                           observer.frame.data() + observer.sent,
+                           observer.frame.size() - observer.sent, MSG_NOSIGNAL);
+    if (size < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    observer.sent += static_cast<size_t>(size);
+  }
+  observer.frame.clear();
+#endif
+  return true;
+}
+
+/// receives the snapshots of a SnapshotServer and acknowledges them
+export class SnapshotClient {
+public:
+  /// constructor
+  ///
+  /// \param[in] Port the loopback port of the server
+  explicit SnapshotClient(std::uint16_t port);
+
+  SnapshotClient(const SnapshotClient &) = delete;
+  SnapshotClient(SnapshotClient &&) = delete;
+  auto operator=(const SnapshotClient &) -> SnapshotClient & = delete;
+  auto operator=(SnapshotClient &&) -> SnapshotClient & = delete;
+
+  ~SnapshotClient() { closeSocket(socket_); }
+
+  /// whether the client is connected to the server
+  [[nodiscard]] auto isConnected() const noexcept -> bool {
+    return socket_ >= 0;
+  }
+
+  /// read the snapshots received since the last call
+  ///
+  /// \return the last snapshot, with the edits of every snapshot received,
+  ///   nullopt if none was received
+  auto receive() -> std::optional<Snapshot>;
+
+private:
+  /// decode a frame and add its entities to the history
+  auto decode(std::span<const std::uint8_t> frame) -> std::optional<Snapshot>;
+
+  int socket_{-1};
+  /// the bytes received not yet decoded
+  std::vector<std::uint8_t> received_;
+  std::deque<Snapshot> history_;
+};
+
+SnapshotClient::SnapshotClient(std::uint16_t port) {
+#if defined(__linux__)
+  socket_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (socket_ < 0) {
+    return;
+  }
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(socket_, reinterpret_cast<const sockaddr *>(&address),
+              sizeof(address)) != 0) {
+    closeSocket(socket_);
+    socket_ = -1;
+    return;
+  }
+  fcntl(socket_, F_SETFL, fcntl(socket_, F_GETFL) | O_NONBLOCK);
+  const int noDelay{1};
+  setsockopt(socket_, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+#endif
+}
+
+auto SnapshotClient::decode(std::span<const std::uint8_t> frame)
+    -> std::optional<Snapshot> {
+  const auto header = readSnapshotHeader(frame);
+  if (!header) {
+    return std::nullopt;
+  }
+  const Snapshot *baseline{};
+  if (header->baselineTick) {
+    const auto found =
+        std::ranges::find(history_, *header->baselineTick, &Snapshot::tick);
+    if (found == history_.end()) {
+      return std::nullopt;
+    }
+    baseline = &*found;
+  }
+
+  auto snapshot = decodeSnapshot(frame, baseline);
+  if (!snapshot) {
+    return std::nullopt;
+  }
+  // the baselines only need the entities, a level is only kept once
+  history_.push_back({.tick = snapshot->tick,
+                      .entities = snapshot->entities,
+                      .resetTiles = false,
+                      .edits = {}});
+  if (history_.size() > historySize) {
+    history_.pop_front();
+  }
+  return snapshot;
+}
+
+auto SnapshotClient::receive() -> std::optional<Snapshot> {
+#if defined(__linux__)
+  if (socket_ < 0) {
+    return std::nullopt;
+  }
+
+  constexpr size_t chunkSize{65536};
+  for (;;) {
+    const auto offset = received_.size();
+    received_.resize(offset + chunkSize);
+    const auto size = recv(socket_, received_.data() + offset, chunkSize, 0);
+    received_.resize(offset + static_cast<size_t>(std::max(size, ssize_t{0})));
+    if (size == 0 || (size < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+      closeSocket(socket_);
+      socket_ = -1;
+      break;
+    }
+    if (size < 0) {
+      break;
+    }
+  }
+
+  std::optional<Snapshot> latest;
+  size_t next{};
+  while (received_.size() - next >= wordSize) {
+    const auto length = readWord(std::span{received_}.subspan(next));
+    if (received_.size() - next - wordSize < length) {
+      break;
+    }
+    auto snapshot =
+        decode(std::span{received_}.subspan(next + wordSize, length));
+    next += wordSize + length;
+    if (!snapshot) {
+      continue;
+    }
+
+    // a reset drops the edits received before it
+    if (!latest || snapshot->resetTiles) {
+      latest = std::move(snapshot);
+    } else {
+      latest->tick = snapshot->tick;
+      latest->entities = std::move(snapshot->entities);
+      latest->edits.insert(latest->edits.end(), snapshot->edits.begin(),
+                           snapshot->edits.end());
+    }
+  }
+  received_.erase(received_.begin(),
+                  received_.begin() + static_cast<std::ptrdiff_t>(next));
+
+  if (latest && socket_ >= 0) {
+    std::vector<std::uint8_t> ack;
+    appendWord(ack, latest->tick);
+    send(socket_, ack.data(), ack.size(), MSG_NOSIGNAL);
+  }
+  return latest;
+#else
+  return std::nullopt;
+#endif
+}
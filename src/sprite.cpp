@@ -2,52 +2,81 @@ module;
 
 #include "SDL3/SDL_rect.h"
 
-#include <SDL3_image/SDL_image.h>
-
-#include <cmath>
 #include <string>
-#include <utility>
 
 export module sprite;
 import tile;
-import sdlHelpers;
+import tileTypes;
+import animation;
+import drawList;
+import memory;
 
 export class CharacterSprite final : public Renderable {
 public:
-  CharacterSprite(std::string name, const SDL_FRect &rect, bool canRun,
-                  bool canHit);
-
-  CharacterSprite(const CharacterSprite &) = default;
+  /// constructor
+  ///
+  /// \param[in] TypeId the type of the character, the clips of its
+  /// animations are taken from it
+  /// \param[in] Animations the system playing the character animations
+  CharacterSprite(TileTypeId typeId, AnimationSystem &animations);
+
+  /// a copy plays its own animation, from the state of the one copied
+  CharacterSprite(const CharacterSprite &other);
   CharacterSprite(CharacterSprite &&) = delete;
-  auto operator=(const CharacterSprite &) -> CharacterSprite & = default;
+  auto operator=(const CharacterSprite &other) -> CharacterSprite &;
   auto operator=(CharacterSprite &&) -> CharacterSprite & = delete;
 
-  ~CharacterSprite() override = default;
+  ~CharacterSprite() override { animations_->remove(animation_); }
 
-  [[nodiscard]] auto getIdleTextureRect() const noexcept -> SDL_FRect;
-  [[nodiscard]] auto getRunTextureRect() const noexcept -> SDL_FRect;
-  [[nodiscard]] auto getHitTextureRect() const noexcept -> SDL_FRect;
-  [[nodiscard]] auto getTextureRect() -> SDL_FRect;
+  /// get the area in the texture of the frame being played
+  [[nodiscard]] auto getTextureRect() const noexcept -> SDL_FRect;
   [[nodiscard]] auto getDestRect() const noexcept -> SDL_FRect;
 
   auto serialize(std::ostream &ostream) -> void override {}
 
   [[nodiscard]] auto name() const noexcept -> std::string override {
-    return renderableName_;
+    return std::string{type().name};
+  }
+
+  /// get the type of the character
+  [[nodiscard]] auto type() const noexcept -> const TileType & {
+    return tileType(typeId_);
+  }
+  [[nodiscard]] auto typeId() const noexcept -> TileTypeId { return typeId_; }
+  /// change the type of the character, it plays its idle clip again
+  auto setType(TileTypeId typeId) -> void {
+    typeId_ = typeId;
+    animations_->setType(animation_, typeId);
   }
 
-  auto incIndex();
+  /// get the handle of the character animation
+  [[nodiscard]] auto animation() const noexcept -> AnimationId {
+    return animation_;
+  }
 
-  auto setHit() { hit_ = true; }
+  auto setHit() { animations_->play(animation_, Clip::Hit); }
   auto setRunning(bool dir) {
-    this->running_ = true;
+    animations_->play(animation_, Clip::Run);
     direction_ = dir;
   }
-  auto setRunning() { this->running_ = true; }
-  auto setIdle() { this->running_ = false; }
+  auto setRunning() { animations_->play(animation_, Clip::Run); }
+  auto setIdle() { animations_->play(animation_, Clip::Idle); }
+  [[nodiscard]] auto isRunning() const noexcept -> bool {
+    return animations_->clip(animation_) == Clip::Run;
+  }
+  /// get the clip being played
+  [[nodiscard]] auto clip() const noexcept -> Clip {
+    return animations_->clip(animation_);
+  }
+  /// whether the character faces left
+  [[nodiscard]] auto isFlipped() const noexcept -> bool { return direction_; }
+  /// play a clip facing a direction, as another simulation does
+  auto play(Clip clip, bool flipped) -> void {
+    animations_->play(animation_, clip);
+    direction_ = flipped;
+  }
 
-  auto render(const SdlRenderer &renderer, const SdlTexturePtr &texture,
-              size_t frameCount) -> void override;
+  auto render(DrawList &drawList, size_t frameCount) -> void override;
 
   [[nodiscard]] auto isSamePos(const SDL_FPoint &pos) const -> bool override {
     return renderablePos_.x == pos.x && renderablePos_.y == pos.y;
@@ -56,101 +85,69 @@ public:
   auto setPos(const SDL_FPoint &pos) noexcept -> void { renderablePos_ = pos; };
   [[nodiscard]] auto getPos() const noexcept -> SDL_FPoint override {
     return {renderablePos_.x,
-            renderablePos_.y + (renderableLevel_ ? sourceRect_.h : 0)};
+            renderablePos_.y + (renderableLevel_ ? sourceRect(typeId_).h : 0)};
   }
 
 private:
-  static constexpr float runFrameIndex = 4;
-  static constexpr float hitFrameIndex = 8;
-  static constexpr float animationFrameNumber = 4;
-
-  float index_{};
-  bool hit_{};
-  bool running_{};
   bool direction_{};
-  bool canRun_;
-  bool canHit_;
-  int hitFrame_ = 0;
-
-  std::string renderableName_;
-  /// the Renderable rectangle area in the texture
-  SDL_FRect sourceRect_{};
-  /// whether the Renderable is animated
-  bool renderableIsAnimated_{};
+
+  /// the system playing the animation
+  AnimationSystem *animations_;
+  /// the handle of the animation in animations_
+  AnimationId animation_;
+
+  /// the type of the character
+  TileTypeId typeId_;
   /// The renderable position on the screen
   SDL_FPoint renderablePos_{};
   /// whether the Renderable is on the ground or in the air
   bool renderableLevel_{};
 };
 
-CharacterSprite::CharacterSprite(std::string name, const SDL_FRect &rect,
-                                 bool canRun, bool canHit)
-    : renderableName_{std::move(name)}, sourceRect_{rect},
-      canRun_{canRun}, canHit_{canHit} {}
-
-auto CharacterSprite::getIdleTextureRect() const noexcept -> SDL_FRect {
-
-  return {sourceRect_.x + (index_ * sourceRect_.w),
-          sourceRect_.y, sourceRect_.w,
-          sourceRect_.h};
-}
-
-auto CharacterSprite::getRunTextureRect() const noexcept -> SDL_FRect {
-  return {sourceRect_.x +
-              ((runFrameIndex + index_) * sourceRect_.w),
-          sourceRect_.y, sourceRect_.w,
-          sourceRect_.h};
-}
-
-auto CharacterSprite::getHitTextureRect() const noexcept -> SDL_FRect {
-  return {sourceRect_.x + (hitFrameIndex * sourceRect_.w),
-          sourceRect_.y, sourceRect_.w,
-          sourceRect_.h};
-}
-
-auto CharacterSprite::getTextureRect() -> SDL_FRect {
-  if (canHit_ && hit_) {
-    if (++hitFrame_ == 2) {
-      hitFrame_ = 0;
-      hit_ = false;
-    }
-    return getHitTextureRect();
-  }
-
-  if (canRun_ && running_) {
-    return getRunTextureRect();
+/// the characters of the palette, accounted to the sprites
+export using CharacterSprites =
+    TrackedVector<CharacterSprite, MemoryTag::Sprites>;
+
+CharacterSprite::CharacterSprite(TileTypeId typeId,
+                                 AnimationSystem &animations)
+    : animations_{&animations}, animation_{animations.add(typeId)},
+      typeId_{typeId} {}
+
+CharacterSprite::CharacterSprite(const CharacterSprite &other)
+    : Renderable{other}, direction_{other.direction_},
+      animations_{other.animations_},
+      animation_{other.animations_->copy(other.animation_)},
+      typeId_{other.typeId_}, renderablePos_{other.renderablePos_},
+      renderableLevel_{other.renderableLevel_} {}
+
+auto CharacterSprite::operator=(const CharacterSprite &other)
+    -> CharacterSprite & {
+  if (this == &other) {
+    return *this;
   }
-
-  return getIdleTextureRect();
+  const auto animation = other.animations_->copy(other.animation_);
+  animations_->remove(animation_);
+  direction_ = other.direction_;
+  animations_ = other.animations_;
+  animation_ = animation;
+  typeId_ = other.typeId_;
+  renderablePos_ = other.renderablePos_;
+  renderableLevel_ = other.renderableLevel_;
+  return *this;
 }
 
-auto CharacterSprite::getDestRect() const noexcept -> SDL_FRect {
-  const SDL_FRect pos{.x = renderablePos_.x * 2,
-                      .y = (renderablePos_.y - sourceRect_.h) * 2};
-
-  return {pos.x, pos.y, sourceRect_.w * 2,
-          sourceRect_.h * 2};
+auto CharacterSprite::getTextureRect() const noexcept -> SDL_FRect {
+  const auto frame = static_cast<float>(animations_->frame(animation_));
+  const auto &rect = sourceRect(typeId_);
+  return {rect.x + (frame * rect.w), rect.y, rect.w, rect.h};
 }
 
-auto CharacterSprite::incIndex() {
-  index_ = std::fmod(++index_, animationFrameNumber);
+auto CharacterSprite::getDestRect() const noexcept -> SDL_FRect {
+  const auto &rect = sourceRect(typeId_);
+  return {renderablePos_.x, renderablePos_.y - rect.h, rect.w, rect.h};
 }
 
-auto CharacterSprite::render(const SdlRenderer &renderer,
-                             const SdlTexturePtr &texture, size_t frameCount)
+auto CharacterSprite::render(DrawList &drawList, size_t /*frameCount*/)
     -> void {
-  if (frameCount % 2 == 0) {
-    incIndex();
-  }
-
-  const auto destRect = getDestRect();
-  const auto sourceTextureRect = getTextureRect();
-
-  if (direction_) {
-    const SDL_FPoint center{0, 0};
-    renderer.renderTextureRotated(texture, sourceTextureRect, destRect, 0,
-                                  center, SDL_FLIP_HORIZONTAL);
-  } else {
-    renderer.renderTexture(texture, sourceTextureRect, destRect);
-  }
+  drawList.sprite(getTextureRect(), getDestRect(), direction_);
 }
@@ -1,51 +1,69 @@
 module;
 
 #include "SDL3/SDL_rect.h"
-#include "SDL3/SDL_render.h"
 
 #include <cmath>
+#include <concepts>
+#include <istream>
 #include <memory>
+#include <ostream>
 #include <string>
+#include <string_view>
 #include <utility>
 
 export module tile;
-import sdlHelpers;
+import sdlStreams;
+import tileTypes;
+import drawList;
+import memory;
+
+/// snap a world position to the grid cell under it
+///
+/// a tile position is the bottom left corner of its cell
+///
+/// \param[in] Pos the position in the world
+/// \param[in] GridSize the side of a cell in world units
+/// \return the position of a tile placed in the cell
+export auto snapToGrid(const SDL_FPoint &pos, float gridSize) noexcept
+    -> SDL_FPoint {
+  return {std::floor(pos.x / gridSize) * gridSize,
+          (std::floor(pos.y / gridSize) * gridSize) + gridSize};
+}
 
 /// renderer concept
+///
+/// a renderer is built from the type of the tile it renders, so per-type
+/// constants come from the tile type table
 export template <class Type>
 concept isRenderer =
-    requires(Type type, const SdlRenderer &renderer,
-             const SdlTexturePtr &texture, const SDL_FRect &rect,
+    std::constructible_from<Type, const TileType &> &&
+    requires(Type type, DrawList &drawList, const SDL_FRect &rect,
              const SDL_FPoint &pos, size_t frameCount) {
-      { type.render(renderer, texture, rect, pos, frameCount) };
+      { type.render(drawList, rect, pos, frameCount) };
     };
 
 /// renderer for static sprite
 export class StaticRenderer {
 public:
+  /// constructor
+  explicit StaticRenderer(const TileType & /*unused*/) {}
+
   /// render the static sprite to the screen
   ///
-  /// \param[in] Renderer the renderer to use to render the static sprite to the
-  /// screen
-  /// \param[in] Texture the texture to get the sprite from
+  /// \param[out] DrawList the draw list to add the static sprite to
   /// \param[in] SourceRect the source area for the static sprites
   /// \param[in] Pos the position on the screen where to render the static
   /// sprite
   /// \param[in] FrameCount the number of frame already rendered
-  static auto render(const SdlRenderer &renderer, const SdlTexturePtr &texture,
-                     const SDL_FRect &rect, const SDL_FPoint &pos,
-                     size_t frameCount) -> void;
+  static auto render(DrawList &drawList, const SDL_FRect &rect,
+                     const SDL_FPoint &pos, size_t frameCount) -> void;
 };
 
-auto StaticRenderer::render(const SdlRenderer &renderer,
-                            const SdlTexturePtr &texture, const SDL_FRect &rect,
+auto StaticRenderer::render(DrawList &drawList, const SDL_FRect &rect,
                             const SDL_FPoint &pos, size_t /*FrameCount*/)
     -> void {
 
-  const SDL_FRect destRect{pos.x * 2, (pos.y - rect.h) * 2, rect.w * 2,
-                           rect.h * 2};
-
-  renderer.renderTexture(texture, rect, destRect);
+  drawList.sprite(rect, {pos.x, pos.y - rect.h, rect.w, rect.h});
 }
 
 namespace {
@@ -59,24 +77,26 @@ auto operator<<(std::ostream &ostream, const StaticRenderer & /*unused*/)
 /// renderer for animated sprite
 export class AnimatedRenderer {
 public:
+  /// constructor
+  ///
+  /// \param[in] Type the type of the animated tile
+  explicit AnimatedRenderer(const TileType &type)
+      : frameNumber_{static_cast<float>(type.idleFrames)} {}
+
   /// render the animation sprite to the screen
   ///
-  /// \param[in] Renderer the renderer to use to render the animation sprite to
-  /// the screen
-  /// \param[in] Texture the texture to get the sprite from
+  /// \param[out] DrawList the draw list to add the animation sprite to
   /// \param[in] SourceRect the source area for the animation sprites
   /// \param[in] Pos the position on the screen where to render the animation
   /// sprite
   /// \param[in] FrameCount the number of frame already rendered
-  auto render(const SdlRenderer &renderer, const SdlTexturePtr &texture,
-              const SDL_FRect &sourceRect, const SDL_FPoint &pos,
-              size_t frameCount) -> void;
+  auto render(DrawList &drawList, const SDL_FRect &sourceRect,
+              const SDL_FPoint &pos, size_t frameCount) -> void;
 
 private:
-  static constexpr float frameNumber = 3;
-
-  float index_;      ///< the index in the animation fram list
-  size_t lastFrame_; ///< the last frame count rendered
+  float frameNumber_;  ///< the number of frames in the animation
+  float index_{};      ///< the index in the animation fram list
+  size_t lastFrame_{}; ///< the last frame count rendered
 };
 
 namespace {
@@ -92,25 +112,34 @@ auto operator<<(std::ostream &ostream, const AnimatedRenderer & /*unused*/)
 }
 } // namespace
 
-auto AnimatedRenderer::render(const SdlRenderer &renderer,
-                              const SdlTexturePtr &texture,
-                              const SDL_FRect &rect, const SDL_FPoint &pos,
-                              size_t frameCount) -> void {
+auto AnimatedRenderer::render(DrawList &drawList, const SDL_FRect &rect,
+                              const SDL_FPoint &pos, size_t frameCount)
+    -> void {
 
   if (lastFrame_ != frameCount && frameCount % 2 == 0) {
     lastFrame_ = frameCount;
-    index_ = std::fmod(++index_, frameNumber);
+    index_ = std::fmod(++index_, frameNumber_);
   }
 
-  const SDL_FRect destRect{pos.x * 2, (pos.y - rect.h) * 2, rect.w * 2,
-                           rect.h * 2};
+  const SDL_FRect destRect{pos.x, pos.y - rect.h, rect.w, rect.h};
 
   const SDL_FRect sourceRect{(index_ * rect.w) + rect.x, rect.y, rect.w,
                              rect.h};
 
-  renderer.renderTexture(texture, sourceRect, destRect);
+  drawList.sprite(sourceRect, destRect);
 }
 
+/// the renderer used for a class of tile
+///
+/// \tparam Class the class of the tile
+export template <TileClass Class> struct RendererFor {
+  using Type = StaticRenderer;
+};
+
+template <> struct RendererFor<TileClass::AnimatedTerrain> {
+  using Type = AnimatedRenderer;
+};
+
 export class Renderable {
 public:
   Renderable() = default;
@@ -128,11 +157,9 @@ public:
 
   /// render the Renderable to the screen
   ///
-  /// \param[in] Renderer the renderer used to render the renderable
-  /// \param[in] Texture the texture containing the Renderable sprite
+  /// \param[out] DrawList the draw list to add the Renderable sprite to
   /// \param[in] FrameCount the number of frame already drawn to the screen
-  virtual auto render(const SdlRenderer &renderer, const SdlTexturePtr &texture,
-                      size_t frameCount) -> void = 0;
+  virtual auto render(DrawList &drawList, size_t frameCount) -> void = 0;
 
   /// serialize the Renderable to an ostream
   virtual auto serialize(std::ostream &) -> void = 0;
@@ -146,7 +173,39 @@ export auto operator<<(std::ostream &ostream, Renderable &renderable)
   return ostream;
 }
 
-export class TileConcrete : public Renderable {};
+/// plain copy of a placed tile, cheap to take and safe to hand to another
+/// thread
+export struct TileRecord {
+  /// the type of the tile
+  TileTypeId typeId{};
+  /// the tile position
+  SDL_FPoint pos{};
+  /// whether the tile is on the ground or in the air
+  bool level{};
+};
+
+/// write a TileRecord in the same form as Tile::serialize
+export auto operator<<(std::ostream &ostream, const TileRecord &record)
+    -> std::ostream & {
+  const auto &type = tileType(record.typeId);
+  ostream << type.name << ' '
+          << (type.tileClass == TileClass::AnimatedTerrain ? "animated"
+                                                           : "static")
+          << ' ' << type.sourceRect << ' ' << record.pos << ' '
+          << record.level;
+  return ostream;
+}
+
+/// a placed tile, its memory is accounted to the tiles
+export class TileConcrete : public Renderable,
+                            public Tracked<MemoryTag::Tiles> {
+public:
+  /// copy the tile state into a TileRecord
+  [[nodiscard]] virtual auto record() const -> TileRecord = 0;
+
+  /// change the type of the tile, to a type of the same class
+  virtual auto setTypeId(TileTypeId typeId) -> void = 0;
+};
 
 /// concrete renderable class for tiles
 ///
@@ -154,38 +213,71 @@ export class TileConcrete : public Renderable {};
 export template <class RendererType>
   requires isRenderer<RendererType>
 class Tile : public TileConcrete {
-  friend auto operator<<(std::ostream &ostream, const Tile<RendererType> &tile)
-      -> std::ostream &;
-  friend auto operator>>(std::istream &istream, Tile<RendererType> &tile)
-      -> std::istream &;
+  /// write a tile in the form of serialize
+  friend auto operator<<(std::ostream &ostream, const Tile &tile)
+      -> std::ostream & {
+    ostream << tile.type().name << ' ' << tile.tileRenderer_ << ' '
+            << tile.type().sourceRect << ' ' << tile.renderablePos_ << ' '
+            << tile.renderableLevel_;
+    return ostream;
+  }
 
-public:
-  /// default constructor
-  Tile() = default;
+  /// read a tile in the form of serialize
+  ///
+  /// the source rect is taken from the tile type table, the read fails if
+  /// the name is not a known tile type
+  friend auto operator>>(std::istream &istream, Tile &tile) -> std::istream & {
+    const auto streamPos = istream.tellg();
+    std::string name;
+    std::string renderer;
+    SDL_FRect sourceRect;
+    SDL_FPoint pos;
+    bool level{};
+
+    istream >> name >> renderer >> sourceRect >> pos >> level;
+
+    const auto typeId = findTileType(name);
+    if (!istream || !typeId) {
+      istream.clear();
+      istream.seekg(streamPos);
+      istream.setstate(std::ios_base::failbit);
+      return istream;
+    }
+
+    tile.typeId_ = *typeId;
+    tile.tileRenderer_ = RendererType{tileType(*typeId)};
+    tile.renderablePos_ = pos;
+    tile.renderableLevel_ = level;
+    return istream;
+  }
 
+public:
   /// constructor
   ///
-  /// \param[in] Name the name of the Renderable
-  /// \param[in] Rect the Renderable source area in the texture
-  Tile(std::string name, const SDL_FRect &rect, const SDL_FPoint &pos,
-       bool level);
+  /// \param[in] TypeId the type of the tile
+  /// \param[in] Pos the tile position
+  /// \param[in] Level whether the tile is on the ground or in the air
+  Tile(TileTypeId typeId, const SDL_FPoint &pos, bool level);
 
   [[nodiscard]] auto name() const noexcept -> std::string override {
-    return name_;
+    return std::string{type().name};
   }
 
   [[nodiscard]] auto getPos() const noexcept -> SDL_FPoint override {
     return {renderablePos_.x,
-            renderablePos_.y + (renderableLevel_ ? sourceRect_.h : 0)};
+            renderablePos_.y + (renderableLevel_ ? sourceRect(typeId_).h : 0)};
+  }
+
+  /// get the type of the tile
+  [[nodiscard]] auto type() const noexcept -> const TileType & {
+    return tileType(typeId_);
   }
 
   /// render the renderable to the screen
   ///
-  /// \param[in] Renderer the renderer used to render to the screen
-  /// \param[in] Texture the texture to get the renderable sprite from
+  /// \param[out] DrawList the draw list to add the renderable sprite to
   /// \param[in] FrameCount the number of frame already drawn
-  auto render(const SdlRenderer &renderer, const SdlTexturePtr &texture,
-              size_t frameCount) -> void override;
+  auto render(DrawList &drawList, size_t frameCount) -> void override;
 
   /// serialize the Renderable to an output stream
   ///
@@ -193,8 +285,18 @@ public:
   /// RenderableName RendererType RenderableSourceRect RenderablePos
   /// RenderableLevel
   auto serialize(std::ostream &ostream) -> void override {
-    ostream << name_ << ' ' << tileRenderer_ << ' ' << sourceRect_ << ' '
-            << renderablePos_ << ' ' << renderableLevel_;
+    ostream << std::as_const(*this);
+  }
+
+  [[nodiscard]] auto record() const -> TileRecord override {
+    return {.typeId = typeId_,
+            .pos = renderablePos_,
+            .level = renderableLevel_};
+  }
+
+  auto setTypeId(TileTypeId typeId) -> void override {
+    typeId_ = typeId;
+    tileRenderer_ = RendererType{tileType(typeId)};
   }
 
   auto setLevel(bool level) -> void { renderableLevel_ = level; }
@@ -207,30 +309,27 @@ public:
   }
 
 private:
-  std::string name_;
+  /// the type of the tile in the tile type table
+  TileTypeId typeId_;
   RendererType tileRenderer_;
   /// whether the Renderable is on the ground or in the air
   bool renderableLevel_{};
 
   /// the Renderable Pos on the screen
   SDL_FPoint renderablePos_{};
-  /// the Renderable source rectangle on the texture
-  SDL_FRect sourceRect_{};
 };
 
 template <class R>
   requires isRenderer<R>
-Tile<R>::Tile(std::string name, const SDL_FRect &rect, const SDL_FPoint &pos,
-              bool level)
-    : name_{std::move(name)}, renderableLevel_{level}, renderablePos_{pos},
-      sourceRect_{rect} {}
+Tile<R>::Tile(TileTypeId typeId, const SDL_FPoint &pos, bool level)
+    : typeId_{typeId}, tileRenderer_{tileType(typeId)},
+      renderableLevel_{level}, renderablePos_{pos} {}
 
 template <class RendererType>
   requires isRenderer<RendererType>
-auto Tile<RendererType>::render(const SdlRenderer &renderer,
-                                const SdlTexturePtr &texture, size_t frameCount)
+auto Tile<RendererType>::render(DrawList &drawList, size_t frameCount)
     -> void {
-  tileRenderer_.render(renderer, texture, sourceRect_, renderablePos_,
+  tileRenderer_.render(drawList, sourceRect(typeId_), renderablePos_,
                        frameCount);
 }
 
@@ -245,63 +344,51 @@ public:
 
   /// constructor
   ///
-  /// \param[in] Name the name of the Renderable
-  /// \param[in] Animated whether the Renterable is animated
-  /// \param[in] SourceRect the source area for the renderable in the texture
-  RendererBuilder(std::string_view name, bool animated,
-                  const SDL_FRect &sourceRect)
-      : renderableName_{name}, renderableSourceRect_{sourceRect},
-        renderableIsAnimated_{animated} {}
+  /// \param[in] TypeId the type of the Renderable
+  explicit RendererBuilder(TileTypeId typeId) : typeId_{typeId} {}
 
   /// create the Renterable
-  auto build(const SDL_FPoint &pos, bool level)
+  auto build(const SDL_FPoint &pos, bool level) const
       -> std::unique_ptr<TileConcrete>;
-  auto build() -> std::unique_ptr<TileConcrete>;
+  auto build() const -> std::unique_ptr<TileConcrete>;
+
+  /// get the name of the Renderable, null terminated
+  [[nodiscard]] auto name() const -> std::string_view {
+    return tileType(typeId_).name;
+  }
 
-  /// get the name of the Renderable
-  auto name() -> const std::string & { return renderableName_; }
+  /// get the type of the Renderable
+  [[nodiscard]] auto typeId() const noexcept -> TileTypeId { return typeId_; }
 
 private:
-  /// the name of the Renderable
-  std::string renderableName_;
-  /// the Renderable rectangle area in the texture
-  SDL_FRect renderableSourceRect_{};
-  /// whether the Renderable is animated
-  bool renderableIsAnimated_{};
+  /// create a tile with the renderer of its class
+  template <TileClass Class>
+  auto makeTile(const SDL_FPoint &pos, bool level) const
+      -> std::unique_ptr<TileConcrete> {
+    return std::make_unique<Tile<typename RendererFor<Class>::Type>>(
+        typeId_, pos, level);
+  }
+
+  /// the type of the Renderable
+  TileTypeId typeId_{};
   /// The renderable position on the screen
   SDL_FPoint renderablePos_{};
   /// whether the Renderable is on the ground or in the air
   bool renderableLevel_{};
 };
 
-auto RendererBuilder::build(const SDL_FPoint &pos, bool level)
+auto RendererBuilder::build(const SDL_FPoint &pos, bool level) const
     -> std::unique_ptr<TileConcrete> {
-
-  std::unique_ptr<TileConcrete> renderable;
-  if (renderableIsAnimated_) {
-    renderable = std::make_unique<Tile<AnimatedRenderer>>(
-        renderableName_, renderableSourceRect_, pos, level);
-  } else {
-    renderable = std::make_unique<Tile<StaticRenderer>>(
-        renderableName_, renderableSourceRect_, pos, level);
+  switch (tileType(typeId_).tileClass) {
+  case TileClass::AnimatedTerrain:
+    return makeTile<TileClass::AnimatedTerrain>(pos, level);
+  default:
+    return makeTile<TileClass::Terrain>(pos, level);
   }
-
-  return renderable;
 }
-auto RendererBuilder::build() -> std::unique_ptr<TileConcrete> {
-
-  std::unique_ptr<TileConcrete> renderable;
-  if (renderableIsAnimated_) {
-    renderable = std::make_unique<Tile<AnimatedRenderer>>(
-        renderableName_, renderableSourceRect_, renderablePos_,
-        renderableLevel_);
-  } else {
-    renderable = std::make_unique<Tile<StaticRenderer>>(
-        renderableName_, renderableSourceRect_, renderablePos_,
-        renderableLevel_);
-  }
 
-  return renderable;
+auto RendererBuilder::build() const -> std::unique_ptr<TileConcrete> {
+  return build(renderablePos_, renderableLevel_);
 }
 
 /// read Builder from an input stream
@@ -311,25 +398,30 @@ auto RendererBuilder::build() -> std::unique_ptr<TileConcrete> {
 /// RenderableSourceRect = x y w h\n
 /// RenderablePos = x y
 ///
+/// the type and source rect are taken from the tile type table, the read
+/// fails if RenderableName is not a known tile type
+///
 /// \param &Builer the Builder to put the information to
 export auto operator>>(std::istream &istream, RendererBuilder &builder)
     -> std::istream & {
 
   auto streamPos = istream.tellg();
+  std::string name;
   std::string animated;
+  SDL_FRect sourceRect;
 
-  istream >> builder.renderableName_ >> animated >>
-      builder.renderableSourceRect_ >> builder.renderablePos_ >>
+  istream >> name >> animated >> sourceRect >> builder.renderablePos_ >>
       builder.renderableLevel_;
 
-  if (!istream) {
+  const auto typeId = findTileType(name);
+  if (!istream || !typeId) {
     istream.clear();
     istream.seekg(streamPos);
     istream.setstate(std::ios_base::failbit);
     return istream;
   }
 
-  builder.renderableIsAnimated_ = (animated == "animated");
+  builder.typeId_ = *typeId;
 
   return istream;
 }
@@ -0,0 +1,221 @@
+module;
+
+#include "SDL3/SDL_rect.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+export module tileOrder;
+
+import tile;
+
+/// a layer of tiles, kept in the order of their keys
+export using TileLayer = std::vector<std::unique_ptr<TileConcrete>>;
+
+/// the side of the cells the tiles are ordered by, in world units
+export inline constexpr float orderCellSize{16};
+
+/// the bits of the x coordinate in a key, the y ones are the odd bits
+inline constexpr std::uint64_t evenBits{0x5555'5555'5555'5555ULL};
+
+/// spread the bits of a coordinate to the even bits of a key
+constexpr auto spreadBits(std::uint32_t value) noexcept -> std::uint64_t {
+  std::uint64_t bits{value};
+  bits = (bits | (bits << 16U)) & 0x0000'FFFF'0000'FFFFULL;
+  bits = (bits | (bits << 8U)) & 0x00FF'00FF'00FF'00FFULL;
+  bits = (bits | (bits << 4U)) & 0x0F0F'0F0F'0F0F'0F0FULL;
+  bits = (bits | (bits << 2U)) & 0x3333'3333'3333'3333ULL;
+  bits = (bits | (bits << 1U)) & evenBits;
+  return bits;
+}
+
+/// gather the even bits of a key to a coordinate
+constexpr auto gatherBits(std::uint64_t bits) noexcept -> std::uint32_t {
+  bits &= evenBits;
+  bits = (bits | (bits >> 1U)) & 0x3333'3333'3333'3333ULL;
+  bits = (bits | (bits >> 2U)) & 0x0F0F'0F0F'0F0F'0F0FULL;
+  bits = (bits | (bits >> 4U)) & 0x00FF'00FF'00FF'00FFULL;
+  bits = (bits | (bits >> 8U)) & 0x0000'FFFF'0000'FFFFULL;
+  bits = (bits | (bits >> 16U)) & 0x0000'0000'FFFF'FFFFULL;
+  return static_cast<std::uint32_t>(bits);
+}
+
+/// the key of a cell on the z-order curve
+///
+/// the bits of the column and the row are interleaved, so the cells close on
+/// the grid are mostly close in the order, and every aligned square of 2^n
+/// cells is a single range of keys. The coordinates are offset so the
+/// negative cells come first
+///
+/// \param[in] Cell the cell, in cells
+export constexpr auto mortonKey(const SDL_Point &cell) noexcept
+    -> std::uint64_t {
+  constexpr std::uint32_t offset{0x8000'0000U};
+  return spreadBits(static_cast<std::uint32_t>(cell.x) ^ offset) |
+         (spreadBits(static_cast<std::uint32_t>(cell.y) ^ offset) << 1U);
+}
+
+/// the cell of a key of mortonKey
+export constexpr auto mortonCell(std::uint64_t key) noexcept -> SDL_Point {
+  constexpr std::uint32_t offset{0x8000'0000U};
+  return {static_cast<int>(gatherBits(key) ^ offset),
+          static_cast<int>(gatherBits(key >> 1U) ^ offset)};
+}
+
+/// the smallest key after a key out of a box that is in the box
+///
+/// the box is given by the keys of its first and last cells. The keys of the
+/// box are not contiguous, this finds where the next range of them starts
+/// without walking the keys in between (the BIGMIN of Tropf and Herzog)
+///
+/// \param[in] Key a key greater than first and out of the box
+/// \param[in] First the key of the top left cell of the box
+/// \param[in] Last the key of the bottom right cell of the box
+export constexpr auto nextKeyInBox(std::uint64_t key, std::uint64_t first,
+                                   std::uint64_t last) noexcept
+    -> std::uint64_t {
+  std::uint64_t next{};
+  for (auto bit = 64U; bit-- > 0;) {
+    const auto mask = std::uint64_t{1} << bit;
+    // the lower bits of the coordinate of this bit
+    const auto lower = (bit % 2 == 0 ? evenBits : ~evenBits) & (mask - 1);
+    // the bit set and the lower bits of its coordinate cleared, or the
+    // reverse
+    const auto rise = [mask, lower](std::uint64_t value) {
+      return (value & ~lower) | mask;
+    };
+    const auto fall = [mask, lower](std::uint64_t value) {
+      return (value & ~mask) | lower;
+    };
+
+    const bool keyBit = (key & mask) != 0;
+    const bool firstBit = (first & mask) != 0;
+    const bool lastBit = (last & mask) != 0;
+    if (!keyBit && !firstBit && lastBit) {
+      next = rise(first);
+      last = fall(last);
+    } else if (!keyBit && firstBit && lastBit) {
+      return first;
+    } else if (keyBit && !firstBit && !lastBit) {
+      return next;
+    } else if (keyBit && !firstBit && lastBit) {
+      first = rise(first);
+    }
+  }
+  return next;
+}
+
+/// the cell of a position on the order of the tiles
+export auto orderCell(const SDL_FPoint &pos) noexcept -> SDL_Point {
+  return {static_cast<int>(std::floor(pos.x / orderCellSize)),
+          static_cast<int>(std::floor(pos.y / orderCellSize))};
+}
+
+/// the key a tile is ordered by
+export auto tileKey(const TileConcrete &tile) noexcept -> std::uint64_t {
+  return mortonKey(orderCell(tile.getPos()));
+}
+
+/// compare the tiles by key, or a tile with a key
+struct KeyOrder {
+  auto operator()(const std::unique_ptr<TileConcrete> &tile,
+                  std::uint64_t key) const noexcept -> bool {
+    return tileKey(*tile) < key;
+  }
+  auto operator()(std::uint64_t key,
+                  const std::unique_ptr<TileConcrete> &tile) const noexcept
+      -> bool {
+    return key < tileKey(*tile);
+  }
+};
+
+/// put the tiles of a layer in the order of their keys
+///
+/// the tiles of a cell keep the order they had
+export auto sortTiles(TileLayer &layer) -> void {
+  std::vector<std::pair<std::uint64_t, std::unique_ptr<TileConcrete>>> keyed;
+  keyed.reserve(layer.size());
+  for (auto &tile : layer) {
+    const auto key = tileKey(*tile);
+    keyed.emplace_back(key, std::move(tile));
+  }
+  std::ranges::stable_sort(keyed, {}, [](const auto &entry) {
+    return entry.first;
+  });
+  for (size_t index = 0; index < keyed.size(); ++index) {
+    layer[index] = std::move(keyed[index].second);
+  }
+}
+
+/// add a tile after the tiles of its cell
+///
+/// \return the tile added
+export auto insertTile(TileLayer &layer, std::unique_ptr<TileConcrete> tile)
+    -> TileConcrete & {
+  const auto place =
+      std::upper_bound(layer.begin(), layer.end(), tileKey(*tile), KeyOrder{});
+  return **layer.insert(place, std::move(tile));
+}
+
+/// remove the tiles at a position
+///
+/// \return the number of tiles removed
+export auto eraseTiles(TileLayer &layer, const SDL_FPoint &pos) -> size_t {
+  const auto [first, last] = std::equal_range(
+      layer.begin(), layer.end(), mortonKey(orderCell(pos)), KeyOrder{});
+  const auto kept = std::remove_if(first, last, [pos](const auto &tile) {
+    return tile->isSamePos(pos);
+  });
+  const auto removed = static_cast<size_t>(std::distance(kept, last));
+  layer.erase(kept, last);
+  return removed;
+}
+
+/// visit the tiles whose position is in an area, in the order of the layer
+///
+/// the walk goes through the ranges of keys of the cells of the area and
+/// jumps over the tiles between them, so it touches the tiles around the
+/// area only
+///
+/// \param[in] Layer the tiles, in the order of their keys
+/// \param[in] Area the area, its right and bottom edges excluded
+/// \param[in] Visit called on each tile of the area
+export auto forEachTileIn(const TileLayer &layer, const SDL_FRect &area,
+                          const std::function<void(TileConcrete &)> &visit)
+    -> void {
+  if (area.w <= 0 || area.h <= 0) {
+    return;
+  }
+  const auto topLeft = orderCell({area.x, area.y});
+  const auto bottomRight = orderCell({area.x + area.w, area.y + area.h});
+  const auto first = mortonKey(topLeft);
+  const auto last = mortonKey(bottomRight);
+
+  auto iter = std::lower_bound(layer.begin(), layer.end(), first, KeyOrder{});
+  while (iter != layer.end()) {
+    const auto key = tileKey(**iter);
+    if (key > last) {
+      break;
+    }
+    const auto cell = mortonCell(key);
+    if (cell.x < topLeft.x || cell.x > bottomRight.x || cell.y < topLeft.y ||
+        cell.y > bottomRight.y) {
+      iter = std::lower_bound(iter, layer.end(),
+                              nextKeyInBox(key, first, last), KeyOrder{});
+      continue;
+    }
+    const auto pos = (*iter)->getPos();
+    if (pos.x >= area.x && pos.y >= area.y && pos.x < area.x + area.w &&
+        pos.y < area.y + area.h) {
+      visit(**iter);
+    }
+    ++iter;
+  }
+}
@@ -0,0 +1,63 @@
+module;
+
+#include "SDL3/SDL_rect.h"
+
+#include <algorithm>
+
+export module viewport;
+
+/// where the scene is shown in the window
+///
+/// the scene is drawn at the resolution of the art and scaled once to the
+/// window by the largest integer factor that fits, so every texel is a square
+/// of pixels. It is centered with bars around it, or cropped when the window
+/// is smaller than the scene
+export class Viewport {
+public:
+  /// constructor, the window starts the size of the scene
+  ///
+  /// \param[in] Scene the size of the scene in world units
+  explicit Viewport(const SDL_Point &scene) : scene_{scene} { resize(scene); }
+
+  /// fit the scene to a new window size
+  ///
+  /// \param[in] Output the size of the window in pixels
+  auto resize(const SDL_Point &output) noexcept -> void {
+    scale_ = std::max(std::min(output.x / scene_.x, output.y / scene_.y), 1);
+    const SDL_Point size{scene_.x * scale_, scene_.y * scale_};
+    rect_ = {static_cast<float>((output.x - size.x) / 2),
+             static_cast<float>((output.y - size.y) / 2),
+             static_cast<float>(size.x), static_cast<float>(size.y)};
+  }
+
+  /// get the world position under a window position
+  ///
+  /// \param[in] Pos the position in the window in pixels
+  [[nodiscard]] auto toScene(const SDL_FPoint &pos) const noexcept
+      -> SDL_FPoint {
+    const auto scale = static_cast<float>(scale_);
+    return {(pos.x - rect_.x) / scale, (pos.y - rect_.y) / scale};
+  }
+
+  /// whether a window position is on the scene rather than on the bars
+  ///
+  /// \param[in] Pos the position in the window in pixels
+  [[nodiscard]] auto contains(const SDL_FPoint &pos) const noexcept -> bool {
+    return pos.x >= rect_.x && pos.y >= rect_.y &&
+           pos.x < rect_.x + rect_.w && pos.y < rect_.y + rect_.h;
+  }
+
+  /// the size of the scene in world units
+  [[nodiscard]] auto scene() const noexcept -> SDL_Point { return scene_; }
+  /// the number of pixels of a world unit
+  [[nodiscard]] auto scale() const noexcept -> int { return scale_; }
+  /// the area of the window the scene is drawn to
+  [[nodiscard]] auto rect() const noexcept -> const SDL_FRect & {
+    return rect_;
+  }
+
+private:
+  SDL_Point scene_;
+  int scale_{1};
+  SDL_FRect rect_{};
+};
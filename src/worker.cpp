@@ -0,0 +1,58 @@
+module;
+
+#include <functional>
+#include <semaphore>
+#include <stop_token>
+#include <thread>
+#include <utility>
+
+export module worker;
+
+/// run a job on a dedicated thread each time it is started
+///
+/// the job is handed over with semaphores, neither the caller nor the worker
+/// take a lock
+export class WorkerThread {
+public:
+  /// constructor
+  ///
+  /// \param[in] Job the job to run on each start
+  explicit WorkerThread(std::function<void()> job)
+      : job_{std::move(job)},
+        thread_{[this](const std::stop_token &stopToken) { run(stopToken); }} {
+  }
+
+  WorkerThread(const WorkerThread &) = delete;
+  WorkerThread(WorkerThread &&) = delete;
+  auto operator=(const WorkerThread &) -> WorkerThread & = delete;
+  auto operator=(WorkerThread &&) -> WorkerThread & = delete;
+
+  ~WorkerThread() {
+    thread_.request_stop();
+    start_.release();
+  }
+
+  /// run the job once on the worker thread
+  auto start() -> void { start_.release(); }
+
+  /// wait for the job started last to be over
+  auto wait() -> void { done_.acquire(); }
+
+private:
+  auto run(const std::stop_token &stopToken) -> void {
+    while (true) {
+      start_.acquire();
+      if (stopToken.stop_requested()) {
+        return;
+      }
+      job_();
+      done_.release();
+    }
+  }
+
+  std::function<void()> job_;
+  std::binary_semaphore start_{0};
+  std::binary_semaphore done_{0};
+  /// declared last so it is joined before the other members are destroyed
+  std::jthread thread_;
+};
@@ -1,6 +1,946 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest/doctest.h>
 
-TEST_CASE("Example Test") {
-    CHECK(1 + 1 == 2);
+#include "SDL3/SDL_pixels.h"
+#include "SDL3/SDL_rect.h"
+#include "SDL3/SDL_render.h"
+#include "SDL3/SDL_surface.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <span>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+import tile;
+import tileTypes;
+import sdlHelpers;
+import drawList;
+import level;
+import damage;
+import animation;
+import snapshot;
+import script;
+import occlusion;
+import viewport;
+import image;
+import renderBackend;
+import memory;
+import dungeon;
+import tileOrder;
+import fileWatcher;
+import palette;
+import ai;
+import light;
+import scene;
+
+namespace {
+
+constexpr float gridSize = 16;
+
+auto checkSameRecord(const TileRecord& lhs, const TileRecord& rhs) -> void {
+    CHECK(lhs.typeId == rhs.typeId);
+    CHECK(lhs.pos.x == rhs.pos.x);
+    CHECK(lhs.pos.y == rhs.pos.y);
+    CHECK(lhs.level == rhs.level);
+}
+
+/// FNV-1a of the pixels of an image, each as its RGBA bytes
+auto hashPixels(const Image& image) -> std::uint64_t {
+    constexpr std::uint64_t offset = 14695981039346656037ULL;
+    constexpr std::uint64_t prime = 1099511628211ULL;
+    std::uint64_t hash = offset;
+    for (const auto& pixel : image.pixels) {
+        for (const auto byte : {pixel.r, pixel.g, pixel.b, pixel.a}) {
+            hash = (hash ^ byte) * prime;
+        }
+    }
+    return hash;
+}
+
+/// count the resumes of a script waiting for a trigger
+auto countFires(ScriptScheduler& scheduler, TriggerId trigger, int& fires) -> ScriptTask {
+    for (;;) {
+        co_await scheduler.trigger(trigger);
+        ++fires;
+    }
+}
+
+/// record the time a script wakes up after a sleep
+auto wakeAfter(ScriptScheduler& scheduler, std::uint64_t duration, std::uint64_t& wokeAt) -> ScriptTask {
+    co_await scheduler.sleep(duration);
+    wokeAt = scheduler.now();
+}
+
+} // namespace
+
+TEST_CASE("a RendererBuilder reads back the tiles it builds") {
+    std::mt19937 random{42};
+    std::uniform_int_distribution<int> cell{0, 255};
+    for (TileTypeId typeId = 0; typeId < tileTypes.size(); ++typeId) {
+        const SDL_FPoint pos{static_cast<float>(cell(random)) * gridSize, static_cast<float>(cell(random)) * gridSize};
+        const auto level = typeId % 2 == 0;
+        const auto tile = RendererBuilder{typeId}.build(pos, level);
+
+        std::stringstream stream;
+        stream << *tile;
+        RendererBuilder builder;
+        REQUIRE(static_cast<bool>(stream >> builder));
+        CHECK(builder.typeId() == typeId);
+        checkSameRecord(builder.build()->record(), tile->record());
+    }
+}
+
+TEST_CASE("a Tile reads back what it writes") {
+    const auto floor = *findTileType("floor_1");
+    const auto fountain = *findTileType("wall_fountain_mid_blue");
+
+    SUBCASE("static") {
+        const Tile<StaticRenderer> tile{floor, {48, 96}, true};
+        std::stringstream stream;
+        stream << tile;
+        Tile<StaticRenderer> read{fountain, {}, false};
+        REQUIRE(static_cast<bool>(stream >> read));
+        checkSameRecord(read.record(), tile.record());
+    }
+
+    SUBCASE("animated") {
+        const Tile<AnimatedRenderer> tile{fountain, {16, 32}, false};
+        std::stringstream stream;
+        stream << tile;
+        Tile<AnimatedRenderer> read{floor, {}, true};
+        REQUIRE(static_cast<bool>(stream >> read));
+        checkSameRecord(read.record(), tile.record());
+    }
+
+    SUBCASE("unknown type") {
+        std::stringstream stream{"not_a_tile static 0 0 16 16 16 32 0"};
+        Tile<StaticRenderer> read{floor, {1, 2}, false};
+        CHECK_FALSE(static_cast<bool>(stream >> read));
+        CHECK(read.record().typeId == floor);
+        stream.clear();
+        CHECK(stream.tellg() == 0);
+    }
+}
+
+TEST_CASE("the tileset index sets the source rects of the types it names") {
+    const auto knight = *findTileType("knight_m");
+    const auto imp = *findTileType("imp");
+    const auto checkRect = [](const SDL_FRect& rect, const SDL_FRect& expected) {
+        CHECK(rect.x == expected.x);
+        CHECK(rect.y == expected.y);
+        CHECK(rect.w == expected.w);
+        CHECK(rect.h == expected.h);
+    };
+    // the types not in the index keep the rect of the table
+    const auto checkUnchanged = [&](const SourceRects& rects) {
+        for (TileTypeId typeId = 0; typeId < tileTypes.size(); ++typeId) {
+            if (typeId != knight && typeId != imp) {
+                checkRect(rects[typeId], tileType(typeId).sourceRect);
+            }
+        }
+    };
+
+    SUBCASE("a valid file") {
+        std::istringstream index{"Character knight_m 1 2 3 4\nEnemy imp 5 6 7 8\n"};
+        const auto rects = readSourceRects(index);
+        checkRect(rects[knight], {1, 2, 3, 4});
+        checkRect(rects[imp], {5, 6, 7, 8});
+        checkUnchanged(rects);
+    }
+
+    SUBCASE("a malformed line") {
+        std::istringstream index{"Character knight_m 1 2 3 4\nEnemy imp five 6 7 8\nCharacter\nEnemy imp 5 6 7 8"};
+        const auto rects = readSourceRects(index);
+        checkRect(rects[knight], {1, 2, 3, 4});
+        // the lines after a malformed one are still read
+        checkRect(rects[imp], {5, 6, 7, 8});
+        checkUnchanged(rects);
+    }
+
+    SUBCASE("an unknown tile name") {
+        std::istringstream index{"Character no_such_tile 1 2 3 4\n"};
+        const auto rects = readSourceRects(index);
+        checkRect(rects[knight], tileType(knight).sourceRect);
+        checkRect(rects[imp], tileType(imp).sourceRect);
+        checkUnchanged(rects);
+    }
+}
+
+TEST_CASE("the file watcher reports the watched files written") {
+    const auto directory = std::filesystem::temp_directory_path() / "my_tests_file_watcher";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    const std::vector<std::filesystem::path> paths{directory / "first.txt", directory / "second.txt"};
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::size_t> indexes;
+    {
+        FileWatcher watcher{paths, [&](std::size_t index) {
+                                const std::scoped_lock lock{mutex};
+                                indexes.push_back(index);
+                                changed.notify_one();
+                            }};
+        if (watcher.isWatching()) {
+            std::ofstream{directory / "other.txt"} << "not watched";
+            std::ofstream{paths[1]} << "written";
+            std::unique_lock lock{mutex};
+            CHECK(changed.wait_for(lock, std::chrono::seconds{5}, [&indexes] { return !indexes.empty(); }));
+            for (const auto index : indexes) {
+                CHECK(index == 1);
+            }
+        } else {
+            MESSAGE("the files cannot be watched on this platform");
+        }
+    }
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("the palette lists the best matches first, in category order between equal scores") {
+    std::vector<TileTypeId> typeIds(tileTypes.size());
+    std::iota(typeIds.begin(), typeIds.end(), TileTypeId{0});
+    PaletteIndex index{typeIds};
+
+    // each query narrows the previous one, so only the previous results are scored again
+    for (const auto query : {"w", "wa", "wal", "wall", "wall_", "o", "or", "orc"}) {
+        index.filter(query, std::nullopt);
+        const auto results = index.results();
+        CHECK_FALSE(results.empty());
+        const auto score = [&](std::size_t result) { return *fuzzyScore(query, tileType(index.entry(result).typeId).name); };
+        for (std::size_t rank = 1; rank < results.size(); ++rank) {
+            const auto previous = score(results[rank - 1]);
+            const auto current = score(results[rank]);
+            CHECK((previous > current || (previous == current && results[rank - 1] < results[rank])));
+        }
+    }
+}
+
+TEST_CASE("the level format round-trips") {
+    std::vector<std::unique_ptr<TileConcrete>> map;
+    std::vector<std::unique_ptr<TileConcrete>> mapWall;
+    {
+        std::ifstream file{"test.lvl"};
+        REQUIRE(file.is_open());
+        readLevel(file, map, mapWall);
+    }
+    REQUIRE_FALSE(map.empty());
+
+    std::stringstream stream;
+    for (const auto& tile : map) {
+        stream << *tile << '\n';
+    }
+    stream << "=====\n";
+    for (const auto& tile : mapWall) {
+        stream << *tile << '\n';
+    }
+
+    std::vector<std::unique_ptr<TileConcrete>> readMap;
+    std::vector<std::unique_ptr<TileConcrete>> readMapWall;
+    readLevel(stream, readMap, readMapWall);
+    REQUIRE(readMap.size() == map.size());
+    REQUIRE(readMapWall.size() == mapWall.size());
+    for (std::size_t index = 0; index < map.size(); ++index) {
+        checkSameRecord(readMap[index]->record(), map[index]->record());
+    }
+    for (std::size_t index = 0; index < mapWall.size(); ++index) {
+        checkSameRecord(readMapWall[index]->record(), mapWall[index]->record());
+    }
+}
+
+TEST_CASE("the compact level format round-trips") {
+    std::vector<std::unique_ptr<TileConcrete>> map;
+    std::vector<std::unique_ptr<TileConcrete>> mapWall;
+    std::ifstream file{"test.lvl"};
+    REQUIRE(file.is_open());
+    readLevel(file, map, mapWall);
+    const auto level = LevelSnapshot::capture(map, mapWall);
+
+    const auto bytes = encodeLevel(level);
+    REQUIRE(bytes.has_value());
+    const std::string encoded(bytes->begin(), bytes->end());
+    std::stringstream stream{encoded};
+    std::vector<std::unique_ptr<TileConcrete>> readMap;
+    std::vector<std::unique_ptr<TileConcrete>> readMapWall;
+    readLevel(stream, readMap, readMapWall);
+    REQUIRE_FALSE(stream.fail());
+
+    // the tiles of a cell may come back in another order
+    const auto inOrder = [](TileRecords records) {
+        std::ranges::sort(records, [](const TileRecord& lhs, const TileRecord& rhs) {
+            const auto lhsKey = mortonKey(orderCell(lhs.pos));
+            const auto rhsKey = mortonKey(orderCell(rhs.pos));
+            if (lhsKey != rhsKey) {
+                return lhsKey < rhsKey;
+            }
+            return lhs.pos.y != rhs.pos.y ? lhs.pos.y < rhs.pos.y : lhs.pos.x < rhs.pos.x;
+        });
+        return records;
+    };
+    const auto read = LevelSnapshot::capture(readMap, readMapWall);
+    const auto readFloor = inOrder(read.floor);
+    const auto readWalls = inOrder(read.walls);
+    const auto floor = inOrder(level.floor);
+    const auto walls = inOrder(level.walls);
+    REQUIRE(readFloor.size() == floor.size());
+    REQUIRE(readWalls.size() == walls.size());
+    for (std::size_t index = 0; index < floor.size(); ++index) {
+        checkSameRecord(readFloor[index], floor[index]);
+    }
+    for (std::size_t index = 0; index < walls.size(); ++index) {
+        checkSameRecord(readWalls[index], walls[index]);
+    }
+
+    SUBCASE("truncated") {
+        CHECK_FALSE(decodeLevel(std::span{*bytes}.first(bytes->size() / 2)).has_value());
+    }
+
+    SUBCASE("cells out of range") {
+        // two runs each moving down by the largest row delta, the second would overflow the row
+        const std::vector<std::uint8_t> largestDelta{0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01};
+        std::vector<std::uint8_t> crafted{'L', 'V', 'L', 'Z', 1, 2};
+        for (int run = 0; run < 2; ++run) {
+            crafted.insert(crafted.end(), largestDelta.begin(), largestDelta.end());
+            crafted.insert(crafted.end(), {0, 0, 0});
+        }
+        crafted.push_back(0);
+        CHECK_FALSE(decodeLevel(crafted).has_value());
+    }
+}
+
+TEST_CASE("a generated dungeon only depends on its seed") {
+    DungeonOptions options{.cells = {200, 150}, .seed = 11, .cellSize = gridSize, .regionSize = 64, .threads = 1};
+    const auto single = generateDungeon(options);
+    options.threads = 4;
+    const auto parallel = generateDungeon(options);
+    REQUIRE(single.floor.size() == parallel.floor.size());
+    REQUIRE(single.walls.size() == parallel.walls.size());
+    for (std::size_t index = 0; index < single.floor.size(); ++index) {
+        checkSameRecord(parallel.floor[index], single.floor[index]);
+    }
+    for (std::size_t index = 0; index < single.walls.size(); ++index) {
+        checkSameRecord(parallel.walls[index], single.walls[index]);
+    }
+
+    SUBCASE("every room is reachable") {
+        const auto map = carveDungeon(options);
+        REQUIRE(map.floorCount() > 0);
+        const auto cells = map.cells();
+        std::vector<bool> seen(static_cast<std::size_t>(cells.x * cells.y));
+        std::vector<SDL_Point> open;
+        for (int y = 0; y < cells.y && open.empty(); ++y) {
+            for (int x = 0; x < cells.x && open.empty(); ++x) {
+                if (map.isFloor(x, y)) {
+                    open.push_back({x, y});
+                    seen[static_cast<std::size_t>(y * cells.x + x)] = true;
+                }
+            }
+        }
+        std::size_t reached = 0;
+        while (!open.empty()) {
+            const auto cell = open.back();
+            open.pop_back();
+            ++reached;
+            for (const auto next : {SDL_Point{cell.x + 1, cell.y}, SDL_Point{cell.x - 1, cell.y}, SDL_Point{cell.x, cell.y + 1}, SDL_Point{cell.x, cell.y - 1}}) {
+                if (map.isFloor(next.x, next.y) && !seen[static_cast<std::size_t>(next.y * cells.x + next.x)]) {
+                    seen[static_cast<std::size_t>(next.y * cells.x + next.x)] = true;
+                    open.push_back(next);
+                }
+            }
+        }
+        CHECK(reached == map.floorCount());
+    }
+
+    SUBCASE("the walls have their top above them") {
+        const auto wall = *findTileType("wall_mid");
+        const auto wallTop = *findTileType("wall_top_mid");
+        std::size_t faces = 0;
+        for (const auto& record : single.walls) {
+            if (record.typeId != wall) {
+                continue;
+            }
+            ++faces;
+            CHECK(std::ranges::any_of(single.walls, [&](const TileRecord& top) {
+                return top.typeId == wallTop && top.pos.x == record.pos.x && top.pos.y == record.pos.y - gridSize;
+            }));
+        }
+        CHECK(faces > 0);
+    }
+}
+
+TEST_CASE("the tiles of a layer are kept in z-order") {
+    CHECK(mortonKey({0, 0}) < mortonKey({1, 0}));
+    CHECK(mortonKey({1, 0}) < mortonKey({0, 1}));
+    CHECK(mortonKey({1, 1}) < mortonKey({2, 0}));
+    CHECK(mortonKey({-1, 0}) < mortonKey({0, 0}));
+    for (const auto cell : {SDL_Point{0, 0}, SDL_Point{-3, 7}, SDL_Point{4096, -4096}}) {
+        const auto back = mortonCell(mortonKey(cell));
+        CHECK(back.x == cell.x);
+        CHECK(back.y == cell.y);
+    }
+
+    const auto floor = *findTileType("floor_1");
+    std::minstd_rand random{7};
+    std::uniform_int_distribution<int> cell{-8, 120};
+    TileLayer layer;
+    for (int index = 0; index < 4000; ++index) {
+        const SDL_FPoint pos{static_cast<float>(cell(random)) * gridSize, static_cast<float>(cell(random)) * gridSize};
+        eraseTiles(layer, pos);
+        insertTile(layer, RendererBuilder{floor}.build(pos, false));
+    }
+    CHECK(std::ranges::is_sorted(layer, {}, [](const auto& tile) { return tileKey(*tile); }));
+
+    std::uniform_real_distribution<float> corner{-200, 2000};
+    std::uniform_real_distribution<float> side{0, 800};
+    for (int query = 0; query < 200; ++query) {
+        const SDL_FRect area{corner(random), corner(random), side(random), side(random)};
+        const auto isInside = [&area](const SDL_FPoint& pos) {
+            return pos.x >= area.x && pos.y >= area.y && pos.x < area.x + area.w && pos.y < area.y + area.h;
+        };
+        std::size_t visited = 0;
+        forEachTileIn(layer, area, [&](TileConcrete& tile) {
+            CHECK(isInside(tile.getPos()));
+            ++visited;
+        });
+        const auto inside = std::ranges::count_if(layer, [&](const auto& tile) { return isInside(tile->getPos()); });
+        CHECK(visited == static_cast<std::size_t>(inside));
+    }
+}
+
+TEST_CASE("snapping to the grid") {
+    std::mt19937 random{7};
+    std::uniform_real_distribution<float> coordinate{-4096, 4096};
+    const auto floor = RendererBuilder{*findTileType("floor_1")};
+
+    for (int sample = 0; sample < 10000; ++sample) {
+        const SDL_FPoint worldPos{coordinate(random), coordinate(random)};
+        const auto pos = snapToGrid(worldPos, gridSize);
+
+        // the cell holds the world position, its tile position is its bottom left corner
+        CHECK(pos.x <= worldPos.x);
+        CHECK(worldPos.x < pos.x + gridSize);
+        CHECK(pos.y - gridSize <= worldPos.y);
+        CHECK(worldPos.y < pos.y);
+
+        // every position of the cell snaps to the same tile
+        const SDL_FPoint corner{pos.x, pos.y - gridSize};
+        const auto tile = floor.build(snapToGrid(corner, gridSize), false);
+        CHECK(tile->isSamePos(pos));
+        CHECK_FALSE(tile->isSamePos(snapToGrid({corner.x + gridSize, corner.y}, gridSize)));
+        CHECK_FALSE(tile->isSamePos(snapToGrid({corner.x, corner.y + gridSize}, gridSize)));
+    }
+}
+
+TEST_CASE("the scene is scaled to the window by an integer factor") {
+    Viewport viewport{{640, 360}};
+    CHECK(viewport.scale() == 1);
+
+    viewport.resize({1920, 1080});
+    CHECK(viewport.scale() == 3);
+    CHECK(viewport.rect().x == 0);
+    CHECK(viewport.rect().w == 1920);
+
+    // the factor that fits both sides, centered with bars
+    viewport.resize({1500, 1000});
+    CHECK(viewport.scale() == 2);
+    CHECK(viewport.rect().x == 110);
+    CHECK(viewport.rect().y == 140);
+    CHECK(viewport.rect().w == 1280);
+    CHECK(viewport.rect().h == 720);
+    const auto pos = viewport.toScene({110 + 33, 140 + 65});
+    CHECK(pos.x == doctest::Approx(16.5));
+    CHECK(pos.y == doctest::Approx(32.5));
+
+    // the bars are not on the scene
+    CHECK(viewport.contains({110, 140}));
+    CHECK(viewport.contains({110 + 1279, 140 + 719}));
+    CHECK_FALSE(viewport.contains({109, 500}));
+    CHECK_FALSE(viewport.contains({500, 140 + 720}));
+
+    // a window smaller than the scene crops it
+    viewport.resize({320, 180});
+    CHECK(viewport.scale() == 1);
+    CHECK(viewport.rect().x == -160);
+}
+
+TEST_CASE("the damage of a frame is what its draw list changes") {
+    DamageTracker damage{{0, 0, 1280, 720}};
+    REQUIRE(damage.rects().size() == 1);
+    damage.clear();
+
+    DrawList previous;
+    previous.sprite({0, 0, 16, 16}, {0, 0, 32, 32});
+    previous.sprite({0, 0, 16, 16}, {320, 320, 32, 32});
+    DrawList current;
+    current.sprite({0, 0, 16, 16}, {0, 0, 32, 32});
+    current.sprite({16, 0, 16, 16}, {320, 320, 32, 32});
+    current.quad({639.5F, 100, 2, 2}, {255, 255, 255, 128});
+
+    damage.diff(previous, previous);
+    CHECK(damage.empty());
+
+    damage.diff(previous, current);
+    REQUIRE(damage.rects().size() == 2);
+    const auto hasRect = [&damage](int x, int y, int w, int h) {
+        return std::ranges::any_of(damage.rects(), [&](const SDL_Rect& rect) {
+            return rect.x == x && rect.y == y && rect.w == w && rect.h == h;
+        });
+    };
+    CHECK(hasRect(320, 320, 32, 32));
+    // the pixels partially covered are damaged
+    CHECK(hasRect(639, 100, 3, 2));
+
+    damage.clear();
+    damage.add({1270, 710, 32, 32});
+    CHECK(hasRect(1270, 710, 10, 10));
+}
+
+TEST_CASE("the tiles under opaque walls are culled") {
+    const auto atlas = loadSurface("rsrc/0x72_DungeonTilesetII_v1.7/0x72_DungeonTilesetII_v1.7.png");
+    const auto opaque = findOpaqueTypes(surfaceImage(atlas), sourceRects());
+    CHECK(opaque[*findTileType("floor_1")]);
+    CHECK(opaque[*findTileType("wall_mid")]);
+    CHECK_FALSE(opaque[*findTileType("wall_top_mid")]);
+    CHECK_FALSE(opaque[*findTileType("lever_left")]);
+
+    OcclusionGrid grid{{4, 4}, gridSize};
+    grid.cover({gridSize, gridSize, gridSize * 2, gridSize});
+    CHECK(grid.isCovered({gridSize, gridSize, gridSize, gridSize}));
+    CHECK(grid.isCovered({gridSize * 2, gridSize, gridSize, gridSize}));
+    // a sprite across a cell left uncovered stays drawn
+    CHECK_FALSE(grid.isCovered({gridSize * 1.5F, gridSize, gridSize * 2, gridSize}));
+    // a sprite off the grid is never culled
+    CHECK_FALSE(grid.isCovered({-gridSize, gridSize, gridSize, gridSize}));
+
+    // an opaque sprite only covers the cells it fully contains
+    grid.cover({gridSize / 2, gridSize * 3, gridSize, gridSize});
+    CHECK_FALSE(grid.isCovered({0, gridSize * 3, gridSize, gridSize}));
+    CHECK_FALSE(grid.isCovered({gridSize, gridSize * 3, gridSize, gridSize}));
+
+    grid.clear();
+    CHECK_FALSE(grid.isCovered({gridSize, gridSize, gridSize, gridSize}));
+
+    DrawList drawList;
+    drawList.sprite({0, 0, 16, 16}, {0, 0, 32, 32});
+    drawList.sprite({0, 0, 16, 16}, {16, 0, 32, 32});
+    drawList.rect({0, 0, 64, 64}, {255, 255, 255, 255});
+    OverdrawMap overdraw;
+    overdraw.count(drawList, {64, 64});
+    // the outlines do not fill
+    CHECK(overdraw.filled() == 2 * 32 * 32);
+    CHECK(overdraw.covered() == 48 * 32);
+    CHECK(overdraw.fills()[0] == 1);
+    CHECK(overdraw.fills()[16] == 2);
+    CHECK(overdraw.fills()[48] == 0);
+}
+
+TEST_CASE("the software backend draws what the sdl renderer draws") {
+    // a red and a green texel, a transparent one and a gray one
+    Image atlas{.width = 4, .height = 1, .pixels = {{255, 0, 0, 255}, {0, 255, 0, 255}, {0, 0, 0, 0}, {128, 128, 128, 255}}};
+    SoftwareBackend backend{{8, 8}};
+    backend.setAtlas(atlas);
+    const auto pixel = [&backend](int x, int y) { return backend.scene().at(x, y); };
+    const auto isColor = [&pixel](int x, int y, Uint8 r, Uint8 g, Uint8 b) {
+        const auto color = pixel(x, y);
+        return color.r == r && color.g == g && color.b == b && color.a == 255;
+    };
+
+    DrawList drawList;
+    drawList.sprite({0, 0, 2, 1}, {0, 0, 4, 2});
+    drawList.sprite({0, 0, 2, 1}, {0, 2, 4, 2}, true);
+    drawList.sprite({2, 0, 1, 1}, {4, 0, 2, 2});
+    drawList.quad({6, 0, 2, 2}, {255, 255, 255, 128});
+    drawList.setModulation({255, 0, 255, 255});
+    drawList.sprite({3, 0, 1, 1}, {4, 4, 2, 2});
+    backend.submit(drawList, {0, 0, 8, 8});
+
+    // the texels are scaled without filtering
+    CHECK(isColor(0, 0, 255, 0, 0));
+    CHECK(isColor(1, 1, 255, 0, 0));
+    CHECK(isColor(2, 0, 0, 255, 0));
+    CHECK(isColor(3, 1, 0, 255, 0));
+    // a flipped sprite is mirrored
+    CHECK(isColor(0, 2, 0, 255, 0));
+    CHECK(isColor(3, 3, 255, 0, 0));
+    // the transparent texels leave the scene as it was
+    CHECK(isColor(4, 0, 0, 0, 0));
+    CHECK(isColor(6, 0, 128, 128, 128));
+    CHECK(isColor(4, 4, 128, 0, 128));
+
+    // the sdl renderer and the software backend uploaded to a texture draw the same pixels, up to the
+    // rounding of the blending
+    {
+        const SdlSurfacePtr surface{SDL_CreateSurface(8, 8, SDL_PIXELFORMAT_RGBA32), SDL_DestroySurface};
+        REQUIRE(surface);
+        const std::unique_ptr<SDL_Renderer, void (*)(SDL_Renderer*)> sdlRenderer{SDL_CreateSoftwareRenderer(surface.get()), SDL_DestroyRenderer};
+        REQUIRE(sdlRenderer);
+        const SdlRenderer renderer{sdlRenderer.get()};
+        const auto target = renderer.createTargetTexture({8, 8});
+        const auto readTarget = [&renderer, &sdlRenderer, &target] {
+            renderer.setRenderTarget(target);
+            const SdlSurfacePtr pixels{SDL_RenderReadPixels(sdlRenderer.get(), nullptr), SDL_DestroySurface};
+            renderer.resetRenderTarget();
+            REQUIRE(pixels);
+            return surfaceImage(pixels);
+        };
+
+        const SdlSurfacePtr atlasSurface{SDL_CreateSurfaceFrom(atlas.width, atlas.height, SDL_PIXELFORMAT_RGBA32, atlas.pixels.data(), atlas.width * static_cast<int>(sizeof(SDL_Color))), SDL_DestroySurface};
+        REQUIRE(atlasSurface);
+        const auto atlasTexture = renderer.createTextureFromSurface(atlasSurface);
+        SdlBackend sdlBackend{renderer, atlasTexture, target};
+        sdlBackend.clear({0, 0, 8, 8});
+        sdlBackend.submit(drawList, {0, 0, 8, 8});
+        sdlBackend.finish();
+        const auto drawn = readTarget();
+
+        const auto streaming = renderer.createStreamingTexture({8, 8});
+        SDL_SetTextureBlendMode(streaming.get(), SDL_BLENDMODE_NONE);
+        SdlSoftwareBackend softwareBackend{streaming};
+        softwareBackend.setAtlas(atlas);
+        softwareBackend.clear({0, 0, 8, 8});
+        softwareBackend.submit(drawList, {0, 0, 8, 8});
+        softwareBackend.finish();
+        renderer.setRenderTarget(target);
+        renderer.renderTexture(streaming, {0, 0, 8, 8}, {0, 0, 8, 8});
+        renderer.resetRenderTarget();
+        const auto uploaded = readTarget();
+
+        REQUIRE(drawn.pixels.size() == uploaded.pixels.size());
+        const auto isClose = [](Uint8 lhs, Uint8 rhs) { return std::abs(lhs - rhs) <= 2; };
+        for (int y = 0; y < 8; ++y) {
+            for (int x = 0; x < 8; ++x) {
+                const auto lhs = drawn.at(x, y);
+                const auto rhs = uploaded.at(x, y);
+                INFO("pixel ", x, ", ", y);
+                CHECK(isClose(lhs.r, rhs.r));
+                CHECK(isClose(lhs.g, rhs.g));
+                CHECK(isClose(lhs.b, rhs.b));
+                CHECK(isClose(lhs.a, rhs.a));
+            }
+        }
+        // the upload itself is exact
+        const auto sameColor = [](const SDL_Color& lhs, const SDL_Color& rhs) {
+            return lhs.r == rhs.r && lhs.g == rhs.g && lhs.b == rhs.b && lhs.a == rhs.a;
+        };
+        CHECK(std::ranges::equal(uploaded.pixels, softwareBackend.scene().pixels, sameColor));
+    }
+
+    // only the area submitted is drawn
+    backend.clear({0, 0, 8, 8});
+    backend.submit(drawList, {1, 0, 2, 2});
+    CHECK(isColor(0, 0, 0, 0, 0));
+    CHECK(isColor(1, 0, 255, 0, 0));
+    CHECK(isColor(2, 1, 0, 255, 0));
+    CHECK(isColor(3, 0, 0, 0, 0));
+    CHECK(isColor(0, 2, 0, 0, 0));
+
+    NullBackend null;
+    null.clear({0, 0, 8, 8});
+    null.submit(drawList, {0, 0, 8, 8});
+    CHECK(null.calls().clears == 1);
+    CHECK(null.calls().submits == 1);
+    CHECK(null.calls().sprites == 4);
+    CHECK(null.calls().quads == 1);
+    CHECK(null.calls().rects == 0);
+}
+
+TEST_CASE("the memory of a subsystem is accounted to its tag") {
+    const auto before = memoryUsage(MemoryTag::Tiles);
+    auto tile = RendererBuilder{*findTileType("floor_1")}.build({16, 16}, false);
+    const auto built = memoryUsage(MemoryTag::Tiles);
+    CHECK(built.live > before.live);
+    CHECK(built.allocations == before.allocations + 1);
+    tile.reset();
+    // the size of the dynamic type is released through the base
+    CHECK(memoryUsage(MemoryTag::Tiles).live == before.live);
+    CHECK(memoryUsage(MemoryTag::Tiles).peak >= built.live);
+
+    const auto io = memoryUsage(MemoryTag::LevelIo);
+    {
+        LevelSnapshot level;
+        level.floor.push_back({.typeId = *findTileType("floor_1"), .pos = {16, 16}, .level = false});
+        const auto bytes = encodeLevel(level);
+        CHECK(memoryUsage(MemoryTag::LevelIo).live > io.live);
+    }
+    CHECK(memoryUsage(MemoryTag::LevelIo).live == io.live);
+
+    MemoryMeter meter{1000};
+    meter.sample(0);
+    const TrackedVector<int, MemoryTag::Sprites> sprites(250);
+    // a sample before the period keeps the last rate
+    meter.sample(500);
+    CHECK(meter.rate(MemoryTag::Sprites) == 0);
+    meter.sample(2000);
+    CHECK(meter.rate(MemoryTag::Sprites) == doctest::Approx(250 * sizeof(int) / 2.0));
+    CHECK(formatBytes(1536) == "1.5 KiB");
+}
+
+TEST_CASE("an animation advances, loops and finishes its clips") {
+    AnimationSystem animations;
+    const auto knight = *findTileType("knight_m");
+    const auto id = animations.add(knight);
+    const auto& idle = clipInfo(knight, Clip::Idle);
+    const auto& run = clipInfo(knight, Clip::Run);
+    const auto& hit = clipInfo(knight, Clip::Hit);
+    REQUIRE(idle.frameCount > 1);
+    REQUIRE(hit.frameCount > 0);
+    const auto hasEvent = [&animations, id](AnimationEventType type, Clip clip, int frame) {
+        return std::ranges::any_of(animations.events(), [&](const AnimationEvent& event) {
+            return event.id == id && event.type == type && event.clip == clip && event.frame == frame;
+        });
+    };
+
+    SUBCASE("frame advance") {
+        animations.update(idle.frameDuration - 1);
+        CHECK(animations.frame(id) == idle.firstFrame);
+        CHECK(animations.events().empty());
+        animations.update(1);
+        CHECK(animations.frame(id) == idle.firstFrame + 1);
+        CHECK(hasEvent(AnimationEventType::FrameChanged, Clip::Idle, 1));
+        // the events only last until the next update
+        animations.update(1);
+        CHECK(animations.events().empty());
+    }
+
+    SUBCASE("looping") {
+        for (int frame = 1; frame < idle.frameCount; ++frame) {
+            animations.update(idle.frameDuration);
+        }
+        CHECK(animations.frame(id) == idle.firstFrame + idle.frameCount - 1);
+        animations.update(idle.frameDuration);
+        CHECK(animations.clip(id) == Clip::Idle);
+        CHECK(animations.frame(id) == idle.firstFrame);
+        CHECK(hasEvent(AnimationEventType::FrameChanged, Clip::Idle, 0));
+    }
+
+    SUBCASE("clip end") {
+        animations.play(id, Clip::Hit);
+        CHECK(animations.clip(id) == Clip::Hit);
+        // a looping clip waits for the end of the hit, then plays
+        animations.play(id, Clip::Run);
+        CHECK(animations.clip(id) == Clip::Hit);
+        animations.update(hit.frameDuration * static_cast<std::uint64_t>(hit.frameCount));
+        CHECK(hasEvent(AnimationEventType::ClipFinished, Clip::Hit, hit.frameCount - 1));
+        CHECK(hasEvent(AnimationEventType::FrameChanged, Clip::Run, 0));
+        CHECK(animations.clip(id) == Clip::Run);
+        CHECK(animations.frame(id) == run.firstFrame);
+    }
+
+    SUBCASE("removal") {
+        animations.update(idle.frameDuration);
+        REQUIRE_FALSE(animations.events().empty());
+        // the events of a removed entity are dropped, and it is no longer updated
+        animations.remove(id);
+        CHECK(animations.events().empty());
+        animations.update(idle.frameDuration);
+        CHECK(animations.events().empty());
+        CHECK(animations.size() == 0);
+        CHECK(animations.add(knight) == id);
+        CHECK(animations.frame(id) == idle.firstFrame);
+    }
+}
+
+TEST_CASE("a snapshot delta decodes against its baseline") {
+    const auto orc = *findTileType("orc_warrior");
+    Snapshot baseline{.tick = 1, .entities = {}, .resetTiles = true, .edits = {}};
+    for (int index = 0; index < 64; ++index) {
+        baseline.entities.push_back({.typeId = orc, .x = quantize(index * 10.F), .y = quantize(100.F), .clip = Clip::Idle, .flipped = false});
+        baseline.edits.push_back({.x = quantize(index * gridSize), .y = quantize(gridSize), .wall = false, .level = false, .typeId = orc});
+    }
+
+    const auto full = encodeSnapshot(baseline, nullptr);
+    REQUIRE(full);
+    const auto decodedBaseline = decodeSnapshot(*full, nullptr);
+    REQUIRE(decodedBaseline);
+    CHECK(decodedBaseline->entities == baseline.entities);
+    CHECK(decodedBaseline->edits == baseline.edits);
+    CHECK(decodedBaseline->resetTiles);
+
+    auto current = baseline;
+    current.tick = 2;
+    current.resetTiles = false;
+    current.edits = {{.x = quantize(gridSize), .y = quantize(gridSize), .wall = true, .level = false, .typeId = std::nullopt}};
+    current.entities[3].x = quantize(31.5F);
+    current.entities[5].clip = Clip::Run;
+    current.entities[5].flipped = true;
+    current.entities.push_back({.typeId = orc, .x = quantize(-20.F), .y = 0, .clip = Clip::Hit, .flipped = false});
+
+    const auto delta = encodeSnapshot(current, &baseline);
+    REQUIRE(delta);
+    // the unchanged entities take a bit each
+    CHECK(delta->size() < full->size() / 8);
+    const auto header = readSnapshotHeader(*delta);
+    REQUIRE(header);
+    CHECK(header->baselineTick == 1U);
+
+    const auto decoded = decodeSnapshot(*delta, &*decodedBaseline);
+    REQUIRE(decoded);
+    CHECK(decoded->entities == current.entities);
+    CHECK(decoded->edits == current.edits);
+    CHECK(dequantize(decoded->entities[3].x) == 31.5F);
+
+    SUBCASE("a delta needs its baseline") {
+        CHECK_FALSE(decodeSnapshot(*delta, nullptr));
+        CHECK_FALSE(decodeSnapshot(*delta, &current));
+    }
+
+    SUBCASE("a truncated snapshot is rejected") {
+        for (std::size_t size = 0; size < delta->size(); ++size) {
+            CHECK_FALSE(decodeSnapshot(std::span{*delta}.first(size), &*decodedBaseline));
+        }
+    }
+}
+
+TEST_CASE("a script resumes only when its wait is over") {
+    ScriptScheduler scheduler{1024};
+    const auto trigger = scheduler.addTrigger();
+    int fires = 0;
+    for (int script = 0; script < 1000; ++script) {
+        scheduler.spawn(countFires(scheduler, trigger, fires));
+    }
+    std::uint64_t wokeAt = 0;
+    scheduler.spawn(wakeAfter(scheduler, 50, wokeAt));
+
+    // the spawned scripts run to their first wait
+    scheduler.update(10);
+    CHECK(scheduler.resumed() == 1001);
+
+    // the dormant scripts are not looked at
+    scheduler.update(10);
+    CHECK(scheduler.resumed() == 0);
+
+    scheduler.update(40);
+    CHECK(scheduler.resumed() == 1);
+    CHECK(wokeAt == 60);
+    CHECK(scheduler.size() == 1000);
+
+    scheduler.fire(trigger);
+    scheduler.update(10);
+    CHECK(scheduler.resumed() == 1000);
+    CHECK(fires == 1000);
+
+    SUBCASE("a volume fires its trigger when one of its cells is entered") {
+        TriggerVolumes volumes;
+        volumes.add({2, 3, 2, 2}, trigger);
+        volumes.enter({0, 0}, scheduler);
+        scheduler.update(10);
+        CHECK(fires == 1000);
+        volumes.enter({3, 4}, scheduler);
+        scheduler.update(10);
+        CHECK(fires == 2000);
+        volumes.remove(trigger);
+        volumes.enter({3, 4}, scheduler);
+        scheduler.update(10);
+        CHECK(fires == 2000);
+    }
+}
+
+TEST_CASE("a tick with an update budget updates the same agents on every run") {
+    AiScheduler scheduler{std::chrono::microseconds{0}};
+    scheduler.setMaxUpdates(2);
+    for (int agent = 0; agent < 5; ++agent) {
+        scheduler.add(1);
+    }
+
+    std::vector<AgentId> updated;
+    const auto record = [&updated](AgentId id, std::uint64_t /*elapsedTicks*/) { updated.push_back(id); };
+    scheduler.tick(record);
+    CHECK(updated == std::vector<AgentId>{0, 1});
+    CHECK(scheduler.stats().skipped == 3);
+
+    // the next tick resumes where the budget ran out
+    updated.clear();
+    scheduler.tick(record);
+    CHECK(updated == std::vector<AgentId>{2, 3});
+}
+
+TEST_CASE("test.lvl renders to the golden pixels") {
+    // the software backend draws the same pixels on every machine, the scene
+    // is built as Game::render builds it and drawn at the resolution of the
+    // art. Culling only leaves out hidden tiles, so both runs match the same
+    // hash. Set GOLDEN_RECORD to record a new golden hash, to be committed
+    // with the change that explains it
+    constexpr SDL_Point size{640, 360};
+    constexpr SDL_Point cells{256, 256};
+    constexpr SDL_FRect view{0, 0, size.x, size.y};
+    const std::filesystem::path goldenPath{"tests/golden/test_lvl.hash"};
+
+    const auto atlas = surfaceImage(loadSurface("rsrc/0x72_DungeonTilesetII_v1.7/0x72_DungeonTilesetII_v1.7.png"));
+    const auto opaqueTypes = findOpaqueTypes(atlas, sourceRects());
+
+    TileLayer map;
+    TileLayer mapWall;
+    std::ifstream file{"tests/golden/test.lvl"};
+    REQUIRE(file.is_open());
+    readLevel(file, map, mapWall);
+    sortTiles(map);
+    sortTiles(mapWall);
+
+    // lit by the lights of the level, as Game::rebuildGrids lights it
+    const auto cellOf = [](const SDL_FPoint& pos) {
+        return SDL_Point{static_cast<int>(std::floor(pos.x / gridSize)), static_cast<int>(std::floor(pos.y / gridSize))};
+    };
+    LightMap lights{cells.x, cells.y};
+    for (const auto* layer : {&map, &mapWall}) {
+        for (const auto& tile : *layer) {
+            const auto record = tile->record();
+            const auto cell = cellOf(record.pos);
+            if (layer == &mapWall) {
+                lights.setOpaque(cell.x, cell.y, true);
+            }
+            if (const auto intensity = lightIntensity(tileType(record.typeId)); intensity != 0) {
+                lights.addLight({.x = cell.x, .y = cell.y, .intensity = intensity});
+            }
+        }
+    }
+    lights.update();
+    const SceneBuilder::ColorOf colorOf = [&](const SDL_FPoint& pos) -> std::optional<SDL_Color> {
+        const auto cell = cellOf(pos);
+        return lightColors[lights.level(cell.x, cell.y)];
+    };
+
+    SceneBuilder scene{cells, gridSize};
+    const auto render = [&](bool culling) {
+        scene.clear();
+        scene.addFloor(map, view, opaqueTypes, colorOf);
+        scene.addWalls(mapWall, view, opaqueTypes, colorOf);
+        DrawList drawList;
+        const auto stats = scene.build(drawList, culling, 0);
+        SoftwareBackend backend{size};
+        backend.setAtlas(atlas);
+        backend.submit(drawList, {0, 0, size.x, size.y});
+        return std::pair{hashPixels(backend.scene()), stats};
+    };
+    const auto [hash, stats] = render(false);
+    const auto [culledHash, culledStats] = render(true);
+    CHECK(stats.culled == 0);
+    CHECK(culledStats.culled > 0);
+    CHECK(culledHash == hash);
+
+    if (std::getenv("GOLDEN_RECORD") != nullptr) {
+        std::filesystem::create_directories(goldenPath.parent_path());
+        std::ofstream{goldenPath} << std::hex << hash << '\n';
+        MESSAGE("recorded the golden hash in ", goldenPath.string());
+        return;
+    }
+
+    std::ifstream golden{goldenPath};
+    REQUIRE_MESSAGE(golden.is_open(), "no golden hash in ", goldenPath.string(), ", record it with GOLDEN_RECORD=1");
+    std::uint64_t expected{};
+    REQUIRE(static_cast<bool>(golden >> std::hex >> expected));
+    CHECK(hash == expected);
 }
\ No newline at end of file